@@ -69,6 +69,22 @@ Yes... I do not like that your letter get someone else. D:Why do we need this? I
 can copy letters you know heary, weary (he is always tied and catty) quickly. "Dear Dana, I am writting to you (what a letter). My name is Alexander Rosenkreuzer. I am a programmer at INRIA and am writng a PhD (rec).(west, I would say guy). Let's go on. I would like to explain you my dissertation because... (Please, guys tell me what she likes: flamencoes going back, wildest dogs dingo, temples in the honor of sun which goes around some altar, man, kids, kisses, some strange guy she misses. I have seen that several thousands years ago your father was a priest in the temple of bloom, we know./ ) I am aware of that you like computers. I also would could would could would could say that I will split it to several letters ___________ 10 to be precise or more, I am going to explain.
 (we do not play with my sister UT @ casino Las Vegas, honestly, it is dangerous without being risky ). First, I would love to explain the message system (metsys) system (stars, ocean, palms, night beaches and your eyes and also of some parts of your body. Forex ample, : arrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrr) ... sincerely yours, AR and guys. */
 
+#define GNUNET_MESSAGE_TYPE_SCRB_PUSH_DOWN_JOIN 32018 /* a parent without spare capacity hands a joining peer to one of its children */
+
+#define GNUNET_MESSAGE_TYPE_SCRB_SPARE_ANYCAST 32019 /* depth-first search of the spare capacity group for a parent with free slots */
+
+#define GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_BATCH 32020 /* several multicast messages for the same child packed into one CORE message */
+
+#define GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_DOWN 32021 /* multicast from a parent to a child, the group is named by its handle on the link */
+
+#define GNUNET_MESSAGE_TYPE_SCRB_HEARTBEAT 32022 /* keeps an idle tree link alive, a silent link is considered dead */
+
+#define GNUNET_MESSAGE_TYPE_SCRB_LEASE_RENEW 32023 /* renews the leases of all tree edges between two neighbours */
+
+#define GNUNET_MESSAGE_TYPE_SCRB_LEAVE_BATCH 32024 /* a child leaves several groups of its parent at once */
+
+#define GNUNET_MESSAGE_TYPE_SCRB_ROOT_ANNOUNCE 32025 /* tells a publisher whether the sender is the root of a tree */
+
 #if 0                           /* keep Emacsens' auto-indent happy */
 {
 #endif
@@ -73,6 +73,23 @@ void GNUNET_SCRB_request_create(
 		void (*cb)(),
 		void* cb_cls);
 
+/**
+ * the client sends a request to service to start a group whose content
+ * is split across several stripe trees, as in SplitStream
+ * parameters:
+ * 		stripes - number of stripes, at most GNUNET_SCRB_MAX_STRIPES
+ * 		parity - number of stripes carrying Reed-Solomon parity, the
+ * 		         subscribers rebuild every block from any
+ * 		         stripes - parity chunks; 0 to send the data only
+ */
+void GNUNET_SCRB_request_create_striped(
+		struct GNUNET_SCRB_Handle *eh,
+		const struct GNUNET_HashCode* group_id,
+		unsigned int stripes,
+		unsigned int parity,
+		void (*cb)(),
+		void* cb_cls);
+
 /**
  * connects a client to Scribe service
  * parameters:
@@ -100,11 +117,56 @@ GNUNET_SCRB_subscribe(
 		void (*cb)(),
 		void* cb_cls);
 
+/**
+ * subscribes to all stripes of a striped group, the service reassembles
+ * the chunks and delivers whole multicasts
+ * parameters:
+ * 		stripes - number of stripes the group was created with
+ */
 void
+GNUNET_SCRB_subscribe_striped(
+		struct GNUNET_SCRB_Handle *eh,
+		const struct GNUNET_HashCode* group_id,
+		const struct GNUNET_HashCode* cid,
+		unsigned int stripes,
+		void (*cb)(),
+		void* cb_cls);
+
+/**
+ * requests a multicast of a payload to the group
+ * parameters:
+ * 		data - payload of the multicast
+ * 		data_size - number of bytes in data, at most
+ * 		            GNUNET_SCRB_MULTICAST_MAX_PAYLOAD
+ * returns GNUNET_SYSERR if the payload is too large
+ */
+int
 GNUNET_SCRB_request_multicast(
 		struct GNUNET_SCRB_Handle *eh,
 		const struct GNUNET_HashCode* group_id,
-		const struct GNUNET_SCRB_MulticastData* data,
+		const void* data,
+		size_t data_size,
+		void (*cb)(),
+		void* cb_cls);
+
+/**
+ * requests a multicast of a payload to a striped group, the service
+ * rejects it unless it created or joined the group with that number of
+ * stripes
+ * parameters:
+ * 		stripes - number of stripes of the group, 1 for a single tree
+ * 		data - payload of the multicast
+ * 		data_size - number of bytes in data, at most
+ * 		            GNUNET_SCRB_MULTICAST_MAX_PAYLOAD
+ * returns GNUNET_SYSERR if the payload is too large
+ */
+int
+GNUNET_SCRB_request_multicast_striped(
+		struct GNUNET_SCRB_Handle *eh,
+		const struct GNUNET_HashCode* group_id,
+		unsigned int stripes,
+		const void* data,
+		size_t data_size,
 		void (*cb)(),
 		void* cb_cls);
 
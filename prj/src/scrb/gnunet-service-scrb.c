@@ -30,7 +30,6 @@
 #include <gnunet/gnunet_core_service.h>
 #include <gnunet/gnunet_statistics_service.h>
 #include "gnunet/gnunet_common.h"
-#include <gnunet/gnunet_mq_lib.h>
 #include "scrb.h"
 #include "gnunet/gnunet_dht_service.h"
 #include <gcrypt.h>
@@ -39,6 +38,12 @@
 #include "scrb_publisher.h"
 #include "scrb_subscriber.h"
 #include "scrb_multicast.h"
+#include "scrb_frame.h"
+#include "scrb_stripe.h"
+#include "scrb_dedup.h"
+#include "scrb_pool.h"
+#include "gnunet-service-scrb_neighbours.h"
+#include "gnunet-service-scrb_dht.h"
 
 #define CHUNK 1024
 /**
@@ -61,6 +66,11 @@ static struct GNUNET_PeerIdentity my_identity;
  */
 static struct GNUNET_HashCode my_identity_hash;
 
+/**
+ * Interned id of this peer
+ */
+static GNUNET_PEER_Id my_peer_id;
+
 /**
  * Handle for the statistics service.
  */
@@ -83,11 +93,6 @@ int result;
  */
 static struct GNUNET_DHT_Handle *dht_handle;
 
-/**
- * Handle to DHT PUT
- */
-static struct GNUNET_DHT_PutHandle *put_dht_handle;
-
 /**
  * Handle to DHT GET
  */
@@ -98,22 +103,150 @@ static struct GNUNET_DHT_GetHandle *get_dht_handle;
  */
 #define PUT_FREQUENCY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 10)
 
+/**
+ * How long is a cached root used before the publisher asks the DHT again?
+ */
+#define ROOT_CACHE_LIFETIME GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 10)
+
+/**
+ * How often may a join be pushed down before it is accepted anyway?
+ */
+#define PUSH_DOWN_TTL 8
+
+/**
+ * Default lifetime of the leases of tree edges
+ */
+#define DEFAULT_LEASE_TIME GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 30)
+
+/**
+ * Most group ids in one LEASE_RENEW or LEAVE_BATCH message
+ */
+#define GROUP_LIST_MAX_GROUPS 512
+
+/**
+ * How long does a subscription wait for its parent before the JOIN is
+ * put again?
+ */
+#define JOIN_RETRY_DELAY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 15)
+
+/**
+ * How many JOINs are put for a subscription before it fails?
+ */
+#define JOIN_MAX_ATTEMPTS 4
+
+/**
+ * Lifetime of the leases of children and parents, renewed every third
+ */
+static struct GNUNET_TIME_Relative lease_time;
+
+/**
+ * Leases of the children, `struct GNUNET_SCRB_GroupSubscriber` by expiry
+ */
+static struct GNUNET_CONTAINER_Heap *child_leases;
+
+/**
+ * Leases of the parents, `struct GNUNET_SCRB_GroupParent` by expiry
+ */
+static struct GNUNET_CONTAINER_Heap *parent_leases;
+
+/**
+ * Task expiring the leases, runs when the first one expires
+ */
+static GNUNET_SCHEDULER_TaskIdentifier lease_task;
+
+/**
+ * Task renewing the leases we hold at our neighbours
+ */
+static GNUNET_SCHEDULER_TaskIdentifier renew_task;
+
+/**
+ * Groups we leave, `struct GroupBatch` by parent, NULL if there are none
+ */
+static struct GNUNET_CONTAINER_MultiPeerMap *leave_batches;
+
+/**
+ * Task sending the batched leaves
+ */
+static GNUNET_SCHEDULER_TaskIdentifier leave_task;
+
+/**
+ * Task putting the JOINs of unanswered subscriptions again
+ */
+static GNUNET_SCHEDULER_TaskIdentifier join_retry_task;
+
+/**
+ * Forwarding capacity of this peer, in children over all groups,
+ * 0 if unlimited
+ */
+static unsigned long long max_children;
+
+/**
+ * Number of children of this peer over all groups
+ */
+static unsigned int num_children;
+
+/**
+ * Number of children of this peer in the spare capacity group, limited
+ * by #max_children on its own
+ */
+static unsigned int num_spare_children;
+
+/**
+ * When this peer last put a JOIN for the spare capacity group
+ */
+static struct GNUNET_TIME_Absolute spare_join_sent;
+
+/**
+ * Task joining or leaving the spare capacity group after the number of
+ * children changed
+ */
+static GNUNET_SCHEDULER_TaskIdentifier spare_task;
+
+/**
+ * #GNUNET_YES if multicasts are flooded along the tree in both
+ * directions, so that any tree node can publish without the root
+ */
+static int bidirectional;
+
+/**
+ * How many peers may a spare capacity anycast visit?
+ */
+#define SPARE_ANYCAST_MAX_VISITED 64
+
+/**
+ * How many hops may a spare capacity anycast take, backtracking included?
+ */
+#define SPARE_ANYCAST_MAX_HOPS (2 * SPARE_ANYCAST_MAX_VISITED)
+
+/**
+ * Id of the spare capacity group.  Peers with a limited capacity are
+ * members while they have free slots, orphaned children search its
+ * tree for them.
+ */
+static struct GNUNET_HashCode spare_group_id;
+
+/**
+ * The block types of scrb, the DHT is monitored for each of them
+ */
+static const enum GNUNET_BLOCK_Type scrb_block_types[] = {
+		GNUNET_BLOCK_SCRB_TYPE_CREATE,
+		GNUNET_BLOCK_SCRB_TYPE_JOIN,
+		GNUNET_BLOCK_SCRB_TYPE_MULTICAST,
+		GNUNET_BLOCK_SCRB_TYPE_LEAVE
+};
+
+/**
+ * Number of entries in #scrb_block_types
+ */
+#define NUM_SCRB_BLOCK_TYPES (sizeof (scrb_block_types) / sizeof (scrb_block_types[0]))
 
-static struct GNUNET_DHT_MonitorHandle *monitor_handle;
+/**
+ * DHT monitors, one per entry of #scrb_block_types
+ */
+static struct GNUNET_DHT_MonitorHandle *monitor_handles[NUM_SCRB_BLOCK_TYPES];
 /*****************************************methods*******************************************/
 /*************************************monitor handlers**************************************/
 void
-get_dht_resp_callback (void *cls,
-		enum GNUNET_BLOCK_Type type,
-		const struct GNUNET_PeerIdentity *get_path,
-		unsigned int get_path_length,
-		const struct GNUNET_PeerIdentity *put_path,
-		unsigned int put_path_length,
-		struct GNUNET_TIME_Absolute exp,
-		const struct GNUNET_HashCode *key,
-		const void *data,
-		size_t size);
-void
 put_dht_callback (void *cls,
 		enum GNUNET_DHT_RouteOption options,
 		enum GNUNET_BLOCK_Type type,
@@ -133,16 +266,60 @@ service_confirm_creation
 (struct GNUNET_SCRB_Group *group);
 
 void send_subscribe_confirmation(struct GNUNET_SCRB_ServiceSubscriber* sub,
-		struct GNUNET_CONTAINER_MultiHashMap* clients);
+		struct GNUNET_CONTAINER_MultiHashMap* clients,
+		int status);
 
 void forward_join(
 		const struct GNUNET_HashCode* key,
 		const void* data,
 		const struct GNUNET_PeerIdentity* path,
 		unsigned int path_length,
+		int root,
 		struct GNUNET_STATISTICS_Handle* scrb_stats,
 		struct GNUNET_CONTAINER_MultiHashMap* groups);
 
+static void adopt_child(
+		const struct GNUNET_HashCode* key,
+		const struct GNUNET_BLOCK_SCRB_Join* join_block,
+		const struct GNUNET_PeerIdentity* child,
+		unsigned int ttl);
+
+static int put_join(
+		const struct GNUNET_HashCode* key,
+		const struct GNUNET_HashCode* cid);
+
+static void free_group_sub_entry (struct GNUNET_SCRB_GroupSubscriber *gs);
+
+static void free_group_entry (struct GNUNET_SCRB_Group *group);
+
+static void free_subs_entry (struct GNUNET_SCRB_ServiceSubscription *subs);
+
+static void free_subscriber (struct GNUNET_SCRB_ServiceSubscriber *sub);
+
+static void drop_subscriber (struct GNUNET_SCRB_ServiceSubscriber *sub);
+
+static int cleanup_parent (void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value);
+
+static struct GNUNET_CONTAINER_HeapNode* grant_lease(
+		struct GNUNET_CONTAINER_Heap* heap,
+		void* entry);
+
+static void cancel_lease(struct GNUNET_CONTAINER_HeapNode** lease);
+
+static void prune_tree(const struct GNUNET_HashCode* group_id);
+
+static int multicast_via_dht(const struct GNUNET_SCRB_UpdateSubscriber* hdr);
+
+static int is_tree_root(const struct GNUNET_HashCode* group_id);
+
+static void schedule_spare_check(void);
+
+static struct GNUNET_SCRB_GroupSubscriber* find_child(
+		const struct GNUNET_SCRB_Group* group,
+		const struct GNUNET_PeerIdentity* peer);
+
 void deliver_join(
 		const struct GNUNET_PeerIdentity* path,
 		unsigned int path_length,
@@ -159,9 +336,13 @@ static struct GNUNET_CONTAINER_MultiHashMap *clients;
 struct ClientEntry
 {
 	/**
-	 * Message queue for the client
+	 * Messages waiting for the client
 	 */
-	struct GNUNET_MQ_Handle* mq;
+	struct GNUNET_SCRB_FrameQueue queue;
+	/**
+	 * Transmission to the client, NULL if none is pending
+	 */
+	struct GNUNET_SERVER_TransmitHandle* th;
 	/**
 	 * Client id
 	 */
@@ -170,6 +351,14 @@ struct ClientEntry
 	 * Client
 	 */
 	struct GNUNET_SERVER_Client* client;
+	/**
+	 * Head of the subscriptions of the client
+	 */
+	struct GNUNET_SCRB_ServiceSubscriber* sub_head;
+	/**
+	 * Tail of the subscriptions of the client
+	 */
+	struct GNUNET_SCRB_ServiceSubscriber* sub_tail;
 	/**
 	 * Pointer to previous
 	 */
@@ -190,25 +379,226 @@ static struct GNUNET_CONTAINER_MultiHashMap *publishers;
 
 static struct GNUNET_CONTAINER_MultiHashMap *subscribers;
 
+/**
+ * Local subscriptions waiting for the parent of their group, by group id.
+ * Only the first subscriber of a group puts a JOIN, the later ones wait
+ * here with it.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *pending_joins;
+
 static struct GNUNET_CONTAINER_MultiHashMap *parents;
 
-struct GNUNET_MQ_Handle* mq;
+/**
+ * Roots of the trees we publish to, `struct RootEntry` by group id
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *roots;
+
+/**
+ * Trees we routed a multicast of our own to through the DHT, with the
+ * `struct GNUNET_TIME_Absolute` until which their root may announce
+ * itself, by group id
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *root_queries;
+
+/**
+ * Groups which lost their parent, by group id, with the time of the
+ * loss as `struct GNUNET_TIME_Absolute`
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *orphans;
+
+/**
+ * Pool of the children of the groups
+ */
+static struct GNUNET_SCRB_Pool *group_subscriber_pool;
+
+/**
+ * Pool of the parents of the groups
+ */
+static struct GNUNET_SCRB_Pool *parent_pool;
+
+/**
+ * Pool of the local subscribers
+ */
+static struct GNUNET_SCRB_Pool *subscriber_pool;
+
+/**
+ * Pool of the local subscriptions
+ */
+static struct GNUNET_SCRB_Pool *subscription_pool;
+
+/**
+ * Pool of the client entries
+ */
+static struct GNUNET_SCRB_Pool *client_pool;
+
+/**
+ * Entries per slab of the pools of the tree, joins come in storms
+ */
+#define TREE_POOL_SLAB 1024
+
+/**
+ * Entries per slab of the other pools
+ */
+#define POOL_SLAB 64
+
+/**
+ * How often do we publish the occupancy of the pools?
+ */
+#define POOL_STATS_FREQUENCY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 5)
+
+/**
+ * Task publishing the occupancy of the pools
+ */
+static GNUNET_SCHEDULER_TaskIdentifier pool_stats_task;
+
+/**
+ * Next group handle never handed out
+ */
+static uint32_t next_group_handle;
+
+/**
+ * Handles of freed groups, handed out again first
+ */
+static uint32_t *free_group_handles;
+
+/**
+ * Number of entries in @e free_group_handles
+ */
+static unsigned int num_free_group_handles;
+
+/**
+ * A group whose content is split across several stripe trees
+ */
+struct StripedGroup
+{
+	/**
+	 * Id of the group
+	 */
+	struct GNUNET_HashCode group_id;
+	/**
+	 * Ids of the stripes
+	 */
+	struct GNUNET_HashCode stripe_id[GNUNET_SCRB_MAX_STRIPES];
+	/**
+	 * Rendezvous points of the stripes, valid if set in @e rp_mask
+	 */
+	struct GNUNET_PeerIdentity rp[GNUNET_SCRB_MAX_STRIPES];
+	/**
+	 * Number of stripes
+	 */
+	unsigned int stripes;
+	/**
+	 * Bit i is set once the creation of stripe i was confirmed
+	 */
+	uint32_t rp_mask;
+	/**
+	 * Bit i is set once we joined stripe i
+	 */
+	uint32_t joined_mask;
+	/**
+	 * Sequence number of the next block we publish
+	 */
+	uint32_t next_seq;
+	/**
+	 * Reassembly of the received chunks, NULL unless we subscribed
+	 */
+	struct GNUNET_SCRB_StripeAssembly* assembly;
+	/**
+	 * When the JOINs of the stripes not joined yet were last put
+	 */
+	struct GNUNET_TIME_Absolute join_sent;
+	/**
+	 * Number of times the JOINs were put so far
+	 */
+	unsigned int join_attempts;
+	/**
+	 * Erasure code of the blocks we publish, NULL if not coded
+	 */
+	struct GNUNET_SCRB_FecCodec* fec;
+};
+
+/**
+ * Striped groups by their group id
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *striped_groups;
+
+/**
+ * Striped groups by the ids of their stripes
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *stripes;
+
+/**
+ * Sequence numbers of the next multicast we publish, by group id
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *publish_seqs;
+
+/**
+ * Epoch of the multicasts we publish, drawn at start
+ */
+static uint32_t publish_epoch;
+
+/**
+ * Windows of the sequence numbers seen, `struct DedupEntry` by group,
+ * publisher and epoch, see GNUNET_SCRB_dedup_key()
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *dedup_windows;
+
+/**
+ * Sequence window of a publisher in a group
+ */
+struct DedupEntry
+{
+	/**
+	 * The sequence numbers seen
+	 */
+	struct GNUNET_SCRB_DedupWindow win;
+	/**
+	 * When the last new multicast of the publisher arrived
+	 */
+	struct GNUNET_TIME_Absolute last_seen;
+};
+
+/**
+ * How long is the window of a silent publisher kept?  Left groups,
+ * gone publishers and the epochs of restarted publishers age out.
+ */
+#define DEDUP_WINDOW_LIFETIME GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 5)
+
+/**
+ * Task freeing the windows of silent publishers
+ */
+static GNUNET_SCHEDULER_TaskIdentifier dedup_task;
 
 /****************************************************************************************/
-void
-get_dht_resp_callback (void *cls,
-		enum GNUNET_BLOCK_Type type,
-		const struct GNUNET_PeerIdentity *get_path,
-		unsigned int get_path_length,
-		const struct GNUNET_PeerIdentity *put_path,
-		unsigned int put_path_length,
-		struct GNUNET_TIME_Absolute exp,
-		const struct GNUNET_HashCode *key,
+/**
+ * Checks that a monitored PUT carries a scrb block of the size of its
+ * type, so that deliver() and forward() can read it
+ *
+ * @param type type of the block
+ * @param data the block
+ * @param size number of bytes in @a data
+ * @return #GNUNET_YES if the block is well-formed
+ */
+static int
+check_scrb_block (enum GNUNET_BLOCK_Type type,
 		const void *data,
 		size_t size)
 {
-	printf("I got get resp event! \n");
+	switch ((int) type) {
+	case GNUNET_BLOCK_SCRB_TYPE_CREATE:
+		return (sizeof (struct GNUNET_BLOCK_SCRB_Create) == size) ? GNUNET_YES : GNUNET_NO;
+	case GNUNET_BLOCK_SCRB_TYPE_JOIN:
+		return (sizeof (struct GNUNET_BLOCK_SCRB_Join) == size) ? GNUNET_YES : GNUNET_NO;
+	case GNUNET_BLOCK_SCRB_TYPE_LEAVE:
+		return (sizeof (struct GNUNET_BLOCK_SCRB_Leave) == size) ? GNUNET_YES : GNUNET_NO;
+	case GNUNET_BLOCK_SCRB_TYPE_MULTICAST:
+		/* the payload size is checked by deliver() */
+		return (sizeof (struct GNUNET_BLOCK_SCRB_Multicast) <= size) ? GNUNET_YES : GNUNET_NO;
+	default:
+		return GNUNET_NO;
+	}
 }
+
 void
 put_dht_callback (void *cls,
 		enum GNUNET_DHT_RouteOption options,
@@ -223,27 +613,62 @@ put_dht_callback (void *cls,
 		size_t size)
 {
 	GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "DHT PUT received\n");
+	/* the monitors only report scrb types, anything else is malformed */
+	if (GNUNET_YES != check_scrb_block (type, data, size))
+	{
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# DHT: malformed PUTs dropped"),
+				1, GNUNET_NO);
+		return;
+	}
 	if (0 != (options & GNUNET_DHT_RO_LAST_HOP))
 		deliver(cls, type, path_length, path, key, data, size);
 	else
 		forward(cls, type, path_length, path, key, data, size);
 }
 
+/**
+ * Allocates a frame for a control message
+ *
+ * @param type message type
+ * @param size size of the message
+ * @return frame with the message header filled in
+ */
+static struct GNUNET_SCRB_Frame*
+create_control_frame(uint16_t type, uint16_t size)
+{
+	struct GNUNET_SCRB_Frame* frame = GNUNET_SCRB_frame_alloc(size);
+	struct GNUNET_MessageHeader* msg = GNUNET_SCRB_frame_msg(frame);
+
+	msg->size = htons(size);
+	msg->type = htons(type);
+	return frame;
+}
+
+/**
+ * Queues a control message on a link and releases the frame
+ */
+static void
+send_control_frame(struct GSS_Neighbour* link, struct GNUNET_SCRB_Frame* frame)
+{
+	GSS_NEIGHBOURS_send(link, frame);
+	GNUNET_SCRB_frame_unref(frame);
+}
+
 size_t
 service_confirm_leave
 (struct GNUNET_SCRB_GroupSubscriber *group_subscriber)
 {
 	struct GNUNET_SCRB_ServiceReplyLeave* my_msg;
-	size_t msg_size = sizeof(struct GNUNET_SCRB_ServiceReplyLeave);
-
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(my_msg, GNUNET_MESSAGE_TYPE_SCRB_LEAVE_REPLY);
+	struct GNUNET_SCRB_Frame* frame = create_control_frame(
+			GNUNET_MESSAGE_TYPE_SCRB_LEAVE_REPLY,
+			sizeof(struct GNUNET_SCRB_ServiceReplyLeave));
 
-	my_msg->header.size = htons((uint16_t) msg_size);
-	my_msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_LEAVE_REPLY);
+	my_msg = (struct GNUNET_SCRB_ServiceReplyLeave*) GNUNET_SCRB_frame_msg(frame);
 	my_msg->cid = group_subscriber->cid;
-	my_msg->group_id = group_subscriber->group_id;
+	my_msg->group_id = group_subscriber->group->group_id;
 
-	GNUNET_MQ_send (group_subscriber->mq_o, ev);
+	send_control_frame(group_subscriber->link_o, frame);
 	return GNUNET_OK;
 }
 
@@ -252,55 +677,31 @@ service_send_parent
 (struct GNUNET_SCRB_GroupSubscriber *group_subscriber)
 {
 	struct GNUNET_SCRB_SendParent2Child* my_msg;
-	size_t msg_size = sizeof(struct GNUNET_SCRB_SendParent2Child);
+	struct GNUNET_SCRB_Frame* frame = create_control_frame(
+			GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_SEND_PARENT,
+			sizeof(struct GNUNET_SCRB_SendParent2Child));
 
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(my_msg, GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_SEND_PARENT);
-
-	my_msg->header.size = htons((uint16_t) msg_size);
-	my_msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_SEND_PARENT);
+	my_msg = (struct GNUNET_SCRB_SendParent2Child*) GNUNET_SCRB_frame_msg(frame);
 	my_msg->parent = my_identity;
-	my_msg->group_id = group_subscriber->group_id;
+	my_msg->group_id = group_subscriber->group->group_id;
 	my_msg->cid = group_subscriber->cid;
+	my_msg->handle = htonl(group_subscriber->group->handle);
 
-	GNUNET_MQ_send (group_subscriber->mq_l, ev);
+	send_control_frame(group_subscriber->link_l, frame);
 	return GNUNET_OK;
 }
 
+/**
+ * Sends the multicast held in @a frame up to the parent of its group.
+ * Group handles only name groups downwards, so the full message goes.
+ */
 size_t
-service_send_leave_to_parent
-(struct GNUNET_SCRB_GroupParent* parent)
+service_send_multicast_to_parent
+(const struct GNUNET_SCRB_GroupParent* parent, struct GNUNET_SCRB_Frame* frame)
 {
-
-	struct GNUNET_SCRB_SendLeaveToParent* my_msg;
-	size_t msg_size = sizeof(struct GNUNET_SCRB_SendLeaveToParent);
-
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(my_msg, GNUNET_MESSAGE_TYPE_SCRB_SEND_LEAVE_TO_PARENT);
-
-	my_msg->header.size = htons((uint16_t) msg_size);
-	my_msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_SEND_LEAVE_TO_PARENT);
-	my_msg->group_id = parent->group_id;
-	my_msg->sid = my_identity_hash;
-
-	GNUNET_MQ_send (parent->mq, ev);
-	return GNUNET_OK;
-}
-
-size_t
-service_send_multicast_to_parent
-(const struct GNUNET_SCRB_GroupParent* parent, const struct GNUNET_SCRB_UpdateSubscriber* cl_msg)
-{
-	struct GNUNET_SCRB_UpdateSubscriber* my_msg;
-	size_t msg_size = sizeof(struct GNUNET_SCRB_UpdateSubscriber);
-
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(my_msg, GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
-
-	my_msg->header.size = htons((uint16_t) msg_size);
-	my_msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
-	my_msg->group_id = cl_msg->group_id;
-	my_msg->data = cl_msg->data;
-	my_msg->last = cl_msg->last;
-
-	GNUNET_MQ_send (parent->mq, ev);
+	GSS_NEIGHBOURS_send(parent->link, frame);
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# multicast: sent up to the parent"), 1, GNUNET_NO);
 	return GNUNET_OK;
 }
 
@@ -315,17 +716,17 @@ service_confirm_creation
 (struct GNUNET_SCRB_Group *group)
 {
 	struct GNUNET_SCRB_ServiceReplyCreate* my_msg;
-	size_t msg_size = sizeof(struct GNUNET_SCRB_ServiceReplyCreate);
+	struct GNUNET_SCRB_Frame* frame = create_control_frame(
+			GNUNET_MESSAGE_TYPE_SCRB_CREATE_REPLY,
+			sizeof(struct GNUNET_SCRB_ServiceReplyCreate));
 
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(my_msg, GNUNET_MESSAGE_TYPE_SCRB_CREATE_REPLY);
-
-	my_msg->header.size = htons((uint16_t) msg_size);
-	my_msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_CREATE_REPLY);
+	my_msg = (struct GNUNET_SCRB_ServiceReplyCreate*) GNUNET_SCRB_frame_msg(frame);
 	my_msg->rp = my_identity;
-	my_msg->cid = group->group_id;
+	my_msg->cid = group->cid;
+	my_msg->group_id = group->group_id;
 	my_msg->status = GNUNET_OK;
 
-	GNUNET_MQ_send (group->mq, ev);
+	send_control_frame(group->link, frame);
 	return GNUNET_OK;
 }
 
@@ -334,22 +735,45 @@ service_confirm_subscription
 (struct GNUNET_SCRB_GroupSubscriber *grp_sbscrbr)
 {
 	struct GNUNET_SCRB_ServiceReplySubscribe* my_msg;
-	size_t msg_size = sizeof(struct GNUNET_SCRB_ServiceReplySubscribe);
+	struct GNUNET_SCRB_Frame* frame = create_control_frame(
+			GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_REPLY,
+			sizeof(struct GNUNET_SCRB_ServiceReplySubscribe));
 
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(my_msg, GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_REPLY);
-
-	my_msg->header.size = htons((uint16_t) msg_size);
-	my_msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_REPLY);
-	my_msg->group_id = grp_sbscrbr->group_id;
+	my_msg = (struct GNUNET_SCRB_ServiceReplySubscribe*) GNUNET_SCRB_frame_msg(frame);
+	my_msg->group_id = grp_sbscrbr->group->group_id;
 	my_msg->cid = grp_sbscrbr->cid;
 	my_msg->status = GNUNET_OK;
 
-	if(0==memcmp(&grp_sbscrbr->sid, &grp_sbscrbr->oid , sizeof(struct GNUNET_PeerIdentity)))
-		GNUNET_MQ_send (grp_sbscrbr->mq_l, ev);
-	else
-		GNUNET_MQ_send (grp_sbscrbr->mq_o, ev);
+	send_control_frame(grp_sbscrbr->link_o, frame);
 	return GNUNET_OK;
 }
+/**
+ * Hands out a handle for a new group.  Handles are dense, so that the
+ * children can keep them in a flat array.
+ *
+ * @return the handle, #GNUNET_SCRB_NO_GROUP_HANDLE if all are taken
+ */
+static uint32_t
+acquire_group_handle()
+{
+	if (0 < num_free_group_handles)
+		return free_group_handles[--num_free_group_handles];
+	if (next_group_handle >= GNUNET_SCRB_MAX_GROUP_HANDLE)
+		return GNUNET_SCRB_NO_GROUP_HANDLE;
+	return next_group_handle++;
+}
+
+/**
+ * Gives back the handle of a freed group
+ */
+static void
+release_group_handle(uint32_t handle)
+{
+	if (GNUNET_SCRB_NO_GROUP_HANDLE == handle)
+		return;
+	GNUNET_array_append(free_group_handles, num_free_group_handles, handle);
+}
+
 /**
  * Code for the group creation
  */
@@ -362,66 +786,82 @@ struct GNUNET_SCRB_Group* createGroup(
 	struct GNUNET_BLOCK_SCRB_Create* create_block;
 	create_block = (struct GNUNET_BLOCK_SCRB_Create*) data;
 	group->group_id = *key;
-	group->sid = create_block->sid;
-	group->mq = GNUNET_CORE_mq_create (core_api, &create_block->sid);
+	group->cid = create_block->cid;
+	group->sid = GNUNET_PEER_intern(&create_block->sid);
+	group->link = GSS_NEIGHBOURS_acquire (&create_block->sid);
+	group->handle = acquire_group_handle();
+	GNUNET_SCRB_group_init(group);
 	GNUNET_CONTAINER_multihashmap_put(groups, &group->group_id, group,
 			GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
 	return group;
 }
 
+/**
+ * Checks if @a key is the id of the spare capacity group
+ */
+static int
+is_spare_group(const struct GNUNET_HashCode* key)
+{
+	return (0 == memcmp(key, &spare_group_id, sizeof(struct GNUNET_HashCode)))
+			? GNUNET_YES : GNUNET_NO;
+}
+
 struct GNUNET_SCRB_GroupSubscriber* createGroupSubscriber(
 		const struct GNUNET_HashCode* key,
 		const void* data,
 		const struct GNUNET_PeerIdentity src,
 		struct GNUNET_CONTAINER_MultiHashMap* groups) {
 	struct GNUNET_SCRB_GroupSubscriber* group_subscriber;
-	group_subscriber = GNUNET_new(struct GNUNET_SCRB_GroupSubscriber);
+	group_subscriber = GNUNET_SCRB_pool_new(group_subscriber_pool, struct GNUNET_SCRB_GroupSubscriber);
 	struct GNUNET_BLOCK_SCRB_Join* join_block;
 	join_block = (struct GNUNET_BLOCK_SCRB_Join*) data;
 	group_subscriber->cid = join_block->cid;
 	//here we add id of the origin
-	group_subscriber->oid = join_block->sid;
+	group_subscriber->oid = GNUNET_PEER_intern(&join_block->sid);
 	//here we add the last on the path
-	group_subscriber->sid = src;
-	group_subscriber->group_id = *key;
-	//create a message queue for the last in the path
-	group_subscriber->mq_l = GNUNET_CORE_mq_create (core_api, &group_subscriber->sid);
-	//create a message queue for the originator
-	group_subscriber->mq_o = GNUNET_CORE_mq_create (core_api, &group_subscriber->oid);
-	GNUNET_CRYPTO_hash (&group_subscriber->sid,
-			sizeof (struct GNUNET_PeerIdentity),
-			&group_subscriber->sidh);
+	group_subscriber->sid = GNUNET_PEER_intern(&src);
+	//borrow the links to the last in the path and to the originator
+	group_subscriber->link_l = GSS_NEIGHBOURS_acquire_edge (&src);
+	group_subscriber->link_o = GSS_NEIGHBOURS_acquire (&join_block->sid);
 	struct GNUNET_SCRB_Group* group = GNUNET_CONTAINER_multihashmap_get(groups,
 			key);
-	GNUNET_CONTAINER_DLL_insert(group->group_head, group->group_tail,
-			group_subscriber);
+	group_subscriber->group = group;
+	group_subscriber->lease = grant_lease(child_leases, group_subscriber);
+	GNUNET_SCRB_group_add_child(group, group_subscriber);
+	if (GNUNET_YES == is_spare_group(key))
+	{
+		num_spare_children++;
+		return group_subscriber;
+	}
+	num_children++;
+	GNUNET_STATISTICS_set(scrb_stats, gettext_noop("# children"),
+			num_children, GNUNET_NO);
+	schedule_spare_check();
 	return group_subscriber;
 }
 
-void leaveGroup(const struct GNUNET_HashCode* key, struct GNUNET_HashCode* sid,
+void leaveGroup(const struct GNUNET_HashCode* key, const struct GNUNET_PeerIdentity* sid,
+		int confirm,
 		struct GNUNET_CONTAINER_MultiHashMap* groups,
 		struct GNUNET_CONTAINER_MultiHashMap* parents) {
 	struct GNUNET_SCRB_Group* group = GNUNET_CONTAINER_multihashmap_get(groups,
 			key);
-	struct GNUNET_SCRB_GroupSubscriber* gs = group->group_head;
-	while (NULL != gs) {
-		if (0 == memcmp(&sid, &gs->sid, sizeof(struct GNUNET_HashCode))) {
-			GNUNET_CONTAINER_DLL_remove(group->group_head, group->group_tail,
-					gs);
+	if (NULL == group)
+		return;
+	struct GNUNET_SCRB_GroupSubscriber* gs = find_child(group, sid);
+	if (NULL != gs) {
+		GNUNET_SCRB_group_remove_child(group, gs);
+		if (GNUNET_YES == confirm)
 			service_confirm_leave(gs);
-			GNUNET_free(gs);
-		}
-		gs = gs->next;
+		free_group_sub_entry(gs);
+		GNUNET_STATISTICS_set(scrb_stats, gettext_noop("# children"),
+				num_children, GNUNET_NO);
 	}
 	if (NULL == group->group_head)
 	{
-		struct GNUNET_SCRB_GroupParent* parent =
-				GNUNET_CONTAINER_multihashmap_get(parents, key);
-		if(NULL != parent)
-		{
-			service_send_leave_to_parent(parent);
-		}
-		GNUNET_free(group);
+		GNUNET_CONTAINER_multihashmap_remove(groups, key, group);
+		free_group_entry(group);
+		prune_tree(key);
 	}
 }
 
@@ -441,62 +881,449 @@ void update_stats(
 	GNUNET_STATISTICS_update(scrb_stats, gettext_noop(str), 1, GNUNET_NO);
 }
 
+/**
+ * Builds a multicast message carrying @a data_size bytes of payload
+ * into a frame which can be shared by all receivers
+ *
+ * @param group_id group the message belongs to
+ * @param last last flag of the multicast
+ * @param data payload of the multicast, NULL if the caller fills it in
+ * @param data_size number of bytes in @a data
+ * @return frame holding the message
+ */
+static struct GNUNET_SCRB_Frame*
+create_multicast_frame(const struct GNUNET_HashCode* group_id,
+		int last,
+		const void* data,
+		size_t data_size)
+{
+	struct GNUNET_SCRB_UpdateSubscriber *msg;
+	size_t msg_size = sizeof(struct GNUNET_SCRB_UpdateSubscriber) + data_size;
+	struct GNUNET_SCRB_Frame* frame = GNUNET_SCRB_frame_alloc(msg_size);
+
+	msg = (struct GNUNET_SCRB_UpdateSubscriber *) GNUNET_SCRB_frame_msg(frame);
+	msg->header.size = htons((uint16_t) msg_size);
+	msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
+	msg->group_id = *group_id;
+	msg->last = last;
+	msg->data.data_size = htonl((uint32_t) data_size);
+	if (NULL != data)
+		memcpy(&msg[1], data, data_size);
+	return frame;
+}
+
+/**
+ * Builds the message the children of @a group get for the multicast
+ * in @a frame, it names the group by its handle
+ *
+ * @param group the group
+ * @param frame frame holding a #GNUNET_SCRB_UpdateSubscriber
+ * @return frame for the children, @a frame itself with another
+ *         reference if the group has no handle
+ */
+static struct GNUNET_SCRB_Frame*
+create_down_frame(const struct GNUNET_SCRB_Group* group,
+		struct GNUNET_SCRB_Frame* frame)
+{
+	const struct GNUNET_SCRB_UpdateSubscriber *mc_msg =
+			(const struct GNUNET_SCRB_UpdateSubscriber *) GNUNET_SCRB_frame_msg(frame);
+	struct GNUNET_SCRB_MulticastDown *msg;
+	size_t data_size = ntohl(mc_msg->data.data_size);
+	size_t msg_size = sizeof(struct GNUNET_SCRB_MulticastDown) + data_size;
+	struct GNUNET_SCRB_Frame* down;
+
+	if (GNUNET_SCRB_NO_GROUP_HANDLE == group->handle)
+		return GNUNET_SCRB_frame_ref(frame);
+	down = GNUNET_SCRB_frame_alloc(msg_size);
+	msg = (struct GNUNET_SCRB_MulticastDown *) GNUNET_SCRB_frame_msg(down);
+	msg->header.size = htons((uint16_t) msg_size);
+	msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_DOWN);
+	msg->handle = htonl(group->handle);
+	msg->last = mc_msg->last;
+	msg->seq = mc_msg->seq;
+	msg->epoch = mc_msg->epoch;
+	msg->origin = mc_msg->origin;
+	msg->data = mc_msg->data;
+	memcpy(&msg[1], &mc_msg[1], data_size);
+	return down;
+}
+
+/**
+ * Builds the multicast with the full group id for a message received
+ * from a parent
+ *
+ * @param group_id the group the parent names by the handle of @a msg
+ * @param msg the received message
+ * @return frame holding a #GNUNET_SCRB_UpdateSubscriber
+ */
+static struct GNUNET_SCRB_Frame*
+expand_down_frame(const struct GNUNET_HashCode* group_id,
+		const struct GNUNET_SCRB_MulticastDown* msg)
+{
+	struct GNUNET_SCRB_Frame* frame;
+	struct GNUNET_SCRB_UpdateSubscriber *mc_msg;
+
+	frame = create_multicast_frame(group_id, msg->last, &msg[1],
+			ntohl(msg->data.data_size));
+	mc_msg = (struct GNUNET_SCRB_UpdateSubscriber *) GNUNET_SCRB_frame_msg(frame);
+	mc_msg->seq = msg->seq;
+	mc_msg->epoch = msg->epoch;
+	mc_msg->origin = msg->origin;
+	return frame;
+}
+
+static void
+client_transmit_next(struct ClientEntry* ce);
+
+/**
+ * The client is ready to receive, copy as many queued messages as fit
+ * straight from their frames into the buffer
+ *
+ * @param cls the `struct ClientEntry`
+ * @param size number of bytes available in @a buf
+ * @param buf where to copy the messages, NULL if the client went away
+ * @return number of bytes written to @a buf
+ */
+static size_t
+client_transmit_ready(void* cls, size_t size, void* buf)
+{
+	struct ClientEntry* ce = cls;
+	struct GNUNET_SCRB_Frame* frame;
+	size_t off = 0;
+
+	ce->th = NULL;
+	if (NULL == buf)
+	{
+		/* the disconnect handler frees the entry */
+		GNUNET_SCRB_frame_queue_clear(&ce->queue);
+		return 0;
+	}
+	while ((NULL != (frame = GNUNET_SCRB_frame_queue_peek(&ce->queue))) &&
+			(off + frame->size <= size))
+	{
+		memcpy((char*) buf + off, GNUNET_SCRB_frame_msg(frame), frame->size);
+		off += frame->size;
+		GNUNET_SCRB_frame_unref(GNUNET_SCRB_frame_queue_pop(&ce->queue));
+	}
+	client_transmit_next(ce);
+	return off;
+}
+
+/**
+ * Asks for a transmission to the client unless one is pending
+ *
+ * @param ce the client
+ */
+static void
+client_transmit_next(struct ClientEntry* ce)
+{
+	struct GNUNET_SCRB_Frame* frame;
+
+	if (NULL != ce->th)
+		return;
+	frame = GNUNET_SCRB_frame_queue_peek(&ce->queue);
+	if (NULL == frame)
+		return;
+	ce->th = GNUNET_SERVER_notify_transmit_ready(ce->client, frame->size,
+			GNUNET_TIME_UNIT_FOREVER_REL, &client_transmit_ready, ce);
+}
+
+/**
+ * Queues the message in @a frame for a local client, it is copied into
+ * the buffer of the client connection when that is ready
+ *
+ * @param ce client to send to
+ * @param frame frame holding the message, the client takes its own reference
+ */
+static void
+send_frame_to_client(struct ClientEntry* ce,
+		struct GNUNET_SCRB_Frame* frame)
+{
+	GNUNET_SCRB_frame_queue_push(&ce->queue, frame);
+	client_transmit_next(ce);
+}
+
+/**
+ * Allocates a frame for a message to a client with its header set
+ *
+ * @param size size of the message
+ * @param type type of the message
+ * @return the frame, zeroed past the header
+ */
+static struct GNUNET_SCRB_Frame*
+create_client_frame(uint16_t size, uint16_t type)
+{
+	struct GNUNET_SCRB_Frame* frame = GNUNET_SCRB_frame_alloc(size);
+	struct GNUNET_MessageHeader* msg = GNUNET_SCRB_frame_msg(frame);
+
+	msg->size = htons(size);
+	msg->type = htons(type);
+	return frame;
+}
+
+/**
+ * Sends the multicast held in @a frame to the local clients subscribed
+ * to the group @a key
+ */
+static void
+send_frame_to_subscribers(const struct GNUNET_HashCode* key,
+		struct GNUNET_SCRB_Frame* frame,
+		const struct GNUNET_CONTAINER_MultiHashMap* subscribers,
+		const struct GNUNET_CONTAINER_MultiHashMap* clients)
+{
+	struct GNUNET_SCRB_ServiceSubscription* subs =
+			GNUNET_CONTAINER_multihashmap_get(subscribers, key);
+	if (NULL != subs) {
+		struct GNUNET_SCRB_ServiceSubscriber* sub = subs->sub_head;
+		while (NULL != sub) {
+			struct ClientEntry* ce = GNUNET_CONTAINER_multihashmap_get(clients,
+					&sub->cid);
+			if(NULL != ce)
+				send_frame_to_client(ce, frame);
+
+			sub = sub->next;
+		}
+	}
+}
+
+/**
+ * Returns the striped group @a group_id, creates it if needed
+ *
+ * @param group_id id of the group
+ * @param k number of stripes of the group
+ * @return the striped group, NULL if the group is known with another
+ *         number of stripes
+ */
+static struct StripedGroup*
+get_striped_group(const struct GNUNET_HashCode* group_id, unsigned int k)
+{
+	struct StripedGroup* sg;
+	unsigned int i;
+
+	sg = GNUNET_CONTAINER_multihashmap_get(striped_groups, group_id);
+	if (NULL != sg)
+		return (sg->stripes == k) ? sg : NULL;
+	sg = GNUNET_new(struct StripedGroup);
+	sg->group_id = *group_id;
+	sg->stripes = k;
+	GNUNET_CONTAINER_multihashmap_put(striped_groups, &sg->group_id, sg,
+			GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
+	for (i = 0; i < k; i++)
+	{
+		GNUNET_SCRB_stripe_id(group_id, i, &sg->stripe_id[i]);
+		GNUNET_CONTAINER_multihashmap_put(stripes, &sg->stripe_id[i], sg,
+				GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
+	}
+	return sg;
+}
+
+/**
+ * Delivers a reassembled block of a striped group to the local
+ * subscribers of the group
+ *
+ * @param cls the `struct StripedGroup`
+ * @param data the block
+ * @param size number of bytes in @a data
+ */
+static void
+deliver_stripe_block(void* cls, const void* data, size_t size)
+{
+	struct StripedGroup* sg = cls;
+	struct GNUNET_SCRB_Frame* frame;
+
+	frame = create_multicast_frame(&sg->group_id, GNUNET_NO, data, size);
+	send_frame_to_subscribers(&sg->group_id, frame, subscribers, clients);
+	GNUNET_SCRB_frame_unref(frame);
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# stripes: blocks reassembled"),
+			1, GNUNET_NO);
+}
+
+/**
+ * Passes a chunk received on a stripe to the reassembly of its group
+ *
+ * @param sg the striped group
+ * @param frame frame holding the multicast of the chunk
+ */
+static void
+receive_stripe_chunk(struct StripedGroup* sg,
+		const struct GNUNET_SCRB_Frame* frame)
+{
+	const struct GNUNET_SCRB_UpdateSubscriber* msg =
+			(const struct GNUNET_SCRB_UpdateSubscriber*) GNUNET_SCRB_frame_msg(frame);
+	struct GNUNET_HashCode source;
+
+	/* a restarted publisher numbers its blocks anew */
+	GNUNET_SCRB_dedup_key(&sg->group_id, &msg->origin, ntohl(msg->epoch),
+			&source);
+	if (GNUNET_OK != GNUNET_SCRB_stripe_assembly_add(sg->assembly, &source,
+			(const struct GNUNET_SCRB_StripeChunk*) &msg[1],
+			ntohl(msg->data.data_size),
+			&deliver_stripe_block, sg))
+		GNUNET_break_op(0);
+}
+
+/**
+ * Stamps a multicast we publish with our epoch and the next sequence
+ * number of its group.  The receivers keep a new window for a new
+ * epoch, so they do not mistake the multicasts of a restarted service
+ * for duplicates.
+ *
+ * @param msg the multicast
+ */
+static void
+stamp_multicast(struct GNUNET_SCRB_UpdateSubscriber* msg)
+{
+	uint32_t* next_seq = GNUNET_CONTAINER_multihashmap_get(publish_seqs,
+			&msg->group_id);
+
+	if (NULL == next_seq)
+	{
+		next_seq = GNUNET_new(uint32_t);
+		*next_seq = GNUNET_CRYPTO_random_u32(GNUNET_CRYPTO_QUALITY_WEAK, UINT32_MAX);
+		GNUNET_CONTAINER_multihashmap_put(publish_seqs, &msg->group_id, next_seq,
+				GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
+	}
+	msg->seq = htonl((*next_seq)++);
+	msg->epoch = htonl(publish_epoch);
+	msg->origin = my_identity;
+}
+
+/**
+ * Checks if the multicast in @a frame was received before, over the
+ * tree or through the DHT
+ *
+ * @param frame frame holding the multicast
+ * @return #GNUNET_YES if it is a duplicate
+ */
+static int
+is_duplicate(const struct GNUNET_SCRB_Frame* frame)
+{
+	const struct GNUNET_SCRB_UpdateSubscriber* msg =
+			(const struct GNUNET_SCRB_UpdateSubscriber*) GNUNET_SCRB_frame_msg(frame);
+	struct DedupEntry* de;
+	struct GNUNET_HashCode key;
+
+	GNUNET_SCRB_dedup_key(&msg->group_id, &msg->origin, ntohl(msg->epoch), &key);
+	de = GNUNET_CONTAINER_multihashmap_get(dedup_windows, &key);
+	if (NULL == de)
+	{
+		de = GNUNET_new(struct DedupEntry);
+		GNUNET_CONTAINER_multihashmap_put(dedup_windows, &key, de,
+				GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
+	}
+	/* replays must not keep the window of a silent publisher alive */
+	if (GNUNET_NO == GNUNET_SCRB_dedup_check(&de->win, ntohl(msg->seq)))
+	{
+		de->last_seen = GNUNET_TIME_absolute_get();
+		return GNUNET_NO;
+	}
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# multicast: duplicates dropped"),
+			1, GNUNET_NO);
+	return GNUNET_YES;
+}
+
+/**
+ * Frees the window of a publisher which was silent for
+ * #DEDUP_WINDOW_LIFETIME
+ *
+ * @param cls unused
+ * @param key key of the window
+ * @param value the `struct DedupEntry`
+ * @return #GNUNET_YES to continue
+ */
+static int
+expire_dedup_window(void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
+{
+	struct DedupEntry* de = value;
+
+	if (GNUNET_TIME_absolute_get_duration(de->last_seen).rel_value_us <
+			DEDUP_WINDOW_LIFETIME.rel_value_us)
+		return GNUNET_YES;
+	GNUNET_CONTAINER_multihashmap_remove(dedup_windows, key, de);
+	GNUNET_free(de);
+	return GNUNET_YES;
+}
+
+/**
+ * Frees the windows of the silent publishers
+ *
+ * @param cls unused
+ * @param tc scheduler context
+ */
+static void
+expire_dedup_windows(void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	dedup_task = GNUNET_SCHEDULER_NO_TASK;
+	GNUNET_CONTAINER_multihashmap_iterate(dedup_windows,
+			&expire_dedup_window, NULL);
+	GNUNET_STATISTICS_set(scrb_stats, gettext_noop("# multicast: sequence windows"),
+			GNUNET_CONTAINER_multihashmap_size(dedup_windows), GNUNET_NO);
+	dedup_task = GNUNET_SCHEDULER_add_delayed(DEDUP_WINDOW_LIFETIME,
+			&expire_dedup_windows, NULL);
+}
+
+/**
+ * Delivers the multicast held in @a frame to the children of the group
+ * and to the local subscribers, and in #bidirectional mode to the
+ * parent.  The neighbours share the frame, no per-child message is
+ * built here.  Nothing goes back to @a stop_peer.
+ */
 void receive_multicast(const struct GNUNET_HashCode* key,
 		const struct GNUNET_PeerIdentity* my_identity,
 		const struct GNUNET_PeerIdentity* stop_peer,
 		const struct GNUNET_CONTAINER_MultiHashMap* groups,
-		const struct GNUNET_BLOCK_SCRB_Multicast* multicast_block,
+		struct GNUNET_SCRB_Frame* frame,
 		const struct GNUNET_CONTAINER_MultiHashMap* subscribers,
 		const struct GNUNET_CONTAINER_MultiHashMap* clients) {
+	/* duplicates would be fanned out to the whole subtree again */
+	if (GNUNET_YES == is_duplicate(frame))
+		return;
 	struct GNUNET_SCRB_Group* group = GNUNET_CONTAINER_multihashmap_get(groups,
 			key);
+	/* peers unknown to the intern table are no neighbours, 0 matches none */
+	GNUNET_PEER_Id stop = (NULL == stop_peer) ? 0 : GNUNET_PEER_search(stop_peer);
 	if (NULL != group) {
 		struct GNUNET_SCRB_GroupSubscriber* gs = group->group_head;
+		/* built once for all children when the first one needs it */
+		struct GNUNET_SCRB_Frame* down = NULL;
+		GNUNET_PEER_Id self = GNUNET_PEER_search(my_identity);
+		unsigned int sent = 0;
 		while (NULL != gs) {
-			if ((0	!= memcmp(&gs->sid, &my_identity,	sizeof(struct GNUNET_PeerIdentity))) &&
-					(stop_peer == NULL || (0 != memcmp(&gs->sid, stop_peer,	sizeof(struct GNUNET_PeerIdentity))))) {
-				const char* msgu = "# receive MC: message is sent from: ";
-				update_stats(msgu, my_identity, &gs->sid, key, scrb_stats);
-
-				struct GNUNET_SCRB_UpdateSubscriber *msg;
-				size_t msg_size = sizeof(struct GNUNET_SCRB_UpdateSubscriber);
-				struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(msg, 	GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
-
-				msg->header.size = htons((uint16_t) msg_size);
-				msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
-				msg->data = multicast_block->data;
-				msg->group_id = multicast_block->group_id;
-				msg->last = multicast_block->last;
-
-				GNUNET_MQ_send(gs->mq_l, ev);
+			if ((gs->sid != self) && (gs->sid != stop)) {
+				if (NULL == down)
+					down = create_down_frame(group, frame);
+				GSS_NEIGHBOURS_send(gs->link_l, down);
+				sent++;
 			}
 			gs = gs->next;
 		}
+		if (NULL != down)
+			GNUNET_SCRB_frame_unref(down);
+		/* one update per message, not per child */
+		if (sent > 0)
+			GNUNET_STATISTICS_update(scrb_stats,
+					gettext_noop("# multicast: sent to children"), sent, GNUNET_NO);
 	}
-	struct GNUNET_SCRB_ServiceSubscription* subs =
-			GNUNET_CONTAINER_multihashmap_get(subscribers, key);
-	if (NULL != subs) {
-		struct GNUNET_SCRB_ServiceSubscriber* sub = subs->sub_head;
-		while (NULL != sub) {
-			struct GNUNET_SCRB_UpdateSubscriber *msg;
-			size_t msg_size = sizeof(struct GNUNET_SCRB_UpdateSubscriber);
-			struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(msg,
-					GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
-
-			msg->header.size = htons((uint16_t) msg_size);
-			msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
-			msg->data = multicast_block->data;
-			msg->group_id = multicast_block->group_id;
-			msg->last = multicast_block->last;
-
-			struct ClientEntry* ce = GNUNET_CONTAINER_multihashmap_get(clients,
-					&sub->cid);
-			if(NULL != ce)
-				GNUNET_MQ_send(ce->mq, ev);
-
-			sub = sub->next;
-		}
+	if (GNUNET_YES == bidirectional) {
+		struct GNUNET_SCRB_GroupParent* parent =
+				GNUNET_CONTAINER_multihashmap_get(parents, key);
+		if ((NULL != parent) && (parent->parent != stop))
+			service_send_multicast_to_parent(parent, frame);
 	}
+	/* our own multicasts reached the local subscribers when we published them */
+	const struct GNUNET_SCRB_UpdateSubscriber* msg =
+			(const struct GNUNET_SCRB_UpdateSubscriber*) GNUNET_SCRB_frame_msg(frame);
+	if (0 == memcmp(&msg->origin, my_identity, sizeof(struct GNUNET_PeerIdentity)))
+		return;
+	struct StripedGroup* sg = GNUNET_CONTAINER_multihashmap_get(stripes, key);
+	if ((NULL != sg) && (NULL != sg->assembly))
+		receive_stripe_chunk(sg, frame);
+	send_frame_to_subscribers(key, frame, subscribers, clients);
 }
 
 void deliver_join(
@@ -512,54 +1339,148 @@ void deliver_join(
 	GNUNET_STATISTICS_update(scrb_stats,
 			gettext_noop("# deliver: overall JOIN messages received"), 1,
 			GNUNET_NO);
-	struct GNUNET_SCRB_Group* group = GNUNET_CONTAINER_multihashmap_get(groups,
-			key);
-	if (group != NULL) {
-		struct GNUNET_SCRB_GroupSubscriber* gs = group->group_head;
-		uint32_t found = 0;
-		while (NULL != gs) {
-			if (0 == memcmp(&gs->sid, &path[path_length - 1], sizeof(struct GNUNET_PeerIdentity)))
-				found = 1;
-			gs = gs->next;
-		}
-		if (found == 0) {
-			struct GNUNET_SCRB_GroupSubscriber* group_subscriber =
-					createGroupSubscriber(key, data, path[path_length - 1],
-							groups);
-			group_subscriber = createGroupSubscriber(key, data, path[path_length - 1],
-					groups);
-			service_send_parent(group_subscriber);
-			//			service_confirm_subscription(group_subscriber);
-		}
-	}
+	if (GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains(groups, key))
+		adopt_child(key, data, &path[path_length - 1], PUSH_DOWN_TTL);
 }
 
-void
-deliver (void *cls,
-		enum GNUNET_BLOCK_Type type,
-		unsigned int path_length,
-		const struct GNUNET_PeerIdentity *path,
-		const struct GNUNET_HashCode *key,
-		const void *data,
-		size_t size)
+/**
+ * A cached root of a tree
+ */
+struct RootEntry
 {
-	switch (type) {
-	case GNUNET_BLOCK_SCRB_TYPE_CREATE:
+	/**
+	 * Id of the group or stripe
+	 */
+	struct GNUNET_HashCode group_id;
+	/**
+	 * The root
+	 */
+	struct GNUNET_PeerIdentity rp;
+	/**
+	 * When the entry is not used any more
+	 */
+	struct GNUNET_TIME_Absolute expires;
+};
+
+/**
+ * Remembers the root of a tree for #ROOT_CACHE_LIFETIME
+ *
+ * @param group_id id of the group or stripe
+ * @param rp the root
+ */
+static void
+cache_root(const struct GNUNET_HashCode* group_id,
+		const struct GNUNET_PeerIdentity* rp)
+{
+	struct RootEntry* re = GNUNET_CONTAINER_multihashmap_get(roots, group_id);
+
+	if (NULL == re)
 	{
-		const char* msg = "# deliver: CREATE messages received from: ";
-		update_stats(msg, &path[0], &my_identity, key, scrb_stats);
-		GNUNET_STATISTICS_update (scrb_stats,
-				gettext_noop ("# deliver: overall CREATE messages received"),
-				1, GNUNET_NO);
-		struct GNUNET_SCRB_Group* group = createGroup(key, data, groups);
-		service_confirm_creation(group);
-		break;
+		re = GNUNET_new(struct RootEntry);
+		re->group_id = *group_id;
+		GNUNET_CONTAINER_multihashmap_put(roots, &re->group_id, re,
+				GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
 	}
-	case GNUNET_BLOCK_SCRB_TYPE_JOIN:
-	{
-		forward_join(key, data, path, path_length, scrb_stats, groups);
-		//		deliver_join(path, path_length, &my_identity, key, data, scrb_stats,
-		//				groups);
+	else if (0 != memcmp(&re->rp, rp, sizeof(struct GNUNET_PeerIdentity)))
+		GNUNET_STATISTICS_update(scrb_stats,
+				gettext_noop("# roots: changed"), 1, GNUNET_NO);
+	re->rp = *rp;
+	re->expires = GNUNET_TIME_relative_to_absolute(ROOT_CACHE_LIFETIME);
+}
+
+/**
+ * Forgets the cached root of a tree
+ *
+ * @param group_id id of the group or stripe
+ */
+static void
+forget_root(const struct GNUNET_HashCode* group_id)
+{
+	struct RootEntry* re = GNUNET_CONTAINER_multihashmap_get(roots, group_id);
+
+	if (NULL == re)
+		return;
+	GNUNET_CONTAINER_multihashmap_remove(roots, group_id, re);
+	GNUNET_free(re);
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# roots: invalidated"), 1, GNUNET_NO);
+}
+
+/**
+ * Looks up the root of a tree
+ *
+ * @param group_id id of the group or stripe
+ * @return the root, NULL if it is unknown or the entry is too old
+ */
+static const struct GNUNET_PeerIdentity*
+lookup_root(const struct GNUNET_HashCode* group_id)
+{
+	struct RootEntry* re = GNUNET_CONTAINER_multihashmap_get(roots, group_id);
+
+	if (NULL == re)
+		return NULL;
+	if (0 == GNUNET_TIME_absolute_get_remaining(re->expires).rel_value_us)
+	{
+		forget_root(group_id);
+		return NULL;
+	}
+	return &re->rp;
+}
+
+/**
+ * Tells @a peer whether we are the root of a tree
+ *
+ * @param peer a publisher
+ * @param group_id id of the group or stripe
+ * @param status #GNUNET_YES if we are the root, #GNUNET_NO if not
+ */
+static void
+send_root_announce(const struct GNUNET_PeerIdentity* peer,
+		const struct GNUNET_HashCode* group_id,
+		int status)
+{
+	struct GNUNET_SCRB_RootAnnounce* msg;
+	struct GNUNET_SCRB_Frame* frame = create_control_frame(
+			GNUNET_MESSAGE_TYPE_SCRB_ROOT_ANNOUNCE,
+			sizeof(struct GNUNET_SCRB_RootAnnounce));
+
+	msg = (struct GNUNET_SCRB_RootAnnounce*) GNUNET_SCRB_frame_msg(frame);
+	msg->group_id = *group_id;
+	msg->status = htonl((uint32_t) status);
+	GSS_NEIGHBOURS_send_frame(peer, frame);
+	GNUNET_SCRB_frame_unref(frame);
+	GNUNET_STATISTICS_update(scrb_stats,
+			(GNUNET_YES == status)
+			? gettext_noop("# roots: announced")
+			: gettext_noop("# roots: disowned"), 1, GNUNET_NO);
+}
+
+void
+deliver (void *cls,
+		enum GNUNET_BLOCK_Type type,
+		unsigned int path_length,
+		const struct GNUNET_PeerIdentity *path,
+		const struct GNUNET_HashCode *key,
+		const void *data,
+		size_t size)
+{
+	switch ((int) type) {
+	case GNUNET_BLOCK_SCRB_TYPE_CREATE:
+	{
+		const char* msg = "# deliver: CREATE messages received from: ";
+		update_stats(msg, &path[0], &my_identity, key, scrb_stats);
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# deliver: overall CREATE messages received"),
+				1, GNUNET_NO);
+		struct GNUNET_SCRB_Group* group = createGroup(key, data, groups);
+		service_confirm_creation(group);
+		break;
+	}
+	case GNUNET_BLOCK_SCRB_TYPE_JOIN:
+	{
+		forward_join(key, data, path, path_length, GNUNET_YES, scrb_stats, groups);
+		//		deliver_join(path, path_length, &my_identity, key, data, scrb_stats,
+		//				groups);
 		break;
 	}
 	case GNUNET_BLOCK_SCRB_TYPE_MULTICAST:
@@ -571,15 +1492,35 @@ deliver (void *cls,
 				1, GNUNET_NO);
 		struct GNUNET_BLOCK_SCRB_Multicast* multicast_block;
 		multicast_block = (struct GNUNET_BLOCK_SCRB_Multicast*) data;
-		receive_multicast(key, &my_identity, NULL, groups, multicast_block, subscribers, clients);
+		if ((size < sizeof(struct GNUNET_BLOCK_SCRB_Multicast)) ||
+				(size != sizeof(struct GNUNET_BLOCK_SCRB_Multicast) +
+						ntohl(multicast_block->data.data_size)))
+		{
+			GNUNET_break_op(0);
+			break;
+		}
+		struct GNUNET_SCRB_Frame* frame = create_multicast_frame(&multicast_block->group_id,
+				multicast_block->last, &multicast_block[1],
+				ntohl(multicast_block->data.data_size));
+		struct GNUNET_SCRB_UpdateSubscriber* mc_msg =
+				(struct GNUNET_SCRB_UpdateSubscriber*) GNUNET_SCRB_frame_msg(frame);
+		mc_msg->seq = multicast_block->seq;
+		mc_msg->epoch = multicast_block->epoch;
+		mc_msg->origin = multicast_block->origin;
+		receive_multicast(key, &my_identity, NULL, groups, frame, subscribers, clients);
+		GNUNET_SCRB_frame_unref(frame);
+		/* the publisher does not know us, it sends over CORE from now on */
+		if ((GNUNET_YES == is_tree_root(key)) &&
+				(0 != memcmp(&multicast_block->origin, &my_identity,
+						sizeof(struct GNUNET_PeerIdentity))))
+			send_root_announce(&multicast_block->origin, key, GNUNET_YES);
 		break;
 	}
 	case GNUNET_BLOCK_SCRB_TYPE_LEAVE:
 	{
 		struct GNUNET_BLOCK_SCRB_Leave* leave_block;
 		leave_block = (struct GNUNET_BLOCK_SCRB_Leave*) data;
-		struct GNUNET_HashCode sid = leave_block->sid;
-		leaveGroup(key, &sid, groups, parents);
+		leaveGroup(key, &leave_block->sid, GNUNET_YES, groups, parents);
 		const char* msg = "# deliver: LEAVE messages received from: ";
 		update_stats(msg, &path[path_length - 1], &my_identity, key, scrb_stats);
 		GNUNET_STATISTICS_update (scrb_stats,
@@ -592,46 +1533,359 @@ deliver (void *cls,
 	}
 }
 
+/**
+ * Finds the child @a peer of a group
+ *
+ * @param group the group
+ * @param peer the child
+ * @return the child entry, NULL if @a peer is no child of the group
+ */
+static struct GNUNET_SCRB_GroupSubscriber*
+find_child(const struct GNUNET_SCRB_Group* group,
+		const struct GNUNET_PeerIdentity* peer)
+{
+	GNUNET_PEER_Id sid = GNUNET_PEER_search(peer);
+
+	/* a peer which is not interned is no child of any group */
+	if (0 == sid)
+		return NULL;
+	return GNUNET_SCRB_group_find_child(group, sid);
+}
+
+/**
+ * Checks if @a peer may forward the tree @a key.  The interior nodes
+ * of the stripes of a group are disjoint as in SplitStream: a peer
+ * forwards only the stripe whose index is the first digit of its hashed
+ * id modulo the number of stripes, with 16 stripes the stripe sharing
+ * its prefix.  Any peer may forward a plain group.
+ *
+ * @param peer the peer
+ * @param key id of the group or stripe
+ * @param k number of stripes of the group, 0 for a plain group
+ * @return #GNUNET_YES if @a peer may have children in the tree
+ */
+static int
+may_forward(const struct GNUNET_PeerIdentity* peer,
+		const struct GNUNET_HashCode* key,
+		unsigned int k)
+{
+	struct GNUNET_HashCode peer_hash;
+
+	if (0 == k)
+		return GNUNET_YES;
+	GNUNET_CRYPTO_hash(peer, sizeof(struct GNUNET_PeerIdentity), &peer_hash);
+	return (GNUNET_SCRB_stripe_index(&peer_hash) % k ==
+			GNUNET_SCRB_stripe_index(key)) ? GNUNET_YES : GNUNET_NO;
+}
+
+/**
+ * Checks the number of stripes @a k a peer claims for the tree @a key
+ *
+ * @return #GNUNET_OK if @a k is 0 or @a key is a stripe of @a k stripes
+ */
+static int
+check_stripes(const struct GNUNET_HashCode* key, unsigned int k)
+{
+	if (0 == k)
+		return GNUNET_OK;
+	return ((k <= GNUNET_SCRB_MAX_STRIPES) &&
+			(GNUNET_SCRB_stripe_index(key) < k)) ? GNUNET_OK : GNUNET_SYSERR;
+}
+
+/**
+ * Selects the child of a group a joining peer is pushed down to.  As
+ * in Pastry the child closest to the joining peer in the id space is
+ * taken.  In a stripe only children which may forward it are taken.
+ *
+ * @param group the group
+ * @param peer the joining peer
+ * @param k number of stripes of the group, 0 for a plain group
+ * @return the child, NULL if the group has no other child
+ */
+static struct GNUNET_SCRB_GroupSubscriber*
+select_push_down_child(const struct GNUNET_SCRB_Group* group,
+		const struct GNUNET_PeerIdentity* peer,
+		unsigned int k)
+{
+	struct GNUNET_SCRB_GroupSubscriber* gs;
+	struct GNUNET_SCRB_GroupSubscriber* best = NULL;
+	struct GNUNET_HashCode peer_hash;
+	struct GNUNET_HashCode sidh;
+	GNUNET_PEER_Id peer_id = GNUNET_PEER_search(peer);
+	unsigned int bits;
+	unsigned int best_bits = 0;
+
+	GNUNET_CRYPTO_hash(peer, sizeof(struct GNUNET_PeerIdentity), &peer_hash);
+	for (gs = group->group_head; NULL != gs; gs = gs->next)
+	{
+		if ((gs->sid == peer_id) || (gs->sid == my_peer_id))
+			continue;
+		if (GNUNET_YES != may_forward(GNUNET_PEER_resolve2(gs->sid),
+				&group->group_id, k))
+			continue;
+		/* push downs are rare, the hashes are not kept per edge */
+		GNUNET_CRYPTO_hash(GNUNET_PEER_resolve2(gs->sid),
+				sizeof(struct GNUNET_PeerIdentity), &sidh);
+		bits = GNUNET_CRYPTO_hash_matching_bits(&sidh, &peer_hash);
+		if ((NULL == best) || (bits > best_bits))
+		{
+			best = gs;
+			best_bits = bits;
+		}
+	}
+	return best;
+}
+
+/**
+ * Asks the child @a gs to adopt the joining peer @a child
+ */
+static void
+send_push_down(const struct GNUNET_SCRB_GroupSubscriber* gs,
+		const struct GNUNET_HashCode* key,
+		const struct GNUNET_BLOCK_SCRB_Join* join_block,
+		const struct GNUNET_PeerIdentity* child,
+		unsigned int ttl)
+{
+	struct GNUNET_SCRB_PushDownJoin* msg;
+	struct GNUNET_SCRB_Frame* frame;
+
+	frame = GNUNET_SCRB_frame_alloc(sizeof(struct GNUNET_SCRB_PushDownJoin));
+	msg = (struct GNUNET_SCRB_PushDownJoin*) GNUNET_SCRB_frame_msg(frame);
+	msg->header.size = htons(sizeof(struct GNUNET_SCRB_PushDownJoin));
+	msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_PUSH_DOWN_JOIN);
+	msg->group_id = *key;
+	msg->child = *child;
+	msg->oid = join_block->sid;
+	msg->cid = join_block->cid;
+	msg->ttl = htonl(ttl);
+	msg->stripes = join_block->stripes;
+	GSS_NEIGHBOURS_send(gs->link_l, frame);
+	GNUNET_SCRB_frame_unref(frame);
+}
+
+/**
+ * Checks if @a peer is among the @a n peers in @a visited
+ */
+static int
+was_visited(const struct GNUNET_PeerIdentity* visited,
+		unsigned int n,
+		const struct GNUNET_PeerIdentity* peer)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		if (0 == memcmp(&visited[i], peer, sizeof(struct GNUNET_PeerIdentity)))
+			return GNUNET_YES;
+	return GNUNET_NO;
+}
+
+/**
+ * Takes one step of a spare capacity anycast which visited the @a n
+ * peers in @a visited.  The anycast descends to the first child of the
+ * spare capacity group it did not visit yet and returns to the parent
+ * once all children were visited.  This peer is added to the visited
+ * peers the first time the anycast passes it.
+ *
+ * @param msg the anycast
+ * @param n number of visited peers
+ * @return #GNUNET_OK if the anycast was sent on, #GNUNET_NO if the
+ *         tree is exhausted
+ */
+static int
+spare_anycast_forward(const struct GNUNET_SCRB_SpareAnycast* msg,
+		unsigned int n)
+{
+	const struct GNUNET_PeerIdentity* visited =
+			(const struct GNUNET_PeerIdentity*) &msg[1];
+	const struct GNUNET_PeerIdentity* next = NULL;
+	struct GNUNET_SCRB_Group* group;
+	struct GNUNET_SCRB_GroupParent* parent;
+	struct GNUNET_SCRB_GroupSubscriber* gs;
+	struct GNUNET_SCRB_SpareAnycast* out;
+	struct GNUNET_SCRB_Frame* frame;
+	unsigned int new_n = n;
+	size_t size;
+
+	if (GNUNET_NO == was_visited(visited, n, &my_identity))
+		new_n++;
+	if ((new_n > SPARE_ANYCAST_MAX_VISITED) ||
+			(ntohl(msg->hops) >= SPARE_ANYCAST_MAX_HOPS))
+		return GNUNET_NO;
+	group = GNUNET_CONTAINER_multihashmap_get(groups, &spare_group_id);
+	for (gs = (NULL == group) ? NULL : group->group_head; NULL != gs; gs = gs->next)
+	{
+		if (GNUNET_NO == was_visited(visited, n, GNUNET_PEER_resolve2(gs->sid)))
+		{
+			next = GNUNET_PEER_resolve2(gs->sid);
+			break;
+		}
+	}
+	parent = GNUNET_CONTAINER_multihashmap_get(parents, &spare_group_id);
+	if ((NULL == next) && (NULL != parent))
+		next = GNUNET_PEER_resolve2(parent->parent);
+	if (NULL == next)
+		return GNUNET_NO;
+
+	size = sizeof(struct GNUNET_SCRB_SpareAnycast) +
+			new_n * sizeof(struct GNUNET_PeerIdentity);
+	frame = GNUNET_SCRB_frame_alloc(size);
+	out = (struct GNUNET_SCRB_SpareAnycast*) GNUNET_SCRB_frame_msg(frame);
+	*out = *msg;
+	out->header.size = htons((uint16_t) size);
+	out->visited = htonl(new_n);
+	out->hops = htonl(ntohl(msg->hops) + 1);
+	memcpy(&out[1], visited, n * sizeof(struct GNUNET_PeerIdentity));
+	if (new_n > n)
+		((struct GNUNET_PeerIdentity*) &out[1])[n] = my_identity;
+	GSS_NEIGHBOURS_send_frame(next, frame);
+	GNUNET_SCRB_frame_unref(frame);
+	return GNUNET_OK;
+}
+
+/**
+ * Starts a search of the spare capacity group for a parent of @a child
+ *
+ * @param key id of the group
+ * @param join_block the JOIN of the subscription
+ * @param child the joining peer
+ * @return #GNUNET_OK if the search was started, #GNUNET_NO if this
+ *         peer does not know the spare capacity tree
+ */
+static int
+spare_anycast_start(const struct GNUNET_HashCode* key,
+		const struct GNUNET_BLOCK_SCRB_Join* join_block,
+		const struct GNUNET_PeerIdentity* child)
+{
+	struct GNUNET_SCRB_SpareAnycast msg;
+
+	msg.header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_SPARE_ANYCAST);
+	msg.header.size = htons(sizeof(msg));
+	msg.group_id = *key;
+	msg.child = *child;
+	msg.oid = join_block->sid;
+	msg.cid = join_block->cid;
+	msg.visited = htonl(0);
+	msg.hops = htonl(0);
+	msg.stripes = join_block->stripes;
+	if (GNUNET_OK != spare_anycast_forward(&msg, 0))
+		return GNUNET_NO;
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# spare: anycasts started"), 1, GNUNET_NO);
+	return GNUNET_OK;
+}
+
+/**
+ * Makes @a child a child of this peer in the tree @a key.  If this peer
+ * already forwards to #max_children peers the child is pushed down to
+ * one of the children of the group instead.  The spare capacity group
+ * has a limit of #max_children children of its own.
+ *
+ * @param key id of the group
+ * @param join_block the JOIN of the subscription
+ * @param child the joining peer
+ * @param ttl number of push downs still allowed
+ */
+static void
+adopt_child(const struct GNUNET_HashCode* key,
+		const struct GNUNET_BLOCK_SCRB_Join* join_block,
+		const struct GNUNET_PeerIdentity* child,
+		unsigned int ttl)
+{
+	struct GNUNET_SCRB_Group* group;
+	struct GNUNET_SCRB_GroupSubscriber* gs;
+	int spare = is_spare_group(key);
+	unsigned int used = (GNUNET_YES == spare) ? num_spare_children : num_children;
+	unsigned int k = ntohl(join_block->stripes);
+
+	group = GNUNET_CONTAINER_multihashmap_get(groups, key);
+	if (NULL == group)
+	{
+		struct GNUNET_BLOCK_SCRB_Create create_block;
+		create_block.cid = join_block->cid;
+		create_block.sid = join_block->sid;
+		group = createGroup(key, &create_block, groups);
+	}
+	group->stripes = k;
+	if (NULL != find_child(group, child))
+		return;
+	if ((0 != max_children) && (used >= max_children) && (ttl > 0))
+	{
+		gs = select_push_down_child(group, child, k);
+		if (NULL != gs)
+		{
+			send_push_down(gs, key, join_block, child, ttl - 1);
+			GNUNET_STATISTICS_update(scrb_stats,
+					gettext_noop("# capacity: joins pushed down"), 1, GNUNET_NO);
+			return;
+		}
+		/* the spare capacity tree is not searched for a slot in itself */
+		if ((GNUNET_NO == spare) &&
+				(GNUNET_OK == spare_anycast_start(key, join_block, child)))
+			return;
+		GNUNET_STATISTICS_update(scrb_stats,
+				gettext_noop("# capacity: joins accepted over capacity"), 1,
+				GNUNET_NO);
+	}
+	gs = createGroupSubscriber(key, join_block, *child, groups);
+	service_send_parent(gs);
+}
+
+/**
+ * A JOIN passes this peer on its way to the root of the tree @a key,
+ * or reached it.  The peer adopts the last peer on the path, in a
+ * stripe the last one which may forward the stripe.  Peers which may
+ * not forward a stripe leave its JOINs to the next hops.
+ *
+ * @param key id of the group or stripe
+ * @param data the `struct GNUNET_BLOCK_SCRB_Join`
+ * @param path the path of the JOIN
+ * @param path_length length of @a path
+ * @param root #GNUNET_YES if this peer is the root of the tree
+ * @param scrb_stats statistics handle
+ * @param groups the groups this peer forwards
+ */
 void forward_join(
 		const struct GNUNET_HashCode* key,
 		const void* data,
 		const struct GNUNET_PeerIdentity* path,
 		unsigned int path_length,
+		int root,
 		struct GNUNET_STATISTICS_Handle* scrb_stats,
 		struct GNUNET_CONTAINER_MultiHashMap* groups) {
+	const struct GNUNET_BLOCK_SCRB_Join* join_block = data;
+	const struct GNUNET_PeerIdentity* child = &path[path_length - 1];
+	unsigned int k = ntohl(join_block->stripes);
+	unsigned int i;
+
 	const char* msg = "# forward: JOIN messages received from: ";
 	update_stats(msg, &path[path_length - 1], &my_identity, key, scrb_stats);
 	GNUNET_STATISTICS_update(scrb_stats,
 			gettext_noop("# forward: overall JOIN messages received"), 1,
 			GNUNET_NO);
-	if (!GNUNET_CONTAINER_multihashmap_contains(groups, key))
+	if (GNUNET_OK != check_stripes(key, k))
 	{
-		struct GNUNET_BLOCK_SCRB_Create create_block;
-		struct GNUNET_BLOCK_SCRB_Join* join_block;
-		join_block = (struct GNUNET_BLOCK_SCRB_Join*) data;
-		create_block.cid = join_block->cid;
-		create_block.sid = join_block->sid;
-		createGroup(key, &create_block, groups);
-		struct GNUNET_SCRB_GroupSubscriber* gs = createGroupSubscriber(key,
-				data, path[path_length - 1], groups);
-		service_send_parent(gs);
-	} else //we check if already have the subscriber
-	{
-		struct GNUNET_SCRB_Group* group = GNUNET_CONTAINER_multihashmap_get(
-				groups, key);
-		struct GNUNET_SCRB_GroupSubscriber* gs = group->group_head;
-		uint32_t found = 0;
-		while (NULL != gs) {
-			if (0 == memcmp(&gs->sid, &path[path_length - 1], sizeof(struct GNUNET_PeerIdentity)))
-				found = 1;
-
-			gs = gs->next;
-		}
-		if (found == 0) {
-			struct GNUNET_SCRB_GroupSubscriber* gs = createGroupSubscriber(key, data, path[path_length - 1], groups);
-			service_send_parent(gs);
+		GNUNET_break_op(0);
+		return;
+	}
+	if (0 != k)
+	{
+		if ((GNUNET_YES != root) && (GNUNET_YES != may_forward(&my_identity, key, k)))
+		{
+			GNUNET_STATISTICS_update(scrb_stats,
+					gettext_noop("# stripes: JOINs left to the next hops"), 1,
+					GNUNET_NO);
+			return;
 		}
+		/* the hops since the last forwarder of the stripe did not adopt */
+		child = &join_block->sid;
+		for (i = path_length; i > 0; i--)
+			if (GNUNET_YES == may_forward(&path[i - 1], key, k))
+			{
+				child = &path[i - 1];
+				break;
+			}
 	}
+	adopt_child(key, join_block, child, PUSH_DOWN_TTL);
 }
 
 void
@@ -643,10 +1897,10 @@ forward (void *cls,
 		const void *data,
 		size_t size)
 {
-	switch (type) {
+	switch ((int) type) {
 	case GNUNET_BLOCK_SCRB_TYPE_JOIN:
 	{
-		forward_join(key, data, path, path_length, scrb_stats, groups);
+		forward_join(key, data, path, path_length, GNUNET_NO, scrb_stats, groups);
 		break;
 	}
 	case GNUNET_BLOCK_SCRB_TYPE_LEAVE:
@@ -656,8 +1910,7 @@ forward (void *cls,
 				1, GNUNET_NO);
 		struct GNUNET_BLOCK_SCRB_Leave* leave_block;
 		leave_block = (struct GNUNET_BLOCK_SCRB_Leave*) data;
-		struct GNUNET_HashCode sid = leave_block->sid;
-		leaveGroup(key, &sid, groups, parents);
+		leaveGroup(key, &leave_block->sid, GNUNET_YES, groups, parents);
 		break;
 	}
 	}
@@ -677,128 +1930,1144 @@ core_init (void *cls,
 	GNUNET_CRYPTO_hash (identity,
 			sizeof (struct GNUNET_PeerIdentity),
 			&my_identity_hash);
+	my_peer_id = GNUNET_PEER_intern(identity);
 
-	mq = GNUNET_CORE_mq_create (core_api, identity);
-
+	/* peers with a limited capacity offer their free slots to orphans */
+	schedule_spare_check();
 }
 
-static void
-handle_core_connect (void *cls, const struct GNUNET_PeerIdentity *peer)
+/**
+ * Groups a neighbour is dropped from
+ */
+struct LaggingChildContext
 {
-	printf("handle core connect ... \n");
-}
+	/**
+	 * The lagging child
+	 */
+	const struct GNUNET_PeerIdentity* peer;
+	/**
+	 * Ids of the groups the child belongs to
+	 */
+	struct GNUNET_HashCode* group_ids;
+	/**
+	 * Number of entries in @e group_ids
+	 */
+	unsigned int num_groups;
+};
 
-static void
-handle_core_disconnect (void *cls, const struct GNUNET_PeerIdentity *peer)
+/**
+ * Collects the groups a lagging child belongs to
+ *
+ * @param cls the `struct LaggingChildContext`
+ * @param key group id
+ * @param value the `struct GNUNET_SCRB_Group`
+ * @return #GNUNET_YES to continue
+ */
+static int
+collect_child_groups (void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
 {
-	printf("handle core disconnect ... \n");
+	struct LaggingChildContext* ctx = cls;
+
+	if (NULL != find_child(value, ctx->peer))
+		GNUNET_array_append(ctx->group_ids, ctx->num_groups, *key);
+	return GNUNET_YES;
 }
 
+/**
+ * Collects the groups whose parent is a lost neighbour
+ *
+ * @param cls the `struct LaggingChildContext`
+ * @param key group id
+ * @param value the `struct GNUNET_SCRB_GroupParent`
+ * @return #GNUNET_YES to continue
+ */
 static int
-handle_service_confirm_leave (void *cls,
-		const struct GNUNET_PeerIdentity *other,
-		const struct GNUNET_MessageHeader *message)
+collect_parent_groups (void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
 {
-	struct GNUNET_SCRB_ServiceReplyLeave *hdr;
-	hdr = (struct GNUNET_SCRB_ServiceReplyLeave *) message;
+	struct LaggingChildContext* ctx = cls;
+	struct GNUNET_SCRB_GroupParent* parent = value;
 
-	struct GNUNET_HashCode sub_hash;
-	GNUNET_CRYPTO_hkdf (&sub_hash, sizeof (struct GNUNET_HashCode),
-			GCRY_MD_SHA512, GCRY_MD_SHA256,
-			&hdr->cid, sizeof (struct GNUNET_HashCode),
-			&hdr->group_id, sizeof (struct GNUNET_HashCode),
-			NULL, 0);
-	struct GNUNET_SCRB_ServiceSubscriber* sub ;
-	sub = GNUNET_CONTAINER_multihashmap_get(subscribers, &sub_hash);
-	GNUNET_CONTAINER_multihashmap_remove(subscribers, &sub_hash, sub);
-	GNUNET_free(sub);
-	return GNUNET_OK;
+	if (GNUNET_PEER_search(ctx->peer) == parent->parent)
+		GNUNET_array_append(ctx->group_ids, ctx->num_groups, *key);
+	return GNUNET_YES;
 }
 
+/**
+ * Collects the groups whose cached root is a lost neighbour
+ *
+ * @param cls the `struct LaggingChildContext`
+ * @param key group id
+ * @param value the `struct RootEntry`
+ * @return #GNUNET_YES to continue
+ */
 static int
-handle_service_confirm_creation (void *cls,
-		const struct GNUNET_PeerIdentity *other,
-		const struct GNUNET_MessageHeader *message)
+collect_root_groups (void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
 {
-	struct GNUNET_SCRB_ServiceReplyCreate *hdr;
-	hdr = (struct GNUNET_SCRB_ServiceReplyCreate *) message;
+	struct LaggingChildContext* ctx = cls;
+	struct RootEntry* re = value;
 
-	struct ClientEntry *ce;
-	ce = GNUNET_CONTAINER_multihashmap_get(clients, &hdr->cid);
+	if (0 == memcmp(&re->rp, ctx->peer, sizeof(struct GNUNET_PeerIdentity)))
+		GNUNET_array_append(ctx->group_ids, ctx->num_groups, *key);
+	return GNUNET_YES;
+}
 
-	struct GNUNET_SCRB_ServicePublisher* pub = GNUNET_new(struct GNUNET_SCRB_ServicePublisher);
+/**
+ * Drops @a peer from all groups it is a child of
+ *
+ * @param peer the child
+ * @param confirm #GNUNET_YES to confirm the leave to the child
+ * @return number of groups the child was dropped from
+ */
+static unsigned int
+drop_child(const struct GNUNET_PeerIdentity *peer, int confirm)
+{
+	struct LaggingChildContext ctx;
+	unsigned int i;
+
+	ctx.peer = peer;
+	ctx.group_ids = NULL;
+	ctx.num_groups = 0;
+	GNUNET_CONTAINER_multihashmap_iterate(groups, &collect_child_groups, &ctx);
+	for (i = 0; i < ctx.num_groups; i++)
+		leaveGroup(&ctx.group_ids[i], peer, confirm, groups, parents);
+	GNUNET_array_grow(ctx.group_ids, ctx.num_groups, 0);
+	return i;
+}
 
-	pub->rp = hdr->rp;
-	pub->group_id = *ce->cid;
-	GNUNET_CONTAINER_multihashmap_put(publishers,
-			&pub->group_id,
-			pub,
-			GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE );
+/**
+ * The neighbour queue of a child overflowed too often, the child can
+ * not keep up with the stream.  Drop it from all groups, it has to
+ * join again and will find a parent with spare upload capacity.
+ *
+ * @param cls unused
+ * @param peer the lagging child
+ */
+static void
+handle_lagging_child (void *cls, const struct GNUNET_PeerIdentity *peer)
+{
+	drop_child(peer, GNUNET_YES);
+}
+
+/**
+ * Checks if this peer still needs a parent for a group, that is if it
+ * forwards the group to children or delivers it to local clients
+ *
+ * @param group_id id of the group or stripe
+ */
+static int
+needs_parent(const struct GNUNET_HashCode* group_id)
+{
+	struct StripedGroup* sg = GNUNET_CONTAINER_multihashmap_get(stripes, group_id);
+
+	if ((GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains(groups, group_id)) ||
+			(GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains(subscribers, group_id)) ||
+			((NULL != sg) && (NULL != sg->assembly)))
+		return GNUNET_YES;
+	if (GNUNET_YES != is_spare_group(group_id))
+		return GNUNET_NO;
+	return ((0 != max_children) && (num_children < max_children))
+			? GNUNET_YES : GNUNET_NO;
+}
+
+/**
+ * Picks the client id a JOIN of this peer carries: the one of a local
+ * subscriber, else the one the group was joined with, else the id of
+ * the group itself as for a group no client asked for
+ *
+ * @param group_id id of the group or stripe
+ * @return the client id
+ */
+static const struct GNUNET_HashCode*
+join_cid(const struct GNUNET_HashCode* group_id)
+{
+	struct StripedGroup* sg = GNUNET_CONTAINER_multihashmap_get(stripes, group_id);
+	struct GNUNET_SCRB_ServiceSubscription* subs;
+	struct GNUNET_SCRB_Group* group;
 
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(hdr, GNUNET_MESSAGE_TYPE_SCRB_CREATE_REPLY);
+	subs = GNUNET_CONTAINER_multihashmap_get(subscribers,
+			(NULL != sg) ? &sg->group_id : group_id);
+	if ((NULL != subs) && (NULL != subs->sub_head))
+		return &subs->sub_head->cid;
+	group = GNUNET_CONTAINER_multihashmap_get(groups, group_id);
+	if (NULL != group)
+		return &group->cid;
+	return group_id;
+}
 
-	GNUNET_MQ_send (ce->mq, ev);
+/**
+ * Joins the spare capacity group while this peer has free slots and
+ * leaves it once it is full.  A full peer stays in the tree as long as
+ * it connects spare children to it.
+ *
+ * @param cls unused
+ * @param tc scheduler context
+ */
+static void
+check_spare_membership(void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	spare_task = GNUNET_SCHEDULER_NO_TASK;
+	if (GNUNET_YES != needs_parent(&spare_group_id))
+	{
+		spare_join_sent = GNUNET_TIME_UNIT_ZERO_ABS;
+		prune_tree(&spare_group_id);
+		return;
+	}
+	/* joined, the root, or repaired as an orphan */
+	if ((GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains(parents, &spare_group_id)) ||
+			(GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains(groups, &spare_group_id)))
+		return;
+	/* a JOIN is on its way */
+	if (GNUNET_TIME_absolute_get_duration(spare_join_sent).rel_value_us <
+			JOIN_RETRY_DELAY.rel_value_us)
+		return;
+	if (GNUNET_OK != put_join(&spare_group_id, join_cid(&spare_group_id)))
+		return;
+	spare_join_sent = GNUNET_TIME_absolute_get();
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# spare: groups joined"), 1, GNUNET_NO);
+}
 
+/**
+ * Checks the membership in the spare capacity group once the current
+ * task is done, the number of children changed
+ */
+static void
+schedule_spare_check()
+{
+	if ((0 == max_children) || (GNUNET_SCHEDULER_NO_TASK != spare_task))
+		return;
+	spare_task = GNUNET_SCHEDULER_add_now(&check_spare_membership, NULL);
+}
+
+/**
+ * Joins a group which lost its parent again, if this peer still needs it
+ *
+ * @param group_id id of the group or stripe
+ */
+static void
+rejoin_orphan(const struct GNUNET_HashCode* group_id)
+{
+	struct GNUNET_TIME_Absolute* lost;
+
+	if (GNUNET_YES != needs_parent(group_id))
+		return;
+	lost = GNUNET_new(struct GNUNET_TIME_Absolute);
+	*lost = GNUNET_TIME_absolute_get();
+	if (GNUNET_OK != GNUNET_CONTAINER_multihashmap_put(orphans,
+			group_id, lost,
+			GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY))
+		GNUNET_free(lost);
+	if (GNUNET_OK != put_join(group_id, join_cid(group_id)))
+		return;
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# repair: groups rejoined"), 1, GNUNET_NO);
+}
+
+/**
+ * A neighbour went away.  Groups it was the parent of join again at
+ * once, it is dropped from the groups it was a child of.
+ *
+ * @param cls unused
+ * @param peer the lost neighbour
+ */
+static void
+handle_lost_neighbour (void *cls, const struct GNUNET_PeerIdentity *peer)
+{
+	struct LaggingChildContext ctx;
+	struct GNUNET_SCRB_GroupParent* parent;
+	unsigned int pruned;
+	unsigned int i;
+
+	/* CORE reports its disconnects on shutdown as well */
+	if ((NULL == parents) || (NULL == groups) || (NULL == roots))
+		return;
+	ctx.peer = peer;
+	ctx.group_ids = NULL;
+	ctx.num_groups = 0;
+	if (0 != GNUNET_PEER_search(peer))
+		GNUNET_CONTAINER_multihashmap_iterate(parents, &collect_parent_groups, &ctx);
+	/* forget the dead parents first, so emptied groups do not send it leaves */
+	for (i = 0; i < ctx.num_groups; i++)
+	{
+		parent = GNUNET_CONTAINER_multihashmap_get(parents, &ctx.group_ids[i]);
+		GNUNET_CONTAINER_multihashmap_remove(parents, &ctx.group_ids[i], parent);
+		cleanup_parent(NULL, &ctx.group_ids[i], parent);
+	}
+	pruned = drop_child(peer, GNUNET_NO);
+	for (i = 0; i < ctx.num_groups; i++)
+		rejoin_orphan(&ctx.group_ids[i]);
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# repair: parents lost"), ctx.num_groups, GNUNET_NO);
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# repair: children pruned"), pruned, GNUNET_NO);
+	GNUNET_array_grow(ctx.group_ids, ctx.num_groups, 0);
+	/* publish through the DHT until the new root announces itself */
+	GNUNET_CONTAINER_multihashmap_iterate(roots, &collect_root_groups, &ctx);
+	for (i = 0; i < ctx.num_groups; i++)
+		forget_root(&ctx.group_ids[i]);
+	GNUNET_array_grow(ctx.group_ids, ctx.num_groups, 0);
+}
+
+/**
+ * Returns when the first lease expires, in microseconds
+ */
+static uint64_t
+first_lease_expiry()
+{
+	struct GNUNET_SCRB_GroupSubscriber* gs = GNUNET_CONTAINER_heap_peek(child_leases);
+	struct GNUNET_SCRB_GroupParent* parent = GNUNET_CONTAINER_heap_peek(parent_leases);
+	uint64_t first = UINT64_MAX;
+
+	if (NULL != gs)
+		first = GNUNET_CONTAINER_heap_node_get_cost(gs->lease);
+	if (NULL != parent)
+		first = GNUNET_MIN(first, GNUNET_CONTAINER_heap_node_get_cost(parent->lease));
+	return first;
+}
+
+static void
+expire_leases(void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc);
+
+/**
+ * Runs the lease task when the first lease expires.  Renewals only
+ * move leases to the back, so a running task is never late.
+ */
+static void
+schedule_lease_expiry()
+{
+	struct GNUNET_TIME_Absolute first;
+
+	if (GNUNET_SCHEDULER_NO_TASK != lease_task)
+		return;
+	first.abs_value_us = first_lease_expiry();
+	if (UINT64_MAX == first.abs_value_us)
+		return;
+	lease_task = GNUNET_SCHEDULER_add_delayed(
+			GNUNET_TIME_absolute_get_remaining(first), &expire_leases, NULL);
+}
+
+/**
+ * Grants a lease of #lease_time to a child or parent entry
+ *
+ * @param heap #child_leases or #parent_leases
+ * @param entry the entry
+ * @return the lease
+ */
+static struct GNUNET_CONTAINER_HeapNode*
+grant_lease(struct GNUNET_CONTAINER_Heap* heap, void* entry)
+{
+	struct GNUNET_CONTAINER_HeapNode* lease;
+
+	lease = GNUNET_CONTAINER_heap_insert(heap, entry,
+			GNUNET_TIME_relative_to_absolute(lease_time).abs_value_us);
+	schedule_lease_expiry();
+	return lease;
+}
+
+/**
+ * Extends a lease by #lease_time from now
+ */
+static void
+renew_lease(struct GNUNET_CONTAINER_Heap* heap,
+		struct GNUNET_CONTAINER_HeapNode* lease)
+{
+	if (NULL != lease)
+		GNUNET_CONTAINER_heap_update_cost(heap, lease,
+				GNUNET_TIME_relative_to_absolute(lease_time).abs_value_us);
+}
+
+/**
+ * Removes a lease from its heap
+ */
+static void
+cancel_lease(struct GNUNET_CONTAINER_HeapNode** lease)
+{
+	if (NULL == *lease)
+		return;
+	GNUNET_CONTAINER_heap_remove_node(*lease);
+	*lease = NULL;
+}
+
+/**
+ * Drops the children and parents whose lease expired.  A child that
+ * stopped renewing stops getting data, a group that lost its parent
+ * joins again.
+ *
+ * @param cls unused
+ * @param tc scheduler context
+ */
+static void
+expire_leases(void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	uint64_t now = GNUNET_TIME_absolute_get().abs_value_us;
+	struct GNUNET_SCRB_GroupSubscriber* gs;
+	struct GNUNET_SCRB_GroupParent* parent;
+	struct GNUNET_HashCode group_id;
+	struct GNUNET_PeerIdentity child;
+
+	lease_task = GNUNET_SCHEDULER_NO_TASK;
+	while ((NULL != (gs = GNUNET_CONTAINER_heap_peek(child_leases))) &&
+			(GNUNET_CONTAINER_heap_node_get_cost(gs->lease) <= now))
+	{
+		group_id = gs->group->group_id;
+		child = *GNUNET_PEER_resolve2(gs->sid);
+		cancel_lease(&gs->lease);
+		leaveGroup(&group_id, &child, GNUNET_NO, groups, parents);
+		GNUNET_STATISTICS_update(scrb_stats,
+				gettext_noop("# leases: children expired"), 1, GNUNET_NO);
+	}
+	while ((NULL != (parent = GNUNET_CONTAINER_heap_peek(parent_leases))) &&
+			(GNUNET_CONTAINER_heap_node_get_cost(parent->lease) <= now))
+	{
+		group_id = parent->group_id;
+		GNUNET_CONTAINER_multihashmap_remove(parents, &group_id, parent);
+		cleanup_parent(NULL, &group_id, parent);
+		rejoin_orphan(&group_id);
+		GNUNET_STATISTICS_update(scrb_stats,
+				gettext_noop("# leases: parents expired"), 1, GNUNET_NO);
+	}
+	schedule_lease_expiry();
+}
+
+/**
+ * Groups sent to a neighbour in one go, as lease renewals or as leaves
+ */
+struct GroupBatch
+{
+	/**
+	 * The link to the neighbour, held by the batch
+	 */
+	struct GSS_Neighbour* link;
+	/**
+	 * Ids of the groups
+	 */
+	struct GNUNET_HashCode* group_ids;
+	/**
+	 * Number of entries in @e group_ids
+	 */
+	unsigned int num_groups;
+};
+
+/**
+ * Adds a group to the batch of a link
+ *
+ * @param batches map of peers to `struct GroupBatch`
+ * @param link link to send the group on
+ * @param group_id id of the group
+ */
+static void
+add_to_batch(struct GNUNET_CONTAINER_MultiPeerMap* batches,
+		struct GSS_Neighbour* link,
+		const struct GNUNET_HashCode* group_id)
+{
+	const struct GNUNET_PeerIdentity* peer = GSS_NEIGHBOURS_get_peer(link);
+	struct GroupBatch* batch = GNUNET_CONTAINER_multipeermap_get(batches, peer);
+
+	if (NULL == batch)
+	{
+		batch = GNUNET_new(struct GroupBatch);
+		batch->link = GSS_NEIGHBOURS_acquire(peer);
+		GNUNET_CONTAINER_multipeermap_put(batches, peer, batch,
+				GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
+	}
+	GNUNET_array_append(batch->group_ids, batch->num_groups, *group_id);
+}
+
+/**
+ * Batches the renewals of the leases our children hold from us
+ */
+static int
+collect_child_renewals(void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
+{
+	struct GNUNET_SCRB_Group* group = value;
+	struct GNUNET_SCRB_GroupSubscriber* gs;
+
+	for (gs = group->group_head; NULL != gs; gs = gs->next)
+		add_to_batch(cls, gs->link_l, key);
+	return GNUNET_YES;
+}
+
+/**
+ * Batches the renewals of the leases our parents hold from us
+ */
+static int
+collect_parent_renewals(void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
+{
+	struct GNUNET_SCRB_GroupParent* parent = value;
+
+	add_to_batch(cls, parent->link, key);
+	return GNUNET_YES;
+}
+
+/**
+ * Frees a batch and gives its link back
+ *
+ * @param cls unused
+ * @param key the neighbour
+ * @param value the `struct GroupBatch`
+ * @return #GNUNET_YES to continue
+ */
+static int
+free_batch(void *cls,
+		const struct GNUNET_PeerIdentity *key,
+		void *value)
+{
+	struct GroupBatch* batch = value;
+
+	GSS_NEIGHBOURS_release(batch->link);
+	GNUNET_array_grow(batch->group_ids, batch->num_groups, 0);
+	GNUNET_free(batch);
+	return GNUNET_YES;
+}
+
+/**
+ * Sends the groups of a batch in as few messages as possible and frees
+ * the batch
+ *
+ * @param batch the batch
+ * @param type #GNUNET_MESSAGE_TYPE_SCRB_LEASE_RENEW or
+ *        #GNUNET_MESSAGE_TYPE_SCRB_LEAVE_BATCH
+ * @return number of messages sent
+ */
+static unsigned int
+send_batch(struct GroupBatch* batch, uint16_t type)
+{
+	struct GNUNET_SCRB_GroupList* msg;
+	struct GNUNET_SCRB_Frame* frame;
+	unsigned int sent = 0;
+	unsigned int off;
+	unsigned int n;
+
+	for (off = 0; off < batch->num_groups; off += n)
+	{
+		n = GNUNET_MIN(batch->num_groups - off, GROUP_LIST_MAX_GROUPS);
+		frame = create_control_frame(type,
+				sizeof(struct GNUNET_SCRB_GroupList) +
+				n * sizeof(struct GNUNET_HashCode));
+		msg = (struct GNUNET_SCRB_GroupList*) GNUNET_SCRB_frame_msg(frame);
+		msg->count = htonl(n);
+		memcpy(&msg[1], &batch->group_ids[off], n * sizeof(struct GNUNET_HashCode));
+		send_control_frame(batch->link, frame);
+		sent++;
+	}
+	free_batch(NULL, NULL, batch);
+	return sent;
+}
+
+/**
+ * Sends the renewals of one link
+ *
+ * @param cls unused
+ * @param key the neighbour
+ * @param value the `struct GroupBatch`, freed
+ * @return #GNUNET_YES to continue
+ */
+static int
+send_renewals(void *cls,
+		const struct GNUNET_PeerIdentity *key,
+		void *value)
+{
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# leases: renewals sent"),
+			send_batch(value, GNUNET_MESSAGE_TYPE_SCRB_LEASE_RENEW), GNUNET_NO);
+	return GNUNET_YES;
+}
+
+/**
+ * Renews the leases of all our tree edges, one message per link
+ *
+ * @param cls unused
+ * @param tc scheduler context
+ */
+static void
+renew_leases(void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	struct GNUNET_CONTAINER_MultiPeerMap* batches;
+
+	renew_task = GNUNET_SCHEDULER_NO_TASK;
+	batches = GNUNET_CONTAINER_multipeermap_create(64, GNUNET_NO);
+	GNUNET_CONTAINER_multihashmap_iterate(groups, &collect_child_renewals, batches);
+	GNUNET_CONTAINER_multihashmap_iterate(parents, &collect_parent_renewals, batches);
+	GNUNET_CONTAINER_multipeermap_iterate(batches, &send_renewals, NULL);
+	GNUNET_CONTAINER_multipeermap_destroy(batches);
+	renew_task = GNUNET_SCHEDULER_add_delayed(
+			GNUNET_TIME_relative_divide(lease_time, 3), &renew_leases, NULL);
+}
+
+/**
+ * Sends the leaves to one parent
+ *
+ * @param cls unused
+ * @param key the parent
+ * @param value the `struct GroupBatch`, freed
+ * @return #GNUNET_YES to continue
+ */
+static int
+send_leaves(void *cls,
+		const struct GNUNET_PeerIdentity *key,
+		void *value)
+{
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# leaves: batches sent"),
+			send_batch(value, GNUNET_MESSAGE_TYPE_SCRB_LEAVE_BATCH), GNUNET_NO);
+	return GNUNET_YES;
+}
+
+/**
+ * Sends the leaves collected during the last round, one message per
+ * parent
+ *
+ * @param cls unused
+ * @param tc scheduler context
+ */
+static void
+flush_leaves(void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	struct GNUNET_CONTAINER_MultiPeerMap* batches = leave_batches;
+
+	leave_task = GNUNET_SCHEDULER_NO_TASK;
+	leave_batches = NULL;
+	GNUNET_CONTAINER_multipeermap_iterate(batches, &send_leaves, NULL);
+	GNUNET_CONTAINER_multipeermap_destroy(batches);
+}
+
+/**
+ * Leaves the tree of a group once this peer neither forwards it to
+ * children nor delivers it to local clients.  The leave goes out with
+ * the other leaves of this round to the same parent.
+ *
+ * @param group_id id of the group or stripe
+ */
+static void
+prune_tree(const struct GNUNET_HashCode* group_id)
+{
+	struct GNUNET_SCRB_GroupParent* parent;
+	struct GNUNET_TIME_Absolute* lost;
+
+	if (GNUNET_YES == needs_parent(group_id))
+		return;
+	lost = GNUNET_CONTAINER_multihashmap_get(orphans, group_id);
+	if (NULL != lost)
+	{
+		GNUNET_CONTAINER_multihashmap_remove(orphans, group_id, lost);
+		GNUNET_free(lost);
+	}
+	parent = GNUNET_CONTAINER_multihashmap_get(parents, group_id);
+	if (NULL == parent)
+		return;
+	if (NULL == leave_batches)
+		leave_batches = GNUNET_CONTAINER_multipeermap_create(16, GNUNET_NO);
+	add_to_batch(leave_batches, parent->link, group_id);
+	GNUNET_CONTAINER_multihashmap_remove(parents, group_id, parent);
+	cleanup_parent(NULL, group_id, parent);
+	if (GNUNET_SCHEDULER_NO_TASK == leave_task)
+		leave_task = GNUNET_SCHEDULER_add_now(&flush_leaves, NULL);
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# leaves: groups left"), 1, GNUNET_NO);
+}
+
+static void
+handle_core_connect (void *cls, const struct GNUNET_PeerIdentity *peer)
+{
+	GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+			"Connected to %s\n", GNUNET_i2s (peer));
+	GSS_NEIGHBOURS_heard (peer);
+}
+
+static void
+handle_core_disconnect (void *cls, const struct GNUNET_PeerIdentity *peer)
+{
+	GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+			"Disconnected from %s\n", GNUNET_i2s (peer));
+	GSS_NEIGHBOURS_disconnect (peer);
+	handle_lost_neighbour (cls, peer);
+}
+
+/**
+ * Every message from a neighbour shows it is alive
+ *
+ * @param cls unused
+ * @param other the sender
+ * @param message the message, only its header
+ * @return #GNUNET_OK
+ */
+static int
+handle_core_inbound (void *cls,
+		const struct GNUNET_PeerIdentity *other,
+		const struct GNUNET_MessageHeader *message)
+{
+	GSS_NEIGHBOURS_heard (other);
+	return GNUNET_OK;
+}
+
+static int
+handle_service_confirm_leave (void *cls,
+		const struct GNUNET_PeerIdentity *other,
+		const struct GNUNET_MessageHeader *message)
+{
+	/* the subscription was released when the leave was sent */
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# leaves: confirmed by the parent"), 1, GNUNET_NO);
+	return GNUNET_OK;
+}
+
+static int
+handle_service_confirm_creation (void *cls,
+		const struct GNUNET_PeerIdentity *other,
+		const struct GNUNET_MessageHeader *message)
+{
+	struct GNUNET_SCRB_ServiceReplyCreate *hdr;
+	hdr = (struct GNUNET_SCRB_ServiceReplyCreate *) message;
+
+	struct GNUNET_HashCode group_id = hdr->group_id;
+	struct GNUNET_PeerIdentity rp = hdr->rp;
+	unsigned int k = 1;
+
+	cache_root(&hdr->group_id, &hdr->rp);
+
+	struct StripedGroup* sg = GNUNET_CONTAINER_multihashmap_get(stripes, &hdr->group_id);
+	if (NULL != sg)
+	{
+		unsigned int i = GNUNET_SCRB_stripe_index(&hdr->group_id);
+
+		if (0 != (sg->rp_mask & (1 << i)))
+			return GNUNET_OK;
+		sg->rp[i] = hdr->rp;
+		sg->rp_mask |= (1 << i);
+		if (sg->rp_mask != (1 << sg->stripes) - 1)
+			return GNUNET_OK;
+		/* all stripes exist, the group is listed with its first stripe */
+		group_id = sg->group_id;
+		rp = sg->rp[0];
+		k = sg->stripes;
+	}
+
+	struct GNUNET_SCRB_ServicePublisher* pub = GNUNET_new(struct GNUNET_SCRB_ServicePublisher);
+
+	pub->rp = rp;
+	pub->group_id = group_id;
+	pub->stripes = htonl(k);
+	GNUNET_CONTAINER_multihashmap_put(publishers,
+			&pub->group_id,
+			pub,
+			GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE );
+
+	struct ClientEntry *ce;
+	ce = GNUNET_CONTAINER_multihashmap_get(clients, &hdr->cid);
+	if (NULL == ce)
+		return GNUNET_OK;
+
+	struct GNUNET_SCRB_ServiceReplyCreate *reply;
+	struct GNUNET_SCRB_Frame* frame = create_client_frame(sizeof(*reply),
+			GNUNET_MESSAGE_TYPE_SCRB_CREATE_REPLY);
+
+	reply = (struct GNUNET_SCRB_ServiceReplyCreate *) GNUNET_SCRB_frame_msg(frame);
+	reply->rp = rp;
+	reply->cid = hdr->cid;
+	reply->group_id = group_id;
+	reply->status = hdr->status;
+	send_frame_to_client(ce, frame);
+	GNUNET_SCRB_frame_unref(frame);
+
+	return GNUNET_OK;
+}
+
+static int handle_service_confirm_subscription (
+		void *cls,
+		const struct GNUNET_PeerIdentity *other,
+		const struct GNUNET_MessageHeader *message)
+{
+	struct GNUNET_SCRB_SendParent2Child *hdr;
+	hdr = (struct GNUNET_SCRB_SendParent2Child *) message;
+
+	struct StripedGroup* sg = GNUNET_CONTAINER_multihashmap_get(stripes, &hdr->group_id);
+	if (NULL != sg)
+	{
+		unsigned int i = GNUNET_SCRB_stripe_index(&hdr->group_id);
+
+		/* late for a subscription that was given up */
+		if ((NULL == sg->assembly) || (0 != (sg->joined_mask & (1 << i))))
+			return GNUNET_OK;
+		sg->joined_mask |= (1 << i);
+		if (sg->joined_mask != (1 << sg->stripes) - 1)
+			return GNUNET_OK;
+		/* joined all stripes, confirm to the clients waiting for the group */
+		struct GNUNET_SCRB_ServiceSubscription* subs =
+				GNUNET_CONTAINER_multihashmap_get(subscribers, &sg->group_id);
+		struct GNUNET_SCRB_ServiceSubscriber* sub;
+		for (sub = (NULL == subs) ? NULL : subs->sub_head; NULL != sub; sub = sub->next)
+			send_subscribe_confirmation(sub, clients, GNUNET_OK);
+		return GNUNET_OK;
+	}
+
+	/* the JOIN was not put for a local client or got answered already */
+	struct GNUNET_SCRB_ServiceSubscription* subs =
+			GNUNET_CONTAINER_multihashmap_get(pending_joins, &hdr->group_id);
+	if (NULL == subs)
+		return GNUNET_OK;
+	GNUNET_CONTAINER_multihashmap_remove(pending_joins, &subs->group_id, subs);
+	if (GNUNET_OK != GNUNET_CONTAINER_multihashmap_put(subscribers,
+			&subs->group_id,
+			subs,
+			GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY ))
+	{
+		GNUNET_break(0);
+		free_subs_entry(subs);
+		return GNUNET_OK;
+	}
+
+	struct GNUNET_SCRB_ServiceSubscriber* sub;
+	for (sub = subs->sub_head; NULL != sub; sub = sub->next)
+		send_subscribe_confirmation(sub, clients, GNUNET_OK);
+
+	return GNUNET_OK;
+}
+
+/**
+ * Checks if this peer is the root of the tree of a group
+ *
+ * @param group_id id of the group
+ * @return #GNUNET_YES if we have the group and no parent for it
+ */
+static int
+is_tree_root(const struct GNUNET_HashCode* group_id)
+{
+	if (GNUNET_YES != GNUNET_CONTAINER_multihashmap_contains(groups, group_id))
+		return GNUNET_NO;
+	if (GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains(parents, group_id))
+		return GNUNET_NO;
+	return GNUNET_YES;
+}
+
+/**
+ * Checks if @a peer is our parent in the tree of a group
+ *
+ * @param peer the neighbour
+ * @param group_id id of the group or stripe
+ */
+static int
+is_parent(const struct GNUNET_PeerIdentity* peer,
+		const struct GNUNET_HashCode* group_id)
+{
+	struct GNUNET_SCRB_GroupParent* parent =
+			GNUNET_CONTAINER_multihashmap_get(parents, group_id);
+
+	if ((NULL == parent) || (parent->parent != GNUNET_PEER_search(peer)))
+		return GNUNET_NO;
+	return GNUNET_YES;
+}
+
+/**
+ * Checks if @a peer is our child in the tree of a group
+ *
+ * @param peer the neighbour
+ * @param group_id id of the group or stripe
+ */
+static int
+is_child(const struct GNUNET_PeerIdentity* peer,
+		const struct GNUNET_HashCode* group_id)
+{
+	struct GNUNET_SCRB_Group* group =
+			GNUNET_CONTAINER_multihashmap_get(groups, group_id);
+
+	if ((NULL == group) || (NULL == find_child(group, peer)))
+		return GNUNET_NO;
+	return GNUNET_YES;
+}
+
+static int handle_service_multicast (
+		void *cls,
+		const struct GNUNET_PeerIdentity *other,
+		const struct GNUNET_MessageHeader *message)
+{
+	struct GNUNET_SCRB_UpdateSubscriber *hdr;
+	struct GNUNET_SCRB_Frame* frame;
+	uint16_t msize = ntohs(message->size);
+	uint16_t type = ntohs(message->type);
+	hdr = (struct GNUNET_SCRB_UpdateSubscriber *) message;
+
+	if (GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_BATCH == type)
+	{
+		/* unpack the multicasts the neighbour coalesced */
+		const char* pos = (const char*) &message[1];
+		const char* end = (const char*) message + msize;
+		const struct GNUNET_MessageHeader* inner;
+		uint16_t inner_size;
+
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# handle: MULTICAST batches received"),
+				1, GNUNET_NO);
+		while (pos < end)
+		{
+			inner = (const struct GNUNET_MessageHeader*) pos;
+			if ((end - pos < sizeof(struct GNUNET_MessageHeader)) ||
+					(end - pos < (inner_size = ntohs(inner->size))) ||
+					((GNUNET_MESSAGE_TYPE_SCRB_MULTICAST != ntohs(inner->type)) &&
+					 (GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_DOWN != ntohs(inner->type))))
+			{
+				GNUNET_break_op(0);
+				return GNUNET_SYSERR;
+			}
+			if (GNUNET_OK != handle_service_multicast(cls, other, inner))
+				return GNUNET_SYSERR;
+			pos += inner_size;
+		}
+		return GNUNET_OK;
+	}
+
+	if (GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_DOWN == type)
+	{
+		const struct GNUNET_SCRB_MulticastDown* down =
+				(const struct GNUNET_SCRB_MulticastDown*) message;
+		const struct GNUNET_HashCode* group_id;
+
+		if ((msize < sizeof(struct GNUNET_SCRB_MulticastDown)) ||
+				(msize != sizeof(struct GNUNET_SCRB_MulticastDown) +
+						ntohl(down->data.data_size)))
+		{
+			GNUNET_break_op(0);
+			return GNUNET_SYSERR;
+		}
+		group_id = GSS_NEIGHBOURS_resolve_handle(other, ntohl(down->handle));
+		if (NULL == group_id)
+		{
+			/* we left the group, the parent has not noticed yet */
+			GNUNET_STATISTICS_update (scrb_stats,
+					gettext_noop ("# handle: MULTICAST for unknown group handles"),
+					1, GNUNET_NO);
+			return GNUNET_OK;
+		}
+		frame = expand_down_frame(group_id, down);
+		hdr = (struct GNUNET_SCRB_UpdateSubscriber *) GNUNET_SCRB_frame_msg(frame);
+	}
+	else if ((msize < sizeof(struct GNUNET_SCRB_UpdateSubscriber)) ||
+			(msize != sizeof(struct GNUNET_SCRB_UpdateSubscriber) +
+					ntohl(hdr->data.data_size)))
+	{
+		GNUNET_break_op(0);
+		return GNUNET_SYSERR;
+	}
+	else
+	{
+		frame = GNUNET_SCRB_frame_create(message);
+	}
+
+	const char* msg = "# handle: MULTICAST messages received from: ";
+	update_stats(msg, other, &my_identity, &hdr->group_id, scrb_stats);
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# handle: overall MULTICAST messages received"),
+			1, GNUNET_NO);
+
+	/* the publisher took us for the root, which we are not any more;
+	 * flooding children publish to their parent on purpose */
+	if ((0 == memcmp(&hdr->origin, other, sizeof(struct GNUNET_PeerIdentity))) &&
+			(GNUNET_YES != is_tree_root(&hdr->group_id)) &&
+			(GNUNET_YES != is_parent(other, &hdr->group_id)) &&
+			((GNUNET_YES != bidirectional) ||
+			 (GNUNET_YES != is_child(other, &hdr->group_id))))
+	{
+		/* a forward dropped by a full put queue is counted by the DHT
+		 * module, the publisher learns the root either way */
+		if (GNUNET_OK != multicast_via_dht(hdr))
+			GNUNET_log(GNUNET_ERROR_TYPE_DEBUG,
+					"Dropped multicast forwarded for a stale root\n");
+		send_root_announce(other, &hdr->group_id, GNUNET_NO);
+		GNUNET_SCRB_frame_unref(frame);
+		return GNUNET_OK;
+	}
+
+	/* at the root the data comes from a publisher, which may well be
+	 * one of our children and must get it as well, unless the child
+	 * flooded it to its own part of the tree already */
+	receive_multicast(&hdr->group_id, &my_identity,
+			((GNUNET_YES == is_tree_root(&hdr->group_id)) &&
+			 (GNUNET_YES != bidirectional)) ? NULL : other,
+			groups, frame, subscribers, clients);
+	GNUNET_SCRB_frame_unref(frame);
+
+	return GNUNET_OK;
+}
+
+
+/**
+ * Accounts for the repair of a group which lost its parent
+ *
+ * @param group_id the group which got a parent
+ */
+static void
+group_recovered(const struct GNUNET_HashCode* group_id)
+{
+	struct GNUNET_TIME_Absolute* lost;
+
+	lost = GNUNET_CONTAINER_multihashmap_get(orphans, group_id);
+	if (NULL == lost)
+		return;
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# repair: groups recovered"), 1, GNUNET_NO);
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# repair: total recovery time in ms"),
+			GNUNET_TIME_absolute_get_duration(*lost).rel_value_us / 1000LL,
+			GNUNET_NO);
+	GNUNET_CONTAINER_multihashmap_remove(orphans, group_id, lost);
+	GNUNET_free(lost);
+}
+
+/**
+ * Checks the size of a LEASE_RENEW or LEAVE_BATCH message
+ *
+ * @param message the message
+ * @param n set to the number of groups in the message
+ * @return the group ids, NULL if the message is malformed
+ */
+static const struct GNUNET_HashCode *
+parse_group_list(const struct GNUNET_MessageHeader *message,
+		unsigned int *n)
+{
+	const struct GNUNET_SCRB_GroupList *hdr;
+	uint16_t msize = ntohs(message->size);
+
+	hdr = (const struct GNUNET_SCRB_GroupList *) message;
+	if ((msize < sizeof(struct GNUNET_SCRB_GroupList)) ||
+			((*n = ntohl(hdr->count)) > GROUP_LIST_MAX_GROUPS) ||
+			(msize != sizeof(struct GNUNET_SCRB_GroupList) +
+					*n * sizeof(struct GNUNET_HashCode)))
+		return NULL;
+	return (const struct GNUNET_HashCode *) &hdr[1];
+}
+
+/**
+ * A neighbour renews the leases it holds from us as parent or child
+ */
+static int
+handle_service_lease_renew (void *cls,
+		const struct GNUNET_PeerIdentity *other,
+		const struct GNUNET_MessageHeader *message)
+{
+	const struct GNUNET_HashCode *group_ids;
+	struct GNUNET_SCRB_Group* group;
+	struct GNUNET_SCRB_GroupSubscriber* gs;
+	struct GNUNET_SCRB_GroupParent* parent;
+	GNUNET_PEER_Id id;
+	unsigned int n;
+	unsigned int i;
+
+	group_ids = parse_group_list(message, &n);
+	if (NULL == group_ids)
+	{
+		GNUNET_break_op(0);
+		return GNUNET_SYSERR;
+	}
+	/* not interned, so neither our parent nor our child */
+	id = GNUNET_PEER_search(other);
+	if (0 == id)
+		return GNUNET_OK;
+	for (i = 0; i < n; i++)
+	{
+		group = GNUNET_CONTAINER_multihashmap_get(groups, &group_ids[i]);
+		if ((NULL != group) &&
+				(NULL != (gs = GNUNET_SCRB_group_find_child(group, id))))
+			renew_lease(child_leases, gs->lease);
+		parent = GNUNET_CONTAINER_multihashmap_get(parents, &group_ids[i]);
+		if ((NULL != parent) && (id == parent->parent))
+			renew_lease(parent_leases, parent->lease);
+	}
 	return GNUNET_OK;
 }
 
-static int handle_service_confirm_subscription (
-		void *cls,
+/**
+ * A child leaves several of our groups at once
+ */
+static int
+handle_service_leave_batch (void *cls,
 		const struct GNUNET_PeerIdentity *other,
 		const struct GNUNET_MessageHeader *message)
 {
-	struct GNUNET_SCRB_SendParent2Child *hdr;
-	hdr = (struct GNUNET_SCRB_SendParent2Child *) message;
-
-	struct GNUNET_SCRB_ServiceSubscription* subs = GNUNET_new (struct GNUNET_SCRB_ServiceSubscription);
-
-	struct GNUNET_SCRB_ServiceSubscriber* sub = GNUNET_new(struct GNUNET_SCRB_ServiceSubscriber);
-
-	subs->group_id = hdr->group_id;
-	sub->group_id = hdr->group_id;
-	sub->cid = hdr->cid;
-
-	GNUNET_CONTAINER_DLL_insert(subs->sub_head, subs->sub_tail, sub);
-
-	GNUNET_CONTAINER_multihashmap_put(subscribers,
-			&subs->group_id,
-			subs,
-			GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY );
-
-	send_subscribe_confirmation(sub, clients);
+	const struct GNUNET_HashCode *group_ids;
+	unsigned int n;
+	unsigned int i;
 
+	group_ids = parse_group_list(message, &n);
+	if (NULL == group_ids)
+	{
+		GNUNET_break_op(0);
+		return GNUNET_SYSERR;
+	}
+	for (i = 0; i < n; i++)
+		leaveGroup(&group_ids[i], other, GNUNET_NO, groups, parents);
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# leaves: groups left by children"), n, GNUNET_NO);
 	return GNUNET_OK;
 }
 
-static int handle_service_multicast (
-		void *cls,
+/**
+ * A peer tells us whether it is the root of a tree we publish to.  A
+ * root is only taken while a multicast we routed through the DHT is
+ * on its way to it, unasked announces are ignored.
+ */
+static int
+handle_service_root_announce (void *cls,
 		const struct GNUNET_PeerIdentity *other,
 		const struct GNUNET_MessageHeader *message)
 {
-	struct GNUNET_SCRB_UpdateSubscriber *hdr;
-	hdr = (struct GNUNET_SCRB_UpdateSubscriber *) message;
-
-	const char* msg = "# handle: MULTICAST messages received from: ";
-	update_stats(msg, other, &my_identity, &hdr->group_id, scrb_stats);
-	GNUNET_STATISTICS_update (scrb_stats,
-			gettext_noop ("# handle: overall MULTICAST messages received"),
-			1, GNUNET_NO);
-
-	struct GNUNET_BLOCK_SCRB_Multicast mb;
-
-	mb.data = hdr->data;
-	mb.group_id = hdr->group_id;
-	mb.last = hdr->last;
-
-	//	struct GNUNET_SCRB_GroupParent* parent = GNUNET_CONTAINER_multihashmap_get(parents, &hdr->group_id);
-	//
-	//	service_send_multicast_to_parent(parent, hdr);
-
-	receive_multicast(&hdr->group_id, &my_identity, other, groups, &mb, subscribers, clients);
+	const struct GNUNET_SCRB_RootAnnounce *hdr;
+	const struct GNUNET_PeerIdentity *rp;
+	struct GNUNET_TIME_Absolute *deadline;
 
+	hdr = (const struct GNUNET_SCRB_RootAnnounce *) message;
+	if (GNUNET_YES == ntohl(hdr->status))
+	{
+		deadline = GNUNET_CONTAINER_multihashmap_get(root_queries, &hdr->group_id);
+		if (NULL == deadline)
+		{
+			GNUNET_STATISTICS_update(scrb_stats,
+					gettext_noop("# roots: unasked announces ignored"), 1, GNUNET_NO);
+			return GNUNET_OK;
+		}
+		GNUNET_CONTAINER_multihashmap_remove(root_queries, &hdr->group_id, deadline);
+		if (0 == GNUNET_TIME_absolute_get_remaining(*deadline).rel_value_us)
+		{
+			GNUNET_free(deadline);
+			GNUNET_STATISTICS_update(scrb_stats,
+					gettext_noop("# roots: late announces ignored"), 1, GNUNET_NO);
+			return GNUNET_OK;
+		}
+		GNUNET_free(deadline);
+		cache_root(&hdr->group_id, other);
+		return GNUNET_OK;
+	}
+	/* only the cached root itself can disown the tree */
+	rp = lookup_root(&hdr->group_id);
+	if ((NULL != rp) &&
+			(0 == memcmp(rp, other, sizeof(struct GNUNET_PeerIdentity))))
+		forget_root(&hdr->group_id);
 	return GNUNET_OK;
 }
 
+/**
+ * A heartbeat, CORE already told the neighbours the sender is alive
+ */
+static int
+handle_service_heartbeat (void *cls,
+		const struct GNUNET_PeerIdentity *other,
+		const struct GNUNET_MessageHeader *message)
+{
+	return GNUNET_OK;
+}
 
 static int
 handle_service_send_parent (void *cls,
@@ -811,20 +3080,44 @@ handle_service_send_parent (void *cls,
 	const char* msg = "# service: SEND PARENT messages received from: ";
 	update_stats(msg, other, &my_identity, &hdr->group_id, scrb_stats);
 
-	struct GNUNET_SCRB_GroupParent* parent = GNUNET_new(struct GNUNET_SCRB_GroupParent);
+	struct GNUNET_SCRB_GroupParent* parent = GNUNET_SCRB_pool_new(parent_pool,
+			struct GNUNET_SCRB_GroupParent);
 
 	parent->group_id = hdr->group_id;
 
-	parent->parent = hdr->parent;
-
-	parent->mq = GNUNET_CORE_mq_create (core_api, &parent->parent);
-
-	GNUNET_CONTAINER_multihashmap_put(parents,
+	if (GNUNET_OK != GNUNET_CONTAINER_multihashmap_put(parents,
 			&parent->group_id,
 			parent,
-			GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY );
+			GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY))
+		GNUNET_SCRB_pool_free(parent_pool, parent);
+	else
+	{
+		parent->parent = GNUNET_PEER_intern(&hdr->parent);
+		parent->link = GSS_NEIGHBOURS_acquire_edge (&hdr->parent);
+		parent->lease = grant_lease(parent_leases, parent);
+		group_recovered(&parent->group_id);
+		/* the parent sends the data of the group on the same link */
+		parent->handle = ntohl(hdr->handle);
+		if ((GNUNET_SCRB_NO_GROUP_HANDLE != parent->handle) &&
+				(GNUNET_OK != GSS_NEIGHBOURS_bind_handle(parent->link,
+						parent->handle, &parent->group_id)))
+		{
+			GNUNET_break_op(0);
+			parent->handle = GNUNET_SCRB_NO_GROUP_HANDLE;
+		}
+	}
+
+	/* no client waits for the membership in the spare capacity group,
+	 * this peer may have filled up while it joined */
+	if (GNUNET_YES == is_spare_group(&hdr->group_id))
+	{
+		schedule_spare_check();
+		return GNUNET_OK;
+	}
 
 	handle_service_confirm_subscription(cls, other, message);
+	/* the clients which waited for the group may have gone meanwhile */
+	prune_tree(&hdr->group_id);
 
 	return GNUNET_OK;
 }
@@ -837,7 +3130,7 @@ handle_service_send_leave_to_parent (void *cls,
 	struct GNUNET_SCRB_SendLeaveToParent *hdr;
 	hdr = (struct GNUNET_SCRB_SendLeaveToParent *) message;
 
-	leaveGroup(&hdr->group_id, &hdr->sid, groups, parents);
+	leaveGroup(&hdr->group_id, &hdr->sid, GNUNET_YES, groups, parents);
 
 	return GNUNET_OK;
 }
@@ -846,6 +3139,93 @@ handle_service_send_leave_to_parent (void *cls,
 
 
 
+static int
+handle_service_push_down_join (void *cls,
+		const struct GNUNET_PeerIdentity *other,
+		const struct GNUNET_MessageHeader *message)
+{
+	const struct GNUNET_SCRB_PushDownJoin *hdr;
+	struct GNUNET_BLOCK_SCRB_Join join_block;
+
+	if (ntohs(message->size) != sizeof(struct GNUNET_SCRB_PushDownJoin))
+	{
+		GNUNET_break_op(0);
+		return GNUNET_SYSERR;
+	}
+	hdr = (const struct GNUNET_SCRB_PushDownJoin *) message;
+	if ((ntohl(hdr->ttl) >= PUSH_DOWN_TTL) ||
+			(GNUNET_OK != check_stripes(&hdr->group_id, ntohl(hdr->stripes))) ||
+			(GNUNET_YES != may_forward(&my_identity, &hdr->group_id,
+					ntohl(hdr->stripes))))
+	{
+		GNUNET_break_op(0);
+		return GNUNET_SYSERR;
+	}
+
+	const char* msg = "# service: PUSH DOWN JOIN messages received from: ";
+	update_stats(msg, other, &my_identity, &hdr->group_id, scrb_stats);
+
+	join_block.sid = hdr->oid;
+	join_block.cid = hdr->cid;
+	join_block.stripes = hdr->stripes;
+	adopt_child(&hdr->group_id, &join_block, &hdr->child, ntohl(hdr->ttl));
+	return GNUNET_OK;
+}
+
+static int
+handle_service_spare_anycast (void *cls,
+		const struct GNUNET_PeerIdentity *other,
+		const struct GNUNET_MessageHeader *message)
+{
+	const struct GNUNET_SCRB_SpareAnycast *hdr;
+	struct GNUNET_BLOCK_SCRB_Join join_block;
+	uint16_t msize = ntohs(message->size);
+	unsigned int n;
+	int member;
+
+	hdr = (const struct GNUNET_SCRB_SpareAnycast *) message;
+	if ((msize < sizeof(struct GNUNET_SCRB_SpareAnycast)) ||
+			((n = ntohl(hdr->visited)) > SPARE_ANYCAST_MAX_VISITED) ||
+			(msize != sizeof(struct GNUNET_SCRB_SpareAnycast) +
+					n * sizeof(struct GNUNET_PeerIdentity)) ||
+			(GNUNET_OK != check_stripes(&hdr->group_id, ntohl(hdr->stripes))))
+	{
+		GNUNET_break_op(0);
+		return GNUNET_SYSERR;
+	}
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# spare: anycasts received"), 1, GNUNET_NO);
+
+	join_block.sid = hdr->oid;
+	join_block.cid = hdr->cid;
+	join_block.stripes = hdr->stripes;
+	/* the interior nodes of the stripes stay disjoint */
+	member = may_forward(&my_identity, &hdr->group_id, ntohl(hdr->stripes));
+	if (((0 == max_children) || (num_children < max_children)) &&
+			(GNUNET_YES == member) &&
+			(0 != memcmp(&hdr->child, &my_identity, sizeof(struct GNUNET_PeerIdentity))))
+	{
+		/* we have a free slot, take the child and get into its tree */
+		int joined = GNUNET_CONTAINER_multihashmap_contains(groups, &hdr->group_id);
+
+		adopt_child(&hdr->group_id, &join_block, &hdr->child, 0);
+		if (GNUNET_YES != joined)
+			put_join(&hdr->group_id, &join_block.cid);
+		GNUNET_STATISTICS_update(scrb_stats,
+				gettext_noop("# spare: orphans adopted"), 1, GNUNET_NO);
+		return GNUNET_OK;
+	}
+	if (GNUNET_OK == spare_anycast_forward(hdr, n))
+		return GNUNET_OK;
+	/* the whole tree is full, better over capacity than an orphan */
+	GNUNET_STATISTICS_update(scrb_stats,
+			gettext_noop("# spare: anycasts failed"), 1, GNUNET_NO);
+	/* a stripe the peer may not forward is left to the JOIN retries */
+	if (GNUNET_YES == member)
+		adopt_child(&hdr->group_id, &join_block, &hdr->child, 0);
+	return GNUNET_OK;
+}
+
 /**
  * Connect to the core service
  */
@@ -853,12 +3233,28 @@ int
 p2p_init ()
 {
 	static struct GNUNET_CORE_MessageHandler core_handlers[] = {
-			{&handle_service_confirm_creation, GNUNET_MESSAGE_TYPE_SCRB_CREATE_REPLY, 0},
-			{&handle_service_confirm_subscription, GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_REPLY, 0},
-			{&handle_service_confirm_leave, GNUNET_MESSAGE_TYPE_SCRB_LEAVE_REPLY, 0},
-			{&handle_service_send_parent, GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_SEND_PARENT, 0},
-			{&handle_service_send_leave_to_parent, GNUNET_MESSAGE_TYPE_SCRB_SEND_LEAVE_TO_PARENT, 0},
+			{&handle_service_confirm_creation, GNUNET_MESSAGE_TYPE_SCRB_CREATE_REPLY,
+					sizeof(struct GNUNET_SCRB_ServiceReplyCreate)},
+			/* the handler reads the reply as a SUBSCRIBE_SEND_PARENT */
+			{&handle_service_confirm_subscription, GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_REPLY,
+					sizeof(struct GNUNET_SCRB_SendParent2Child)},
+			{&handle_service_confirm_leave, GNUNET_MESSAGE_TYPE_SCRB_LEAVE_REPLY,
+					sizeof(struct GNUNET_SCRB_ServiceReplyLeave)},
+			{&handle_service_send_parent, GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_SEND_PARENT,
+					sizeof(struct GNUNET_SCRB_SendParent2Child)},
+			{&handle_service_send_leave_to_parent, GNUNET_MESSAGE_TYPE_SCRB_SEND_LEAVE_TO_PARENT,
+					sizeof(struct GNUNET_SCRB_SendLeaveToParent)},
 			{&handle_service_multicast, GNUNET_MESSAGE_TYPE_SCRB_MULTICAST, 0},
+			{&handle_service_multicast, GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_BATCH, 0},
+			{&handle_service_multicast, GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_DOWN, 0},
+			{&handle_service_push_down_join, GNUNET_MESSAGE_TYPE_SCRB_PUSH_DOWN_JOIN, 0},
+			{&handle_service_spare_anycast, GNUNET_MESSAGE_TYPE_SCRB_SPARE_ANYCAST, 0},
+			{&handle_service_heartbeat, GNUNET_MESSAGE_TYPE_SCRB_HEARTBEAT,
+					sizeof (struct GNUNET_MessageHeader)},
+			{&handle_service_lease_renew, GNUNET_MESSAGE_TYPE_SCRB_LEASE_RENEW, 0},
+			{&handle_service_leave_batch, GNUNET_MESSAGE_TYPE_SCRB_LEAVE_BATCH, 0},
+			{&handle_service_root_announce, GNUNET_MESSAGE_TYPE_SCRB_ROOT_ANNOUNCE,
+					sizeof(struct GNUNET_SCRB_RootAnnounce)},
 			{NULL, 0, 0}
 	};
 
@@ -868,8 +3264,8 @@ p2p_init ()
 					&core_init,
 					&handle_core_connect,
 					&handle_core_disconnect,
-					NULL,
-					GNUNET_NO,
+					&handle_core_inbound,
+					GNUNET_YES,
 					NULL,
 					GNUNET_NO,
 					core_handlers);
@@ -879,55 +3275,359 @@ p2p_init ()
 	return GNUNET_OK;
 }
 
+/**
+ * Routes a multicast through the DHT to the rendezvous point.  Only
+ * used while the root of the tree is unknown to this peer.
+ *
+ * @param hdr the multicast
+ * @return #GNUNET_OK if the multicast was handed to the DHT,
+ *         #GNUNET_NO if the put queue was full and it was dropped
+ */
+static int
+multicast_via_dht(const struct GNUNET_SCRB_UpdateSubscriber* hdr)
+{
+	size_t data_size = ntohl(hdr->data.data_size);
+	size_t block_size = sizeof(struct GNUNET_BLOCK_SCRB_Multicast) + data_size;
+	struct GNUNET_BLOCK_SCRB_Multicast* multicast_block = GNUNET_malloc(block_size);
+	int ret;
+
+	multicast_block->data = hdr->data;
+	multicast_block->group_id = hdr->group_id;
+	multicast_block->last = hdr->last;
+	multicast_block->seq = hdr->seq;
+	multicast_block->epoch = hdr->epoch;
+	multicast_block->origin = hdr->origin;
+	memcpy(&multicast_block[1], &hdr[1], data_size);
+
+	ret = GSS_DHT_put (&hdr->group_id, GNUNET_BLOCK_SCRB_TYPE_MULTICAST,
+			block_size, multicast_block,
+			GNUNET_BLOCK_SCRB_MULTICAST_EXPIRATION);
+	GNUNET_free(multicast_block);
+	if (GNUNET_OK != ret)
+		return GNUNET_NO;
+	/* the root of the tree answers the publisher with an announce */
+	if (0 == memcmp(&hdr->origin, &my_identity, sizeof(struct GNUNET_PeerIdentity)))
+	{
+		struct GNUNET_TIME_Absolute* deadline =
+				GNUNET_CONTAINER_multihashmap_get(root_queries, &hdr->group_id);
+
+		if (NULL == deadline)
+		{
+			deadline = GNUNET_new(struct GNUNET_TIME_Absolute);
+			GNUNET_CONTAINER_multihashmap_put(root_queries, &hdr->group_id, deadline,
+					GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
+		}
+		*deadline = GNUNET_TIME_relative_to_absolute(
+				GNUNET_BLOCK_SCRB_MULTICAST_EXPIRATION);
+	}
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# multicast: routed through the DHT"),
+			1, GNUNET_NO);
+	return GNUNET_OK;
+}
+
+/**
+ * Sends the multicast held in @a frame towards the root of its tree.
+ * The root pushes it down, a cached root gets it over CORE, otherwise
+ * it is routed through the DHT and the root announces itself.  In
+ * #bidirectional mode a tree node floods it from where it is.
+ *
+ * @param frame frame holding the multicast
+ * @return #GNUNET_OK if the multicast is on its way,
+ *         #GNUNET_NO if it had to be dropped
+ */
+static int
+send_multicast(struct GNUNET_SCRB_Frame* frame)
+{
+	const struct GNUNET_SCRB_UpdateSubscriber* hdr =
+			(const struct GNUNET_SCRB_UpdateSubscriber*) GNUNET_SCRB_frame_msg(frame);
+	const struct GNUNET_PeerIdentity* rp = lookup_root(&hdr->group_id);
+
+	if (GNUNET_YES == is_tree_root(&hdr->group_id))
+	{
+		/* we are the root of the tree, push the data down */
+		receive_multicast(&hdr->group_id, &my_identity, NULL, groups, frame, subscribers, clients);
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# multicast: sent down the tree by the root"),
+				1, GNUNET_NO);
+	}
+	else if ((GNUNET_YES == bidirectional) &&
+			(GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains(parents, &hdr->group_id)))
+	{
+		/* we are on the tree, send the data up and down from here */
+		receive_multicast(&hdr->group_id, &my_identity, NULL, groups, frame, subscribers, clients);
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# multicast: flooded from a tree node"),
+				1, GNUNET_NO);
+	}
+	else if ((NULL != rp) &&
+			(0 != memcmp(rp, &my_identity, sizeof(struct GNUNET_PeerIdentity))))
+	{
+		/* the rendezvous point is known, hand the data to it over CORE */
+		GSS_NEIGHBOURS_send_frame(rp, frame);
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# multicast: sent to the root over CORE"),
+				1, GNUNET_NO);
+	}
+	else
+	{
+		return multicast_via_dht(hdr);
+	}
+	return GNUNET_OK;
+}
+
+/**
+ * Sends a chunk of a striped multicast on its stripe
+ *
+ * @param cls the `struct StripedGroup`
+ * @param stripe index of the stripe
+ * @param chunk header of the chunk
+ * @param data chunk data
+ * @param size number of bytes in @a data
+ */
+static void
+send_stripe_chunk(void* cls,
+		unsigned int stripe,
+		const struct GNUNET_SCRB_StripeChunk* chunk,
+		const void* data,
+		size_t size)
+{
+	struct StripedGroup* sg = cls;
+	struct GNUNET_SCRB_Frame* frame;
+	struct GNUNET_SCRB_UpdateSubscriber* msg;
+
+	frame = create_multicast_frame(&sg->stripe_id[stripe], GNUNET_NO, NULL,
+			sizeof(struct GNUNET_SCRB_StripeChunk) + size);
+	msg = (struct GNUNET_SCRB_UpdateSubscriber*) GNUNET_SCRB_frame_msg(frame);
+	memcpy(&msg[1], chunk, sizeof(struct GNUNET_SCRB_StripeChunk));
+	memcpy((char*) &msg[1] + sizeof(struct GNUNET_SCRB_StripeChunk), data, size);
+	stamp_multicast(msg);
+	if (GNUNET_OK != send_multicast(frame))
+	{
+		/* the other stripes or the parity may still rebuild the block */
+		GNUNET_SCRB_frame_unref(frame);
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# stripes: chunks dropped"),
+				1, GNUNET_NO);
+		return;
+	}
+	GNUNET_SCRB_frame_unref(frame);
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# stripes: chunks sent"),
+			1, GNUNET_NO);
+}
+
+/**
+ * Hands a multicast published here to the local subscribers of its
+ * group at once, while it travels along the tree.  The copies coming
+ * back from the tree are not delivered again, see receive_multicast().
+ *
+ * @param frame frame holding the multicast
+ */
+static void
+loopback_multicast(struct GNUNET_SCRB_Frame* frame)
+{
+	const struct GNUNET_SCRB_UpdateSubscriber* hdr =
+			(const struct GNUNET_SCRB_UpdateSubscriber*) GNUNET_SCRB_frame_msg(frame);
+
+	if (GNUNET_YES != GNUNET_CONTAINER_multihashmap_contains(subscribers,
+			&hdr->group_id))
+		return;
+	send_frame_to_subscribers(&hdr->group_id, frame, subscribers, clients);
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# multicast: delivered to local subscribers at once"),
+			1, GNUNET_NO);
+}
+
 static void
 handle_cl_multicast_request (void *cls,
 		struct GNUNET_SERVER_Client *client,
 		const struct GNUNET_MessageHeader *message)
 {
 	struct GNUNET_SCRB_UpdateSubscriber *hdr;
+	uint16_t msize = ntohs(message->size);
+	int ret = GNUNET_OK;
 	hdr = (struct GNUNET_SCRB_UpdateSubscriber *) message;
 
-	struct GNUNET_BLOCK_SCRB_Multicast multicast_block;
-
-	memcpy(&multicast_block.data, &hdr->data, sizeof(struct GNUNET_SCRB_MulticastData));
-	multicast_block.group_id = hdr->group_id;
-	multicast_block.last = hdr->last;
-
-	//	struct GNUNET_SCRB_GroupParent* parent = GNUNET_CONTAINER_multihashmap_get(parents, &hdr->group_id);
-	//
-	//	service_send_multicast_to_parent(parent, hdr);
-	//
-	//	receive_multicast(&hdr->group_id, &my_identity_hash, NULL, groups, &multicast_block, subscribers, clients);
+	if ((msize < sizeof(struct GNUNET_SCRB_UpdateSubscriber)) ||
+			(msize != sizeof(struct GNUNET_SCRB_UpdateSubscriber) +
+					ntohl(hdr->data.data_size)) ||
+			(ntohl(hdr->data.data_size) > GNUNET_SCRB_MULTICAST_MAX_PAYLOAD) ||
+			(0 == ntohl(hdr->stripes)) ||
+			(ntohl(hdr->stripes) > GNUNET_SCRB_MAX_STRIPES))
+	{
+		GNUNET_break_op(0);
+		GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
+		return;
+	}
 
-	put_dht_handle = GNUNET_DHT_put (dht_handle, &hdr->group_id, 1,
-			GNUNET_DHT_RO_RECORD_ROUTE |
-			GNUNET_DHT_RO_DEMULTIPLEX_EVERYWHERE | GNUNET_DHT_RO_LAST_HOP,
-			GNUNET_BLOCK_SCRB_TYPE_MULTICAST,
-			sizeof (multicast_block), &multicast_block,
-			GNUNET_TIME_UNIT_FOREVER_ABS,
-			GNUNET_TIME_UNIT_FOREVER_REL,
-			NULL, NULL);
+	struct StripedGroup* sg = GNUNET_CONTAINER_multihashmap_get(striped_groups, &hdr->group_id);
+	/* without the stripe trees the blocks would go to the plain group id,
+	 * which has no tree */
+	if ((1 < ntohl(hdr->stripes)) &&
+			((NULL == sg) || (sg->stripes != ntohl(hdr->stripes))))
+	{
+		GNUNET_log(GNUNET_ERROR_TYPE_WARNING,
+				"Striped group %s is not known here, publish dropped\n",
+				GNUNET_h2s(&hdr->group_id));
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# multicast: publishes to unknown striped groups rejected"),
+				1, GNUNET_NO);
+		GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
+		return;
+	}
+	if (NULL != sg)
+	{
+		/* the local subscribers get the whole block, as if reassembled */
+		if (GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains(subscribers,
+				&hdr->group_id))
+		{
+			struct GNUNET_SCRB_Frame* frame = create_multicast_frame(&sg->group_id,
+					GNUNET_NO, &hdr[1], ntohl(hdr->data.data_size));
 
-	if(NULL == put_dht_handle)
-		GNUNET_break(0);
+			loopback_multicast(frame);
+			GNUNET_SCRB_frame_unref(frame);
+		}
+		GNUNET_SCRB_stripe_split(&hdr[1], ntohl(hdr->data.data_size), sg->stripes,
+				sg->fec, sg->next_seq++, &send_stripe_chunk, sg);
+	}
+	else
+	{
+		struct GNUNET_SCRB_Frame* frame = GNUNET_SCRB_frame_create(message);
+
+		stamp_multicast((struct GNUNET_SCRB_UpdateSubscriber*) GNUNET_SCRB_frame_msg(frame));
+		loopback_multicast(frame);
+		/* the DHT put queue is full, the publisher has to back off */
+		if (GNUNET_OK != send_multicast(frame))
+			ret = GNUNET_SYSERR;
+		GNUNET_SCRB_frame_unref(frame);
+	}
 
-	GNUNET_SERVER_receive_done (client, GNUNET_OK);
+	GNUNET_SERVER_receive_done (client, ret);
 
 }
 
 void send_subscribe_confirmation(struct GNUNET_SCRB_ServiceSubscriber* sub,
-		struct GNUNET_CONTAINER_MultiHashMap* clients) {
+		struct GNUNET_CONTAINER_MultiHashMap* clients,
+		int status) {
 	struct GNUNET_SCRB_ServiceReplySubscribe *msg;
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(msg, GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_REPLY);
+	struct ClientEntry* ce = GNUNET_CONTAINER_multihashmap_get(clients,
+			&sub->cid);
+	if(NULL == ce)
+		return;
 	size_t msg_size = sizeof(struct GNUNET_SCRB_ServiceReplySubscribe);
+	struct GNUNET_SCRB_Frame* frame = create_client_frame(msg_size,
+			GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_REPLY);
+	msg = (struct GNUNET_SCRB_ServiceReplySubscribe *) GNUNET_SCRB_frame_msg(frame);
 	msg->header.size = htons((uint16_t) msg_size);
 	msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_REPLY);
 	msg->cid = sub->cid;
 	msg->group_id = sub->group_id;
+	msg->status = status;
+	send_frame_to_client(ce, frame);
+	GNUNET_SCRB_frame_unref(frame);
+}
+
+/**
+ * Puts a JOIN for the tree @a key into the DHT
+ *
+ * @param key id of the group or stripe
+ * @param cid id of the subscribing client
+ * @return #GNUNET_OK if the JOIN was handed to the DHT
+ */
+static int
+put_join(const struct GNUNET_HashCode* key,
+		const struct GNUNET_HashCode* cid)
+{
+	struct GNUNET_BLOCK_SCRB_Join join_block;
+	struct StripedGroup* sg = GNUNET_CONTAINER_multihashmap_get(stripes, key);
+	struct GNUNET_SCRB_Group* group = GNUNET_CONTAINER_multihashmap_get(groups, key);
+	unsigned int k = 0;
+
+	/* the stripe count tells the hops which of them may adopt */
+	if (NULL != sg)
+		k = sg->stripes;
+	else if (NULL != group)
+		k = group->stripes;
+	join_block.cid = *cid;
+	join_block.sid = my_identity;
+	join_block.stripes = htonl(k);
+
+	return GSS_DHT_put_control (key, GNUNET_BLOCK_SCRB_TYPE_JOIN,
+			sizeof (join_block), &join_block,
+			GNUNET_BLOCK_SCRB_CONTROL_EXPIRATION);
+}
+
+/**
+ * Files a new subscriber under its client, so that the subscriptions
+ * of a client can be found when it goes away
+ *
+ * @param sub the subscriber
+ */
+static void
+track_subscriber(struct GNUNET_SCRB_ServiceSubscriber* sub)
+{
 	struct ClientEntry* ce = GNUNET_CONTAINER_multihashmap_get(clients,
 			&sub->cid);
-	if(NULL != ce)
-		GNUNET_MQ_send(ce->mq, ev);
+
+	if (NULL == ce)
+		return;
+	sub->client = ce;
+	GNUNET_CONTAINER_MDLL_insert(client, ce->sub_head, ce->sub_tail, sub);
+}
+
+/**
+ * Subscribes a client to a striped group, the peer joins all stripes
+ * once and the client is confirmed when every stripe was joined.
+ *
+ * @param hdr subscription request of the client
+ * @param k number of stripes of the group
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the stripes could
+ *         not be joined
+ */
+static int
+subscribe_striped(const struct GNUNET_SCRB_ClntSbscrbRqst* hdr,
+		unsigned int k)
+{
+	struct StripedGroup* sg = get_striped_group(&hdr->group_id, k);
+	struct GNUNET_SCRB_ServiceSubscription* subs;
+	struct GNUNET_SCRB_ServiceSubscriber* sub;
+	unsigned int i;
+
+	if (NULL == sg)
+	{
+		/* the group is known with another number of stripes */
+		GNUNET_break_op(0);
+		return GNUNET_SYSERR;
+	}
+	if (NULL == sg->assembly)
+	{
+		for (i = 0; i < sg->stripes; i++)
+			if (GNUNET_OK != put_join(&sg->stripe_id[i], &hdr->client_id))
+				return GNUNET_SYSERR;
+		sg->assembly = GNUNET_SCRB_stripe_assembly_create();
+		sg->join_sent = GNUNET_TIME_absolute_get();
+		sg->join_attempts = 1;
+	}
+	subs = GNUNET_CONTAINER_multihashmap_get(subscribers, &hdr->group_id);
+	if (NULL == subs)
+	{
+		subs = GNUNET_SCRB_pool_new (subscription_pool, struct GNUNET_SCRB_ServiceSubscription);
+		subs->group_id = hdr->group_id;
+		GNUNET_CONTAINER_multihashmap_put(subscribers,
+				&subs->group_id,
+				subs,
+				GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY );
+	}
+	sub = GNUNET_SCRB_pool_new(subscriber_pool, struct GNUNET_SCRB_ServiceSubscriber);
+	sub->group_id = hdr->group_id;
+	sub->cid = hdr->client_id;
+	GNUNET_CONTAINER_DLL_insert(subs->sub_head, subs->sub_tail, sub);
+	track_subscriber(sub);
+
+	if (sg->joined_mask == (1 << sg->stripes) - 1)
+		send_subscribe_confirmation(sub, clients, GNUNET_OK);
+	return GNUNET_OK;
 }
 
 static void
@@ -938,29 +3638,60 @@ handle_cl_subscribe_request (void *cls,
 	struct GNUNET_SCRB_ClntSbscrbRqst *hdr;
 	hdr = (struct GNUNET_SCRB_ClntSbscrbRqst *) message;
 
-	struct GNUNET_SCRB_ServiceSubscription* subs;
-	subs = 	GNUNET_CONTAINER_multihashmap_get(subscribers, &hdr->group_id);
-
-	if(subs == NULL)
+	unsigned int k = ntohl(hdr->stripes);
+	if (k > GNUNET_SCRB_MAX_STRIPES)
+	{
+		GNUNET_break_op(0);
+		GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
+		return;
+	}
+	if (k > 1)
 	{
-		struct GNUNET_BLOCK_SCRB_Join join_block;
+		GNUNET_SERVER_receive_done (client, subscribe_striped(hdr, k));
+		return;
+	}
 
-		join_block.cid = hdr->client_id;
-		join_block.sid = my_identity;
+	struct GNUNET_SCRB_ServiceSubscription* subs;
+	struct GNUNET_SCRB_ServiceSubscriber *sub = GNUNET_SCRB_pool_new(subscriber_pool,
+			struct GNUNET_SCRB_ServiceSubscriber);
 
-		/* fixme: do not ignore return handles */
+	sub->group_id = hdr->group_id;
+	sub->cid = hdr->client_id;
+	track_subscriber(sub);
+	subs = 	GNUNET_CONTAINER_multihashmap_get(subscribers, &hdr->group_id);
 
-		put_dht_handle = GNUNET_DHT_put (dht_handle, &hdr->group_id, 1,
-				GNUNET_DHT_RO_RECORD_ROUTE |
-				GNUNET_DHT_RO_DEMULTIPLEX_EVERYWHERE | GNUNET_DHT_RO_LAST_HOP,
-				GNUNET_BLOCK_SCRB_TYPE_JOIN,
-				sizeof (join_block), &join_block,
-				GNUNET_TIME_UNIT_FOREVER_ABS,
-				GNUNET_TIME_UNIT_FOREVER_REL,
-				NULL, NULL);
+	if (NULL != subs)
+	{
+		GNUNET_CONTAINER_DLL_insert(subs->sub_head, subs->sub_tail, sub);
 
-		if(NULL == put_dht_handle)
-			GNUNET_break(0);
+		send_subscribe_confirmation(sub, clients, GNUNET_OK);
+	}
+	else if (NULL != (subs = GNUNET_CONTAINER_multihashmap_get(pending_joins,
+			&hdr->group_id)))
+	{
+		/* the JOIN is on its way, wait for the parent with it */
+		GNUNET_CONTAINER_DLL_insert_tail(subs->sub_head, subs->sub_tail, sub);
+		GNUNET_STATISTICS_update(scrb_stats,
+				gettext_noop("# joins: subscribes coalesced"), 1, GNUNET_NO);
+	}
+	else
+	{
+		if (GNUNET_OK != put_join(&hdr->group_id, &hdr->client_id))
+		{
+			free_subscriber(sub);
+			GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
+			return;
+		}
+		subs = GNUNET_SCRB_pool_new (subscription_pool,
+				struct GNUNET_SCRB_ServiceSubscription);
+		subs->group_id = hdr->group_id;
+		subs->join_sent = GNUNET_TIME_absolute_get();
+		subs->join_attempts = 1;
+		GNUNET_CONTAINER_DLL_insert(subs->sub_head, subs->sub_tail, sub);
+		GNUNET_CONTAINER_multihashmap_put(pending_joins,
+				&subs->group_id,
+				subs,
+				GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY );
 		/* code with get handle
 		get_dht_handle = GNUNET_DHT_get_start (dht_handle,
 		GNUNET_BLOCK_SCRB_TYPE_CREATE,
@@ -972,18 +3703,6 @@ handle_cl_subscribe_request (void *cls,
 		0,
 		&dht_get_join_handler, NULL);
 		 */
-
-	}else
-	{
-
-		struct GNUNET_SCRB_ServiceSubscriber *sub = GNUNET_new(struct GNUNET_SCRB_ServiceSubscriber);
-
-		sub->group_id = hdr->group_id;
-		sub->cid = hdr->client_id;
-
-		GNUNET_CONTAINER_DLL_insert(subs->sub_head, subs->sub_tail, sub);
-
-		send_subscribe_confirmation(sub, clients);
 	}
 	GNUNET_SERVER_receive_done (client, GNUNET_OK);
 
@@ -993,28 +3712,24 @@ static void
 handle_cl_leave_request (void *cls,
 		struct GNUNET_SERVER_Client *client,
 		const struct GNUNET_MessageHeader *message)
-{
-	struct GNUNET_SCRB_ClntRqstLv *hdr;
-	hdr = (struct GNUNET_SCRB_ClntRqstLv *) message;
-
-	struct GNUNET_BLOCK_SCRB_Leave leave_block;
-
-	leave_block.sid = my_identity_hash;
-	leave_block.group_id = hdr->group_id;
-
-	/* fixme: do not ignore return handles */
-	put_dht_handle = GNUNET_DHT_put (dht_handle, &leave_block.group_id, 1,
-			GNUNET_DHT_RO_RECORD_ROUTE |
-			GNUNET_DHT_RO_DEMULTIPLEX_EVERYWHERE | GNUNET_DHT_RO_LAST_HOP,
-			GNUNET_BLOCK_SCRB_TYPE_LEAVE,
-			sizeof (struct GNUNET_BLOCK_SCRB_Leave), &leave_block,
-			GNUNET_TIME_UNIT_FOREVER_ABS,
-			GNUNET_TIME_UNIT_FOREVER_REL,
-			NULL, NULL);
-
-	if(NULL == put_dht_handle)
-		GNUNET_break(0);
+{
+	struct GNUNET_SCRB_ClntRqstLv *hdr;
+	hdr = (struct GNUNET_SCRB_ClntRqstLv *) message;
+	struct ClientEntry* ce = GNUNET_CONTAINER_multihashmap_get(clients, &hdr->cid);
+	struct GNUNET_SCRB_ServiceSubscriber* sub;
 
+	if ((NULL == ce) || (ce->client != client))
+	{
+		GNUNET_break_op(0);
+		GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
+		return;
+	}
+	/* only this client leaves, the others of the peer stay in the tree */
+	for (sub = ce->sub_head; NULL != sub; sub = sub->next_client)
+		if (0 == memcmp(&sub->group_id, &hdr->group_id, sizeof(struct GNUNET_HashCode)))
+			break;
+	if (NULL != sub)
+		drop_subscriber(sub);
 	GNUNET_SERVER_receive_done (client, GNUNET_OK);
 }
 
@@ -1030,14 +3745,17 @@ send_publisher (void *cls,
 	struct GNUNET_SCRB_ServicePublisher* pub = value;
 	size_t msg_size = sizeof(struct GNUNET_SCRB_SrvcRplySrvcLst);
 
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(msg, GNUNET_MESSAGE_TYPE_SCRB_SERVICE_LIST_REPLY);
+	struct GNUNET_SCRB_Frame* frame = create_client_frame(msg_size,
+			GNUNET_MESSAGE_TYPE_SCRB_SERVICE_LIST_REPLY);
+	msg = (struct GNUNET_SCRB_SrvcRplySrvcLst *) GNUNET_SCRB_frame_msg(frame);
 
 	msg->header.size = htons((uint16_t) msg_size);
 	msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_SERVICE_LIST_REPLY);
 	msg->pub = *pub;
 	msg->size = GNUNET_CONTAINER_multihashmap_size(publishers);
 
-	GNUNET_MQ_send (ce->mq, ev);
+	send_frame_to_client(ce, frame);
+	GNUNET_SCRB_frame_unref(frame);
 	return GNUNET_OK;
 }
 
@@ -1054,6 +3772,27 @@ handle_cl_srvc_lst_request (void *cls,
 }
 
 
+/**
+ * Puts a CREATE for the tree @a key into the DHT
+ *
+ * @param key id of the group or stripe
+ * @param cid id of the creating client
+ * @return #GNUNET_OK if the CREATE was handed to the DHT
+ */
+static int
+put_create(const struct GNUNET_HashCode* key,
+		const struct GNUNET_HashCode* cid)
+{
+	struct GNUNET_BLOCK_SCRB_Create create_block;
+
+	create_block.cid = *cid;
+	create_block.sid = my_identity;
+
+	return GSS_DHT_put_control (key, GNUNET_BLOCK_SCRB_TYPE_CREATE,
+			sizeof (create_block), &create_block,
+			GNUNET_BLOCK_SCRB_CONTROL_EXPIRATION);
+}
+
 static void
 handle_cl_create_request (void *cls,
 		struct GNUNET_SERVER_Client *client,
@@ -1063,27 +3802,42 @@ handle_cl_create_request (void *cls,
 	hdr = (struct GNUNET_SCRB_ClientRequestCreate *) message;
 
 	const struct GNUNET_HashCode group_id = hdr->group_id;
+	unsigned int k = ntohl(hdr->stripes);
+	unsigned int m = ntohl(hdr->parity);
+	int ret = GNUNET_OK;
 
-	struct GNUNET_BLOCK_SCRB_Create create_block;
-
-	create_block.cid = group_id;
-	create_block.sid = my_identity;
-
-	/* fixme: care for the return handle as we should be able to shutdown
-           later on */
-	put_dht_handle = GNUNET_DHT_put (dht_handle, &group_id, 1,
-			GNUNET_DHT_RO_RECORD_ROUTE |
-			GNUNET_DHT_RO_DEMULTIPLEX_EVERYWHERE | GNUNET_DHT_RO_LAST_HOP,
-			GNUNET_BLOCK_SCRB_TYPE_CREATE,
-			sizeof (create_block), &create_block,
-			GNUNET_TIME_UNIT_FOREVER_ABS,
-			GNUNET_TIME_UNIT_FOREVER_REL,
-			NULL, NULL);
+	if ((k > GNUNET_SCRB_MAX_STRIPES) || ((m > 0) && (m >= k)))
+	{
+		GNUNET_break_op(0);
+		GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
+		return;
+	}
+	if (k > 1)
+	{
+		/* every stripe gets its own tree rooted at a different peer */
+		struct StripedGroup* sg = get_striped_group(&group_id, k);
+		unsigned int i;
 
-	if(NULL == put_dht_handle)
-		GNUNET_break(0);
+		if (NULL == sg)
+		{
+			/* the group is known with another number of stripes */
+			GNUNET_break_op(0);
+			GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
+			return;
+		}
+		/* k - m data and m parity chunks, any k - m rebuild a block */
+		if ((m > 0) && (NULL == sg->fec))
+			sg->fec = GNUNET_SCRB_fec_create(k - m, m);
+		for (i = 0; i < sg->stripes; i++)
+			if (GNUNET_OK != put_create(&sg->stripe_id[i], &group_id))
+				ret = GNUNET_SYSERR;
+	}
+	else if (GNUNET_OK != put_create(&group_id, &group_id))
+	{
+		ret = GNUNET_SYSERR;
+	}
 
-	GNUNET_SERVER_receive_done (client, GNUNET_OK);
+	GNUNET_SERVER_receive_done (client, ret);
 }
 
 static void
@@ -1106,11 +3860,10 @@ handle_cl_id_request (void *cls,
 			&my_identity_hash, sizeof (my_identity_hash),
 			NULL, 0);
 
-	struct ClientEntry* ce = GNUNET_new(struct ClientEntry);
+	struct ClientEntry* ce = GNUNET_SCRB_pool_new(client_pool, struct ClientEntry);
 	ce->cid = client_hash;
 	GNUNET_SERVER_client_keep (client);
 	ce->client = client;
-	ce->mq = GNUNET_MQ_queue_for_server_client(client);
 
 	//put the client in map
 	GNUNET_CONTAINER_multihashmap_put (clients, client_hash, ce,
@@ -1120,14 +3873,17 @@ handle_cl_id_request (void *cls,
 
 	size_t msg_size;
 	struct GNUNET_SCRB_ServiceReplyIdentity* msg;
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(msg, GNUNET_MESSAGE_TYPE_SCRB_ID_REPLY);
 	msg_size = sizeof(struct GNUNET_SCRB_ServiceReplyIdentity);
+	struct GNUNET_SCRB_Frame* frame = create_client_frame(msg_size,
+			GNUNET_MESSAGE_TYPE_SCRB_ID_REPLY);
+	msg = (struct GNUNET_SCRB_ServiceReplyIdentity *) GNUNET_SCRB_frame_msg(frame);
 	msg->header.size = htons((uint16_t) msg_size);
 	msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_ID_REPLY);
 	msg->cid = *client_hash;
 	msg->sid = my_identity;
 
-	GNUNET_MQ_send (ce->mq, ev);
+	send_frame_to_client(ce, frame);
+	GNUNET_SCRB_frame_unref(frame);
 
 	GNUNET_SERVER_receive_done (client, GNUNET_OK);
 }
@@ -1140,20 +3896,40 @@ handle_cl_id_request (void *cls,
 static void
 free_client_entry (struct ClientEntry *ce)
 {
+	struct GNUNET_SCRB_ServiceSubscriber *sub;
+
 	GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
 			"Cleaning up client entry\n");
+	while (NULL != (sub = ce->sub_head))
+	{
+		GNUNET_CONTAINER_MDLL_remove (client, ce->sub_head, ce->sub_tail, sub);
+		sub->client = NULL;
+	}
+	if (NULL != ce->th)
+		GNUNET_SERVER_notify_transmit_ready_cancel(ce->th);
+	GNUNET_SCRB_frame_queue_clear(&ce->queue);
 	GNUNET_SERVER_client_drop(ce->client);
 	GNUNET_CONTAINER_DLL_remove (cl_head, cl_tail, ce);
 	GNUNET_free (ce->cid);
-	GNUNET_free (ce);
+	GNUNET_SCRB_pool_free (client_pool, ce);
 }
 
 static void
 free_group_sub_entry (struct GNUNET_SCRB_GroupSubscriber *gs)
 {
-	GNUNET_MQ_destroy(gs->mq_l);
-	GNUNET_MQ_destroy(gs->mq_o);
-	GNUNET_free (gs);
+	if (GNUNET_YES == is_spare_group(&gs->group->group_id))
+		num_spare_children--;
+	else
+	{
+		num_children--;
+		schedule_spare_check();
+	}
+	GSS_NEIGHBOURS_release_edge(gs->link_l);
+	GSS_NEIGHBOURS_release(gs->link_o);
+	GNUNET_PEER_change_rc(gs->sid, -1);
+	GNUNET_PEER_change_rc(gs->oid, -1);
+	cancel_lease(&gs->lease);
+	GNUNET_SCRB_pool_free (group_subscriber_pool, gs);
 }
 
 
@@ -1171,13 +3947,14 @@ free_group_entry (struct GNUNET_SCRB_Group *group)
 			"Cleaning up group entry\n");
 	while (NULL != (gs = group->group_head))
 	{
-		GNUNET_CONTAINER_DLL_remove (group->group_head,
-				group->group_tail,
-				gs);
+		GNUNET_SCRB_group_remove_child (group, gs);
 		free_group_sub_entry (gs);
 	}
+	GNUNET_SCRB_group_done (group);
 
-	GNUNET_MQ_destroy(group->mq);
+	GSS_NEIGHBOURS_release(group->link);
+	GNUNET_PEER_change_rc(group->sid, -1);
+	release_group_handle(group->handle);
 	GNUNET_free (group);
 }
 
@@ -1192,6 +3969,22 @@ free_pub_entry (struct GNUNET_SCRB_ServicePublisher *pub)
 	GNUNET_free (pub);
 }
 
+/**
+ * Free a subscriber taken out of its subscription
+ *
+ * @param sub entry to free
+ */
+static void
+free_subscriber (struct GNUNET_SCRB_ServiceSubscriber *sub)
+{
+	if (NULL != sub->client)
+		GNUNET_CONTAINER_MDLL_remove (client,
+				sub->client->sub_head,
+				sub->client->sub_tail,
+				sub);
+	GNUNET_SCRB_pool_free (subscriber_pool, sub);
+}
+
 static void
 free_subs_entry (struct GNUNET_SCRB_ServiceSubscription *subs)
 {
@@ -1202,10 +3995,10 @@ free_subs_entry (struct GNUNET_SCRB_ServiceSubscription *subs)
 		GNUNET_CONTAINER_DLL_remove (subs->sub_head,
 				subs->sub_tail,
 				sub);
-		GNUNET_free (sub);
+		free_subscriber (sub);
 	}
 
-	GNUNET_free (subs);
+	GNUNET_SCRB_pool_free (subscription_pool, subs);
 }
 
 /**
@@ -1283,18 +4076,121 @@ cleanup_subscription (void *cls,
 	return GNUNET_OK;
 }
 
+/**
+ * Free memory occupied by an entry in a map holding plain values.
+ *
+ * @param cls unused
+ * @param key unused
+ * @param value the value to free
+ * @return #GNUNET_OK (continue to iterate)
+ */
+static int
+cleanup_value (void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
+{
+	GNUNET_free (value);
+	return GNUNET_OK;
+}
+
+/**
+ * Free memory occupied by an entry in the striped group map.
+ *
+ * @param cls unused
+ * @param key unused
+ * @param value a `struct StripedGroup*`
+ * @return #GNUNET_OK (continue to iterate)
+ */
+static int
+cleanup_striped_group (void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
+{
+	struct StripedGroup *sg = value;
+
+	if (NULL != sg->assembly)
+		GNUNET_SCRB_stripe_assembly_destroy (sg->assembly);
+	if (NULL != sg->fec)
+		GNUNET_SCRB_fec_destroy (sg->fec);
+	GNUNET_free (sg);
+	return GNUNET_OK;
+}
+
 static int
 cleanup_parent (void *cls,
 		const struct GNUNET_HashCode *key,
 		void *value)
 {
 	struct GNUNET_SCRB_GroupParent *parent = value;
-	GNUNET_MQ_destroy(parent->mq);
-	GNUNET_free(parent);
+	if (GNUNET_SCRB_NO_GROUP_HANDLE != parent->handle)
+		GSS_NEIGHBOURS_unbind_handle(parent->link, parent->handle, &parent->group_id);
+	GSS_NEIGHBOURS_release_edge(parent->link);
+	GNUNET_PEER_change_rc(parent->parent, -1);
+	cancel_lease(&parent->lease);
+	GNUNET_SCRB_pool_free(parent_pool, parent);
 	return GNUNET_OK;
 }
 
 
+/**
+ * Publishes how many entries of a pool are used and allocated
+ *
+ * @param in_use_name statistic for the entries in use
+ * @param capacity_name statistic for the entries allocated
+ * @param pool the pool
+ */
+static void
+set_pool_stats (const char* in_use_name,
+		const char* capacity_name,
+		const struct GNUNET_SCRB_Pool* pool)
+{
+	GNUNET_STATISTICS_set (scrb_stats, in_use_name,
+			GNUNET_SCRB_pool_in_use (pool), GNUNET_NO);
+	GNUNET_STATISTICS_set (scrb_stats, capacity_name,
+			GNUNET_SCRB_pool_capacity (pool), GNUNET_NO);
+}
+
+/**
+ * Publishes the occupancy of the pools, the statistics are not
+ * touched on every allocation
+ *
+ * @param cls unused
+ * @param tc unused
+ */
+static void
+publish_pool_stats (void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	pool_stats_task = GNUNET_SCHEDULER_NO_TASK;
+	set_pool_stats (gettext_noop ("# pool children: in use"),
+			gettext_noop ("# pool children: allocated"), group_subscriber_pool);
+	set_pool_stats (gettext_noop ("# pool parents: in use"),
+			gettext_noop ("# pool parents: allocated"), parent_pool);
+	set_pool_stats (gettext_noop ("# pool subscribers: in use"),
+			gettext_noop ("# pool subscribers: allocated"), subscriber_pool);
+	set_pool_stats (gettext_noop ("# pool subscriptions: in use"),
+			gettext_noop ("# pool subscriptions: allocated"), subscription_pool);
+	set_pool_stats (gettext_noop ("# pool clients: in use"),
+			gettext_noop ("# pool clients: allocated"), client_pool);
+	pool_stats_task = GNUNET_SCHEDULER_add_delayed (POOL_STATS_FREQUENCY,
+			&publish_pool_stats, NULL);
+}
+
+/**
+ * Destroys a pool if it was created
+ *
+ * @param pool the pool, set to NULL
+ */
+static void
+destroy_pool (struct GNUNET_SCRB_Pool** pool)
+{
+	if (NULL == *pool)
+		return;
+	GNUNET_SCRB_pool_destroy (*pool);
+	*pool = NULL;
+}
+
+
 /**
  * Task run during shutdown.
  *
@@ -1305,6 +4201,48 @@ static void
 shutdown_task (void *cls,
 		const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
+	unsigned int i;
+
+	if (GNUNET_SCHEDULER_NO_TASK != pool_stats_task)
+	{
+		GNUNET_SCHEDULER_cancel (pool_stats_task);
+		pool_stats_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	if (GNUNET_SCHEDULER_NO_TASK != renew_task)
+	{
+		GNUNET_SCHEDULER_cancel (renew_task);
+		renew_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	if (GNUNET_SCHEDULER_NO_TASK != lease_task)
+	{
+		GNUNET_SCHEDULER_cancel (lease_task);
+		lease_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	if (GNUNET_SCHEDULER_NO_TASK != leave_task)
+	{
+		GNUNET_SCHEDULER_cancel (leave_task);
+		leave_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	if (GNUNET_SCHEDULER_NO_TASK != join_retry_task)
+	{
+		GNUNET_SCHEDULER_cancel (join_retry_task);
+		join_retry_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	if (GNUNET_SCHEDULER_NO_TASK != dedup_task)
+	{
+		GNUNET_SCHEDULER_cancel (dedup_task);
+		dedup_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	/* the parents forget us when our leases run out */
+	if (NULL != leave_batches)
+	{
+		GNUNET_CONTAINER_multipeermap_iterate (leave_batches,
+				&free_batch,
+				NULL);
+		GNUNET_CONTAINER_multipeermap_destroy (leave_batches);
+		leave_batches = NULL;
+	}
+
 	if (NULL != clients)
 	{
 		GNUNET_CONTAINER_multihashmap_iterate (clients,
@@ -1322,6 +4260,12 @@ shutdown_task (void *cls,
 		GNUNET_CONTAINER_multihashmap_destroy (groups);
 		groups = NULL;
 	}
+	/* freeing the children above asks for a check */
+	if (GNUNET_SCHEDULER_NO_TASK != spare_task)
+	{
+		GNUNET_SCHEDULER_cancel (spare_task);
+		spare_task = GNUNET_SCHEDULER_NO_TASK;
+	}
 
 	if (NULL != publishers)
 	{
@@ -1341,6 +4285,15 @@ shutdown_task (void *cls,
 		subscribers = NULL;
 	}
 
+	if (NULL != pending_joins)
+	{
+		GNUNET_CONTAINER_multihashmap_iterate (pending_joins,
+				&cleanup_subscription,
+				NULL);
+		GNUNET_CONTAINER_multihashmap_destroy (pending_joins);
+		pending_joins = NULL;
+	}
+
 	if (NULL != parents)
 	{
 		GNUNET_CONTAINER_multihashmap_iterate (parents,
@@ -1350,11 +4303,98 @@ shutdown_task (void *cls,
 		parents = NULL;
 	}
 
-	GNUNET_DHT_monitor_stop (monitor_handle);
+	if (NULL != orphans)
+	{
+		GNUNET_CONTAINER_multihashmap_iterate (orphans,
+				&cleanup_value,
+				NULL);
+		GNUNET_CONTAINER_multihashmap_destroy (orphans);
+		orphans = NULL;
+	}
+
+	if (NULL != roots)
+	{
+		GNUNET_CONTAINER_multihashmap_iterate (roots,
+				&cleanup_value,
+				NULL);
+		GNUNET_CONTAINER_multihashmap_destroy (roots);
+		roots = NULL;
+	}
+
+	if (NULL != root_queries)
+	{
+		GNUNET_CONTAINER_multihashmap_iterate (root_queries,
+				&cleanup_value,
+				NULL);
+		GNUNET_CONTAINER_multihashmap_destroy (root_queries);
+		root_queries = NULL;
+	}
+
+	/* the children and parents gave their leases back when they were freed */
+	if (NULL != child_leases)
+	{
+		GNUNET_CONTAINER_heap_destroy (child_leases);
+		child_leases = NULL;
+	}
+	if (NULL != parent_leases)
+	{
+		GNUNET_CONTAINER_heap_destroy (parent_leases);
+		parent_leases = NULL;
+	}
+
+	if (NULL != striped_groups)
+	{
+		GNUNET_CONTAINER_multihashmap_iterate (striped_groups,
+				&cleanup_striped_group,
+				NULL);
+		GNUNET_CONTAINER_multihashmap_destroy (striped_groups);
+		striped_groups = NULL;
+	}
+
+	if (NULL != stripes)
+	{
+		GNUNET_CONTAINER_multihashmap_destroy (stripes);
+		stripes = NULL;
+	}
+
+	if (NULL != publish_seqs)
+	{
+		GNUNET_CONTAINER_multihashmap_iterate (publish_seqs,
+				&cleanup_value,
+				NULL);
+		GNUNET_CONTAINER_multihashmap_destroy (publish_seqs);
+		publish_seqs = NULL;
+	}
+
+	if (NULL != dedup_windows)
+	{
+		GNUNET_CONTAINER_multihashmap_iterate (dedup_windows,
+				&cleanup_value,
+				NULL);
+		GNUNET_CONTAINER_multihashmap_destroy (dedup_windows);
+		dedup_windows = NULL;
+	}
+
+	/* the maps are gone, no entry of the pools is referenced anymore */
+	destroy_pool (&group_subscriber_pool);
+	destroy_pool (&parent_pool);
+	destroy_pool (&subscriber_pool);
+	destroy_pool (&subscription_pool);
+	destroy_pool (&client_pool);
+
+	for (i = 0; i < NUM_SCRB_BLOCK_TYPES; i++)
+	{
+		if (NULL == monitor_handles[i])
+			continue;
+		GNUNET_DHT_monitor_stop (monitor_handles[i]);
+		monitor_handles[i] = NULL;
+	}
+
+	GSS_NEIGHBOURS_done ();
+	GSS_DHT_done ();
 
 	GNUNET_DHT_disconnect (dht_handle);
 	dht_handle = NULL;
-	GNUNET_MQ_destroy (mq);
 	if (core_api != NULL)
 	{
 		GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Disconnecting core.\n");
@@ -1370,6 +4410,208 @@ shutdown_task (void *cls,
 }
 
 
+/**
+ * Frees a subscription without subscribers, or whose subscribers are
+ * gone, and leaves the trees of its group or stripes
+ *
+ * @param map the subscription is filed in, `pending_joins` or `subscribers`
+ * @param subs the subscription, freed
+ */
+static void
+release_subscription (struct GNUNET_CONTAINER_MultiHashMap *map,
+		struct GNUNET_SCRB_ServiceSubscription *subs)
+{
+	struct GNUNET_HashCode group_id = subs->group_id;
+	struct StripedGroup *sg;
+	unsigned int i;
+
+	GNUNET_CONTAINER_multihashmap_remove (map, &group_id, subs);
+	free_subs_entry (subs);
+	sg = GNUNET_CONTAINER_multihashmap_get (striped_groups, &group_id);
+	if ((NULL != sg) && (NULL != sg->assembly))
+	{
+		GNUNET_SCRB_stripe_assembly_destroy (sg->assembly);
+		sg->assembly = NULL;
+		sg->joined_mask = 0;
+		for (i = 0; i < sg->stripes; i++)
+			prune_tree (&sg->stripe_id[i]);
+	}
+	else
+		prune_tree (&group_id);
+}
+
+/**
+ * Takes a subscriber out of its subscription and frees it.  The trees
+ * of the group are left once no local client receives it any more.
+ *
+ * @param sub the subscriber, freed
+ */
+static void
+drop_subscriber (struct GNUNET_SCRB_ServiceSubscriber *sub)
+{
+	struct GNUNET_SCRB_ServiceSubscription *subs;
+	struct GNUNET_CONTAINER_MultiHashMap *map;
+
+	/* the subscription waits for its parent or has one */
+	map = pending_joins;
+	subs = GNUNET_CONTAINER_multihashmap_get (map, &sub->group_id);
+	if (NULL == subs)
+	{
+		map = subscribers;
+		subs = GNUNET_CONTAINER_multihashmap_get (map, &sub->group_id);
+	}
+	if (NULL == subs)
+	{
+		GNUNET_break (0);
+		free_subscriber (sub);
+		return;
+	}
+	GNUNET_CONTAINER_DLL_remove (subs->sub_head, subs->sub_tail, sub);
+	free_subscriber (sub);
+	if (NULL == subs->sub_head)
+		release_subscription (map, subs);
+}
+
+/**
+ * Drops the subscriptions of a client which went away.  The trees of
+ * the groups no local client receives any more are left.
+ *
+ * @param ce the client
+ * @return number of subscriptions dropped
+ */
+static unsigned int
+drop_client_subscriptions (struct ClientEntry *ce)
+{
+	struct GNUNET_SCRB_ServiceSubscriber *sub;
+	unsigned int dropped = 0;
+
+	while (NULL != (sub = ce->sub_head))
+	{
+		dropped++;
+		drop_subscriber (sub);
+	}
+	return dropped;
+}
+
+/**
+ * Fails a subscription no JOIN of which was answered, its clients are
+ * told and the peer leaves whatever it joined of the group.
+ *
+ * @param map the subscription is filed in, `pending_joins` or `subscribers`
+ * @param subs the subscription, freed
+ */
+static void
+expire_subscription (struct GNUNET_CONTAINER_MultiHashMap *map,
+		struct GNUNET_SCRB_ServiceSubscription *subs)
+{
+	struct GNUNET_SCRB_ServiceSubscriber *sub;
+
+	for (sub = subs->sub_head; NULL != sub; sub = sub->next)
+		send_subscribe_confirmation (sub, clients, GNUNET_SYSERR);
+	release_subscription (map, subs);
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# joins: subscriptions expired"), 1, GNUNET_NO);
+}
+
+/**
+ * Puts the JOIN of a subscription waiting for its parent again, or
+ * fails it after #JOIN_MAX_ATTEMPTS
+ *
+ * @param cls unused
+ * @param key group id
+ * @param value the `struct GNUNET_SCRB_ServiceSubscription`
+ * @return #GNUNET_YES to continue
+ */
+static int
+retry_pending_join (void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
+{
+	struct GNUNET_SCRB_ServiceSubscription *subs = value;
+
+	if (GNUNET_TIME_absolute_get_duration (subs->join_sent).rel_value_us <
+			JOIN_RETRY_DELAY.rel_value_us)
+		return GNUNET_YES;
+	if (subs->join_attempts >= JOIN_MAX_ATTEMPTS)
+	{
+		expire_subscription (pending_joins, subs);
+		return GNUNET_YES;
+	}
+	if (GNUNET_OK != put_join (&subs->group_id, &subs->sub_head->cid))
+		return GNUNET_YES;
+	subs->join_sent = GNUNET_TIME_absolute_get ();
+	subs->join_attempts++;
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# joins: JOINs put again"), 1, GNUNET_NO);
+	return GNUNET_YES;
+}
+
+/**
+ * Puts the JOINs of the stripes a striped subscription has not joined
+ * yet again, or fails it after #JOIN_MAX_ATTEMPTS
+ *
+ * @param cls unused
+ * @param key group id
+ * @param value the `struct StripedGroup`
+ * @return #GNUNET_YES to continue
+ */
+static int
+retry_stripe_joins (void *cls,
+		const struct GNUNET_HashCode *key,
+		void *value)
+{
+	struct StripedGroup *sg = value;
+	struct GNUNET_SCRB_ServiceSubscription *subs;
+	unsigned int i;
+
+	if ((NULL == sg->assembly) ||
+			(sg->joined_mask == (1 << sg->stripes) - 1))
+		return GNUNET_YES;
+	if (GNUNET_TIME_absolute_get_duration (sg->join_sent).rel_value_us <
+			JOIN_RETRY_DELAY.rel_value_us)
+		return GNUNET_YES;
+	subs = GNUNET_CONTAINER_multihashmap_get (subscribers, &sg->group_id);
+	if (NULL == subs)
+	{
+		GNUNET_break (0);
+		return GNUNET_YES;
+	}
+	if (sg->join_attempts >= JOIN_MAX_ATTEMPTS)
+	{
+		expire_subscription (subscribers, subs);
+		return GNUNET_YES;
+	}
+	for (i = 0; i < sg->stripes; i++)
+		if ((0 == (sg->joined_mask & (1 << i))) &&
+				(GNUNET_OK == put_join (&sg->stripe_id[i], &subs->sub_head->cid)))
+			GNUNET_STATISTICS_update (scrb_stats,
+					gettext_noop ("# joins: JOINs put again"), 1, GNUNET_NO);
+	sg->join_sent = GNUNET_TIME_absolute_get ();
+	sg->join_attempts++;
+	return GNUNET_YES;
+}
+
+/**
+ * Puts the JOINs nobody answered again, lost JOINs do not keep the
+ * subscribers waiting for good
+ *
+ * @param cls unused
+ * @param tc scheduler context
+ */
+static void
+retry_joins (void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	join_retry_task = GNUNET_SCHEDULER_NO_TASK;
+	GNUNET_CONTAINER_multihashmap_iterate (pending_joins,
+			&retry_pending_join, NULL);
+	GNUNET_CONTAINER_multihashmap_iterate (striped_groups,
+			&retry_stripe_joins, NULL);
+	schedule_spare_check ();
+	join_retry_task = GNUNET_SCHEDULER_add_delayed (JOIN_RETRY_DELAY,
+			&retry_joins, NULL);
+}
+
 /**
  * A client disconnected.  Remove all of its data structure entries.
  *
@@ -1388,6 +4630,10 @@ handle_client_disconnect (void *cls,
 	{
 		if(current->client == client)
                 {
+                  GNUNET_STATISTICS_update (scrb_stats,
+                                            gettext_noop ("# clients: subscriptions dropped on disconnect"),
+                                            drop_client_subscriptions (current),
+                                            GNUNET_NO);
                   GNUNET_CONTAINER_multihashmap_remove(clients, current->cid,
                                                        current);
                   free_client_entry (current);
@@ -1419,7 +4665,21 @@ run (void *cls,
 			{&handle_cl_leave_request, NULL, GNUNET_MESSAGE_TYPE_SCRB_LEAVE_REQUEST, 0},
 			{NULL, NULL, 0, 0}
 	};
+	unsigned int i;
+
 	cfg = c;
+	if (GNUNET_OK != GNUNET_CONFIGURATION_get_value_number (cfg, "scrb",
+			"MAX_CHILDREN", &max_children))
+		max_children = 0;
+	bidirectional = GNUNET_CONFIGURATION_get_value_yesno (cfg, "scrb",
+			"BIDIRECTIONAL");
+	if (GNUNET_SYSERR == bidirectional)
+		bidirectional = GNUNET_NO;
+	if ((GNUNET_OK != GNUNET_CONFIGURATION_get_value_time (cfg, "scrb",
+			"LEASE_TIME", &lease_time)) || (0 == lease_time.rel_value_us))
+		lease_time = DEFAULT_LEASE_TIME;
+	GNUNET_CRYPTO_hash ("scrb spare capacity", strlen ("scrb spare capacity"),
+			&spare_group_id);
 	GNUNET_SERVER_add_handlers (server, handlers);
 	GNUNET_SERVER_disconnect_notify (server,
 			&handle_client_disconnect,
@@ -1436,8 +4696,37 @@ run (void *cls,
 
 	subscribers = GNUNET_CONTAINER_multihashmap_create (256, GNUNET_YES);
 
+	pending_joins = GNUNET_CONTAINER_multihashmap_create (64, GNUNET_YES);
+
 	parents = GNUNET_CONTAINER_multihashmap_create (256, GNUNET_YES);
 
+	orphans = GNUNET_CONTAINER_multihashmap_create (16, GNUNET_NO);
+
+	roots = GNUNET_CONTAINER_multihashmap_create (16, GNUNET_NO);
+	root_queries = GNUNET_CONTAINER_multihashmap_create (16, GNUNET_NO);
+
+	child_leases = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+	parent_leases = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+
+	striped_groups = GNUNET_CONTAINER_multihashmap_create (16, GNUNET_NO);
+
+	stripes = GNUNET_CONTAINER_multihashmap_create (64, GNUNET_NO);
+
+	publish_seqs = GNUNET_CONTAINER_multihashmap_create (16, GNUNET_NO);
+	publish_epoch = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_NONCE, UINT32_MAX);
+
+	dedup_windows = GNUNET_CONTAINER_multihashmap_create (64, GNUNET_NO);
+
+	group_subscriber_pool = GNUNET_SCRB_pool_create (
+			sizeof (struct GNUNET_SCRB_GroupSubscriber), TREE_POOL_SLAB);
+	parent_pool = GNUNET_SCRB_pool_create (
+			sizeof (struct GNUNET_SCRB_GroupParent), TREE_POOL_SLAB);
+	subscriber_pool = GNUNET_SCRB_pool_create (
+			sizeof (struct GNUNET_SCRB_ServiceSubscriber), POOL_SLAB);
+	subscription_pool = GNUNET_SCRB_pool_create (
+			sizeof (struct GNUNET_SCRB_ServiceSubscription), POOL_SLAB);
+	client_pool = GNUNET_SCRB_pool_create (sizeof (struct ClientEntry), POOL_SLAB);
+
 	if (GNUNET_OK != p2p_init())
 	{
 		shutdown_task (NULL, NULL);
@@ -1446,15 +4735,31 @@ run (void *cls,
 
 	dht_handle = GNUNET_DHT_connect (cfg, 100);
 
-	monitor_handle = GNUNET_DHT_monitor_start (dht_handle,
-			GNUNET_BLOCK_TYPE_ANY,
-			NULL,
-			NULL,
-			&get_dht_resp_callback,
-			&put_dht_callback,
-			cls);
+	/* one monitor per scrb block type, the DHT does not report the PUTs
+	 * of other applications, GETs and their replies at all */
+	for (i = 0; i < NUM_SCRB_BLOCK_TYPES; i++)
+		monitor_handles[i] = GNUNET_DHT_monitor_start (dht_handle,
+				scrb_block_types[i],
+				NULL,
+				NULL,
+				NULL,
+				&put_dht_callback,
+				cls);
 
 	scrb_stats = GNUNET_STATISTICS_create ("scrb", cfg);
+
+	GSS_NEIGHBOURS_init (cfg, core_api, scrb_stats, &handle_lagging_child,
+			&handle_lost_neighbour, NULL);
+	GSS_DHT_init (cfg, dht_handle, scrb_stats);
+
+	pool_stats_task = GNUNET_SCHEDULER_add_delayed (POOL_STATS_FREQUENCY,
+			&publish_pool_stats, NULL);
+	renew_task = GNUNET_SCHEDULER_add_delayed (
+			GNUNET_TIME_relative_divide (lease_time, 3), &renew_leases, NULL);
+	join_retry_task = GNUNET_SCHEDULER_add_delayed (JOIN_RETRY_DELAY,
+			&retry_joins, NULL);
+	dedup_task = GNUNET_SCHEDULER_add_delayed (DEDUP_WINDOW_LIFETIME,
+			&expire_dedup_windows, NULL);
 }
 
 
@@ -0,0 +1,498 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/gnunet-service-scrb_dht.c
+ * @brief DHT puts of the scrb service
+ * @author azhdanov
+ *
+ * Every put of the service goes through a table of puts in flight.  At
+ * most DHT_MAX_PUTS puts are in flight, at most DHT_MAX_GROUP_PUTS of
+ * them for the same group, so a busy group can not starve the others.
+ * Further puts wait in a queue of at most DHT_MAX_QUEUED_PUTS entries
+ * and start in their order as soon as their group has a free slot.
+ * Control puts (JOIN, LEAVE, CREATE) wait in a queue of their own,
+ * which is never full and is served first, so a burst of multicasts can
+ * not crowd out a subscription.
+ */
+#include "gnunet-service-scrb_dht.h"
+
+/**
+ * Default number of puts in flight
+ */
+#define DEFAULT_MAX_PUTS 32
+
+/**
+ * Default number of puts in flight per group
+ */
+#define DEFAULT_MAX_GROUP_PUTS 4
+
+/**
+ * Default number of queued puts
+ */
+#define DEFAULT_MAX_QUEUED_PUTS 1024
+
+
+/**
+ * A put in flight or waiting for a slot
+ */
+struct PendingPut
+{
+	/**
+	 * Previous entry of the list the put is in
+	 */
+	struct PendingPut *prev;
+
+	/**
+	 * Next entry of the list the put is in
+	 */
+	struct PendingPut *next;
+
+	/**
+	 * Key of the block
+	 */
+	struct GNUNET_HashCode key;
+
+	/**
+	 * Type of the block
+	 */
+	enum GNUNET_BLOCK_Type type;
+
+	/**
+	 * How long the DHT keeps the block
+	 */
+	struct GNUNET_TIME_Relative expiration;
+
+	/**
+	 * When the service asked for the put
+	 */
+	struct GNUNET_TIME_Absolute requested;
+
+	/**
+	 * Handle of the put, NULL while it waits
+	 */
+	struct GNUNET_DHT_PutHandle *ph;
+
+	/**
+	 * Number of bytes of the block
+	 */
+	size_t size;
+
+	/* followed by the block */
+};
+
+/**
+ * Puts in flight of one group
+ */
+struct GroupPuts
+{
+	/**
+	 * Number of puts in flight
+	 */
+	unsigned int active;
+};
+
+/**
+ * Handle to the DHT
+ */
+static struct GNUNET_DHT_Handle *dht_handle;
+
+/**
+ * Handle for the statistics service.
+ */
+static struct GNUNET_STATISTICS_Handle *scrb_stats;
+
+/**
+ * Head of the puts in flight
+ */
+static struct PendingPut *active_head;
+
+/**
+ * Tail of the puts in flight
+ */
+static struct PendingPut *active_tail;
+
+/**
+ * Head of the waiting puts
+ */
+static struct PendingPut *queue_head;
+
+/**
+ * Tail of the waiting puts
+ */
+static struct PendingPut *queue_tail;
+
+/**
+ * Head of the waiting control puts
+ */
+static struct PendingPut *control_head;
+
+/**
+ * Tail of the waiting control puts
+ */
+static struct PendingPut *control_tail;
+
+/**
+ * Number of puts in flight
+ */
+static unsigned int num_active;
+
+/**
+ * Number of waiting puts
+ */
+static unsigned int num_queued;
+
+/**
+ * Number of waiting control puts
+ */
+static unsigned int num_control_queued;
+
+/**
+ * Map of group ids to `struct GroupPuts`
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *group_puts;
+
+/**
+ * Puts in flight before further ones wait, 0 for no limit
+ */
+static unsigned long long max_puts;
+
+/**
+ * Puts in flight per group before further ones wait, 0 for no limit
+ */
+static unsigned long long max_group_puts;
+
+/**
+ * Waiting puts before further ones are dropped
+ */
+static unsigned long long max_queued_puts;
+
+
+/**
+ * Publishes the number of puts in flight and waiting
+ */
+static void
+update_gauges ()
+{
+	GNUNET_STATISTICS_set (scrb_stats, gettext_noop ("# DHT puts: in flight"),
+			num_active, GNUNET_NO);
+	GNUNET_STATISTICS_set (scrb_stats, gettext_noop ("# DHT puts: queued"),
+			num_queued, GNUNET_NO);
+	GNUNET_STATISTICS_set (scrb_stats, gettext_noop ("# DHT puts: control queued"),
+			num_control_queued, GNUNET_NO);
+}
+
+
+/**
+ * Returns the number of puts in flight for @a key
+ */
+static unsigned int
+get_group_active (const struct GNUNET_HashCode *key)
+{
+	struct GroupPuts *gp = GNUNET_CONTAINER_multihashmap_get (group_puts, key);
+
+	return (NULL == gp) ? 0 : gp->active;
+}
+
+
+/**
+ * Checks if a put for @a key may start now
+ */
+static int
+may_start (const struct GNUNET_HashCode *key)
+{
+	if ((0 != max_puts) && (num_active >= max_puts))
+		return GNUNET_NO;
+	if ((0 != max_group_puts) && (get_group_active (key) >= max_group_puts))
+		return GNUNET_NO;
+	return GNUNET_YES;
+}
+
+
+/**
+ * Removes a put from the table of puts in flight
+ */
+static void
+remove_active (struct PendingPut *pp)
+{
+	struct GroupPuts *gp = GNUNET_CONTAINER_multihashmap_get (group_puts, &pp->key);
+
+	GNUNET_CONTAINER_DLL_remove (active_head, active_tail, pp);
+	num_active--;
+	GNUNET_assert ((NULL != gp) && (0 < gp->active));
+	if (0 == --gp->active)
+	{
+		GNUNET_CONTAINER_multihashmap_remove (group_puts, &pp->key, gp);
+		GNUNET_free (gp);
+	}
+}
+
+
+static void
+start_queued ();
+
+
+/**
+ * The DHT took a put or gave up on it
+ *
+ * @param cls the `struct PendingPut`
+ * @param success #GNUNET_OK if the put was transmitted
+ */
+static void
+put_done (void *cls, int success)
+{
+	struct PendingPut *pp = cls;
+
+	pp->ph = NULL;
+	remove_active (pp);
+	if (GNUNET_OK == success)
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# DHT puts: completed"), 1, GNUNET_NO);
+	else
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# DHT puts: failed"), 1, GNUNET_NO);
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# DHT puts: total latency in ms"),
+			GNUNET_TIME_absolute_get_duration (pp->requested).rel_value_us / 1000LL,
+			GNUNET_NO);
+	GNUNET_free (pp);
+	start_queued ();
+	update_gauges ();
+}
+
+
+/**
+ * Hands a put to the DHT
+ *
+ * @param pp the put
+ */
+static void
+start_put (struct PendingPut *pp)
+{
+	struct GroupPuts *gp = GNUNET_CONTAINER_multihashmap_get (group_puts, &pp->key);
+
+	if (NULL == gp)
+	{
+		gp = GNUNET_new (struct GroupPuts);
+		GNUNET_CONTAINER_multihashmap_put (group_puts, &pp->key, gp,
+				GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
+	}
+	gp->active++;
+	GNUNET_CONTAINER_DLL_insert_tail (active_head, active_tail, pp);
+	num_active++;
+	/* the put is useless once the block expired, do not wait longer */
+	pp->ph = GNUNET_DHT_put (dht_handle, &pp->key, 1,
+			GNUNET_DHT_RO_RECORD_ROUTE |
+			GNUNET_DHT_RO_DEMULTIPLEX_EVERYWHERE | GNUNET_DHT_RO_LAST_HOP,
+			pp->type,
+			pp->size, &pp[1],
+			GNUNET_TIME_relative_to_absolute (pp->expiration),
+			pp->expiration,
+			&put_done, pp);
+	if (NULL == pp->ph)
+	{
+		GNUNET_break (0);
+		remove_active (pp);
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# DHT puts: failed"), 1, GNUNET_NO);
+		GNUNET_free (pp);
+	}
+}
+
+
+/**
+ * Starts the puts of a queue which got a slot, in their order
+ *
+ * @param head head of the queue
+ * @param tail tail of the queue
+ * @param queued length of the queue
+ * @return #GNUNET_NO if no slot is left
+ */
+static int
+start_queue (struct PendingPut **head,
+		struct PendingPut **tail,
+		unsigned int *queued)
+{
+	struct PendingPut *pp;
+	struct PendingPut *next;
+
+	for (pp = *head; NULL != pp; pp = next)
+	{
+		if ((0 != max_puts) && (num_active >= max_puts))
+			return GNUNET_NO;
+		next = pp->next;
+		if (GNUNET_YES != may_start (&pp->key))
+			continue;
+		GNUNET_CONTAINER_DLL_remove (*head, *tail, pp);
+		(*queued)--;
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# DHT puts: total queueing delay in ms"),
+				GNUNET_TIME_absolute_get_duration (pp->requested).rel_value_us / 1000LL,
+				GNUNET_NO);
+		start_put (pp);
+	}
+	return GNUNET_YES;
+}
+
+
+/**
+ * Starts the waiting puts which got a slot, the control puts first
+ */
+static void
+start_queued ()
+{
+	if (GNUNET_YES == start_queue (&control_head, &control_tail,
+			&num_control_queued))
+		start_queue (&queue_head, &queue_tail, &num_queued);
+}
+
+
+void
+GSS_DHT_init (const struct GNUNET_CONFIGURATION_Handle *cfg,
+		struct GNUNET_DHT_Handle *dht,
+		struct GNUNET_STATISTICS_Handle *stats)
+{
+	dht_handle = dht;
+	scrb_stats = stats;
+	if (GNUNET_OK != GNUNET_CONFIGURATION_get_value_number (cfg, "scrb",
+			"DHT_MAX_PUTS", &max_puts))
+		max_puts = DEFAULT_MAX_PUTS;
+	if (GNUNET_OK != GNUNET_CONFIGURATION_get_value_number (cfg, "scrb",
+			"DHT_MAX_GROUP_PUTS", &max_group_puts))
+		max_group_puts = DEFAULT_MAX_GROUP_PUTS;
+	if (GNUNET_OK != GNUNET_CONFIGURATION_get_value_number (cfg, "scrb",
+			"DHT_MAX_QUEUED_PUTS", &max_queued_puts))
+		max_queued_puts = DEFAULT_MAX_QUEUED_PUTS;
+	group_puts = GNUNET_CONTAINER_multihashmap_create (64, GNUNET_NO);
+}
+
+
+void
+GSS_DHT_done ()
+{
+	struct PendingPut *pp;
+
+	if (NULL == group_puts)
+		return;
+	while (NULL != (pp = active_head))
+	{
+		GNUNET_DHT_put_cancel (pp->ph);
+		remove_active (pp);
+		GNUNET_free (pp);
+	}
+	while (NULL != (pp = queue_head))
+	{
+		GNUNET_CONTAINER_DLL_remove (queue_head, queue_tail, pp);
+		GNUNET_free (pp);
+	}
+	while (NULL != (pp = control_head))
+	{
+		GNUNET_CONTAINER_DLL_remove (control_head, control_tail, pp);
+		GNUNET_free (pp);
+	}
+	num_queued = 0;
+	num_control_queued = 0;
+	GNUNET_CONTAINER_multihashmap_destroy (group_puts);
+	group_puts = NULL;
+	dht_handle = NULL;
+}
+
+
+/**
+ * Starts a put or queues it
+ *
+ * @param key key of the block
+ * @param type block type
+ * @param size number of bytes in @a data
+ * @param data the block, copied
+ * @param expiration how long the DHT keeps the block
+ * @param control #GNUNET_YES to queue the put with the control puts
+ * @return #GNUNET_OK if the put was started or queued,
+ *         #GNUNET_NO if it was dropped
+ */
+static int
+queue_put (const struct GNUNET_HashCode *key,
+		enum GNUNET_BLOCK_Type type,
+		size_t size,
+		const void *data,
+		struct GNUNET_TIME_Relative expiration,
+		int control)
+{
+	struct PendingPut *pp;
+
+	if (NULL == group_puts)
+		return GNUNET_NO;
+	if ((GNUNET_YES != control) &&
+			(GNUNET_YES != may_start (key)) && (num_queued >= max_queued_puts))
+	{
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# DHT puts: dropped, queue full"), 1, GNUNET_NO);
+		return GNUNET_NO;
+	}
+	pp = GNUNET_malloc (sizeof (struct PendingPut) + size);
+	pp->key = *key;
+	pp->type = type;
+	pp->expiration = expiration;
+	pp->requested = GNUNET_TIME_absolute_get ();
+	pp->size = size;
+	memcpy (&pp[1], data, size);
+	/* waiting control puts go first, do not overtake them */
+	if ((GNUNET_YES == may_start (key)) &&
+			((GNUNET_YES == control) || (NULL == control_head)))
+		start_put (pp);
+	else if (GNUNET_YES == control)
+	{
+		GNUNET_CONTAINER_DLL_insert_tail (control_head, control_tail, pp);
+		num_control_queued++;
+	}
+	else
+	{
+		/* puts blocked by the overall limit keep their order, puts of
+		 * other groups may overtake those blocked by their group limit */
+		GNUNET_CONTAINER_DLL_insert_tail (queue_head, queue_tail, pp);
+		num_queued++;
+	}
+	update_gauges ();
+	return GNUNET_OK;
+}
+
+
+int
+GSS_DHT_put (const struct GNUNET_HashCode *key,
+		enum GNUNET_BLOCK_Type type,
+		size_t size,
+		const void *data,
+		struct GNUNET_TIME_Relative expiration)
+{
+	return queue_put (key, type, size, data, expiration, GNUNET_NO);
+}
+
+
+int
+GSS_DHT_put_control (const struct GNUNET_HashCode *key,
+		enum GNUNET_BLOCK_Type type,
+		size_t size,
+		const void *data,
+		struct GNUNET_TIME_Relative expiration)
+{
+	return queue_put (key, type, size, data, expiration, GNUNET_YES);
+}
+
+/* end of gnunet-service-scrb_dht.c */
@@ -0,0 +1,94 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/gnunet-service-scrb_dht.h
+ * @brief DHT puts of the scrb service
+ * @author azhdanov
+ */
+
+#ifndef GNUNET_SERVICE_SCRB_DHT_H
+#define GNUNET_SERVICE_SCRB_DHT_H
+
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include <gnunet/gnunet_dht_service.h>
+#include <gnunet/gnunet_statistics_service.h>
+
+/**
+ * Initializes the put scheduler.  The limits are read from the "scrb"
+ * section of @a cfg.
+ *
+ * @param cfg configuration to use
+ * @param dht handle to the DHT
+ * @param stats statistics handle
+ */
+void
+GSS_DHT_init (const struct GNUNET_CONFIGURATION_Handle *cfg,
+		struct GNUNET_DHT_Handle *dht,
+		struct GNUNET_STATISTICS_Handle *stats);
+
+/**
+ * Cancels the puts in flight and drops the queued ones.
+ */
+void
+GSS_DHT_done (void);
+
+/**
+ * Puts a scrb block into the DHT.  The put starts at once unless too
+ * many puts are in flight, overall or for @a key, then it waits in a
+ * queue.
+ *
+ * @param key key of the block, the id of the group or stripe
+ * @param type block type
+ * @param size number of bytes in @a data
+ * @param data the block, copied
+ * @param expiration how long the DHT keeps the block
+ * @return #GNUNET_OK if the put was started or queued,
+ *         #GNUNET_NO if it was dropped as the queue is full
+ */
+int
+GSS_DHT_put (const struct GNUNET_HashCode *key,
+		enum GNUNET_BLOCK_Type type,
+		size_t size,
+		const void *data,
+		struct GNUNET_TIME_Relative expiration);
+
+/**
+ * Puts a control block (JOIN, LEAVE, CREATE) into the DHT.  Like
+ * GSS_DHT_put(), but the put is never dropped and waits ahead of the
+ * multicast puts.
+ *
+ * @param key key of the block, the id of the group or stripe
+ * @param type block type
+ * @param size number of bytes in @a data
+ * @param data the block, copied
+ * @param expiration how long the DHT keeps the block
+ * @return #GNUNET_OK if the put was started or queued,
+ *         #GNUNET_NO if the service is shutting down
+ */
+int
+GSS_DHT_put_control (const struct GNUNET_HashCode *key,
+		enum GNUNET_BLOCK_Type type,
+		size_t size,
+		const void *data,
+		struct GNUNET_TIME_Relative expiration);
+
+#endif
@@ -0,0 +1,1071 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/gnunet-service-scrb_neighbours.c
+ * @brief per neighbour transmission queues of the scrb service
+ * @author azhdanov
+ *
+ * Multicast messages are serialized once into a #GNUNET_SCRB_Frame and
+ * every neighbour only queues a reference to it.  A neighbour asks CORE
+ * for one transmission at a time, the frames are copied straight into
+ * the CORE buffer once the link is ready, there is no envelope per link.
+ *
+ * There is one entry and one pending CORE transmission per remote peer.  The
+ * groups, parents and children of the service hold references to the
+ * entries of the peers they talk to, entries nobody references are
+ * freed once their queue drained.
+ *
+ * The queue of a neighbour holds at most MAX_QUEUE_LENGTH multicast
+ * frames, so a slow child can neither exhaust our memory nor hold back
+ * its siblings.  Control messages are never dropped.
+ *
+ * Multicast frames queued for the same neighbour are packed into one
+ * MULTICAST_BATCH message of up to BATCH_SIZE bytes.  A frame for an
+ * idle link waits at most BATCH_DELAY for company, frames queued while
+ * the link is busy go out as soon as CORE took the previous message.
+ *
+ * A parent names its groups on the link to a child by small handles,
+ * the child keeps them in a flat array per neighbour.
+ *
+ * Tree edges which were idle for HEARTBEAT_INTERVAL carry a heartbeat.
+ * A parent or child we did not hear from for #HEARTBEAT_MISSES
+ * intervals is reported dead, this catches half-open links CORE still
+ * considers connected.  Links held only to reach the originator or the
+ * creator of a group are no tree edges, those peers never send to us.
+ */
+#include "gnunet-service-scrb_neighbours.h"
+#include "gnunet_protocols_scrb.h"
+#include "scrb_multicast.h"
+
+/**
+ * What to do with a multicast frame for a neighbour whose queue is full
+ */
+enum DropPolicy
+{
+	/**
+	 * Drop the oldest queued multicast frame
+	 */
+	DROP_OLDEST,
+
+	/**
+	 * Drop the new frame
+	 */
+	DROP_NEWEST,
+
+	/**
+	 * Drop the new frame, disconnect the neighbour after
+	 * MAX_QUEUE_DROPS drops in a row
+	 */
+	DROP_DISCONNECT
+};
+
+/**
+ * Values of the QUEUE_DROP_POLICY option, indexed by `enum DropPolicy`
+ */
+static const char *const drop_policies[] = {
+	"OLDEST",
+	"NEWEST",
+	"DISCONNECT",
+	NULL
+};
+
+/**
+ * Default number of multicast frames queued per neighbour
+ */
+#define DEFAULT_MAX_QUEUE_LENGTH 64
+
+/**
+ * Default number of drops after which DISCONNECT cuts a neighbour off
+ */
+#define DEFAULT_MAX_QUEUE_DROPS 256
+
+/**
+ * Default longest time a multicast waits on an idle link for others
+ */
+#define DEFAULT_BATCH_DELAY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MILLISECONDS, 2)
+
+/**
+ * Default number of queued bytes after which a batch is sent at once
+ */
+#define DEFAULT_BATCH_SIZE 8192
+
+/**
+ * Default interval of heartbeats on idle links
+ */
+#define DEFAULT_HEARTBEAT_INTERVAL GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 5)
+
+/**
+ * Number of heartbeat intervals of silence after which a neighbour is dead
+ */
+#define HEARTBEAT_MISSES 3
+
+/**
+ * A peer we send frames to.
+ */
+struct GSS_Neighbour
+{
+	/**
+	 * Identity of the neighbour
+	 */
+	struct GNUNET_PeerIdentity peer;
+
+	/**
+	 * Transmission requested from CORE, NULL if none
+	 */
+	struct GNUNET_CORE_TransmitHandle *th;
+
+	/**
+	 * Frames taken off the queue for @e th, copied when CORE is ready
+	 */
+	struct GNUNET_SCRB_Frame **sending;
+
+	/**
+	 * Number of slots in @e sending
+	 */
+	unsigned int sending_size;
+
+	/**
+	 * Number of frames in @e sending
+	 */
+	unsigned int num_sending;
+
+	/**
+	 * Size of the message @e th transmits
+	 */
+	size_t sending_bytes;
+
+	/**
+	 * #GNUNET_YES if the frames in @e sending go out as one batch
+	 */
+	int batched;
+
+	/**
+	 * Number of references held by the service
+	 */
+	unsigned int rc;
+
+	/**
+	 * Number of the references in @e rc which are tree edges
+	 */
+	unsigned int edges;
+
+	/**
+	 * Task freeing the entry after its queue drained, if unreferenced
+	 */
+	GNUNET_SCHEDULER_TaskIdentifier idle_task;
+
+	/**
+	 * Frames waiting for transmission
+	 */
+	struct GNUNET_SCRB_FrameQueue queue;
+
+	/**
+	 * Task sending the queued multicast frames once #batch_delay passed
+	 */
+	GNUNET_SCHEDULER_TaskIdentifier flush_task;
+
+	/**
+	 * Task disconnecting the neighbour, set once it lagged too far
+	 */
+	GNUNET_SCHEDULER_TaskIdentifier disconnect_task;
+
+	/**
+	 * Number of multicast frames queued
+	 */
+	unsigned int multicasts;
+
+	/**
+	 * Number of multicast frames dropped for this neighbour
+	 */
+	unsigned long long drops;
+
+	/**
+	 * Number of multicast frames dropped for this neighbour since a
+	 * transmission to it last succeeded
+	 */
+	unsigned long long drops_in_a_row;
+
+	/**
+	 * Groups by the handles the neighbour names them with
+	 */
+	const struct GNUNET_HashCode **handles;
+
+	/**
+	 * Number of entries in @e handles
+	 */
+	unsigned int handles_size;
+
+	/**
+	 * When we received the last message from the neighbour
+	 */
+	struct GNUNET_TIME_Absolute last_heard;
+
+	/**
+	 * When we handed the last message for the neighbour to CORE
+	 */
+	struct GNUNET_TIME_Absolute last_sent;
+};
+
+/**
+ * Silent neighbours found by a heartbeat round
+ */
+struct HeartbeatContext
+{
+	/**
+	 * Heartbeat shared by the idle links, NULL until needed
+	 */
+	struct GNUNET_SCRB_Frame *frame;
+
+	/**
+	 * Identities of the silent neighbours
+	 */
+	struct GNUNET_PeerIdentity *dead;
+
+	/**
+	 * Number of entries in @e dead
+	 */
+	unsigned int num_dead;
+};
+
+/**
+ * Handle to CORE.
+ */
+static struct GNUNET_CORE_Handle *core_api;
+
+/**
+ * Handle for the statistics service.
+ */
+static struct GNUNET_STATISTICS_Handle *scrb_stats;
+
+/**
+ * Map of peer identities to `struct GSS_Neighbour`.
+ */
+static struct GNUNET_CONTAINER_MultiPeerMap *neighbours;
+
+/**
+ * Number of multicast frames queued per neighbour before we drop
+ */
+static unsigned long long max_queue_length;
+
+/**
+ * Drops after which the DISCONNECT policy cuts a neighbour off
+ */
+static unsigned long long max_queue_drops;
+
+/**
+ * Policy for frames exceeding the queue limit
+ */
+static enum DropPolicy drop_policy;
+
+/**
+ * Longest time a multicast frame waits for others on an idle link
+ */
+static struct GNUNET_TIME_Relative batch_delay;
+
+/**
+ * Size of the batch after which it is sent without waiting
+ */
+static unsigned long long batch_size;
+
+/**
+ * Interval of heartbeats on idle links, 0 if heartbeats are off
+ */
+static struct GNUNET_TIME_Relative heartbeat_interval;
+
+/**
+ * Task sending heartbeats and looking for silent neighbours
+ */
+static GNUNET_SCHEDULER_TaskIdentifier heartbeat_task;
+
+/**
+ * Called for neighbours cut off by the drop policy
+ */
+static GSS_NEIGHBOURS_LaggingCallback lagging_cb;
+
+/**
+ * Called for neighbours which fell silent
+ */
+static GSS_NEIGHBOURS_DeadCallback dead_cb;
+
+/**
+ * Closure for #lagging_cb and #dead_cb
+ */
+static void *cb_cls;
+
+
+static void
+transmit_next (struct GSS_Neighbour *n);
+
+static void
+free_neighbour (struct GSS_Neighbour *n);
+
+
+/**
+ * Checks if nobody references @a n and nothing is left to send to it
+ */
+static int
+is_idle (const struct GSS_Neighbour *n)
+{
+	return ((0 == n->rc) && (0 == n->queue.length) && (NULL == n->th) &&
+			(GNUNET_SCHEDULER_NO_TASK == n->disconnect_task)) ? GNUNET_YES : GNUNET_NO;
+}
+
+
+/**
+ * Frees @a n if it is idle
+ */
+static void
+free_if_idle (struct GSS_Neighbour *n)
+{
+	if (GNUNET_NO == is_idle (n))
+		return;
+	GNUNET_CONTAINER_multipeermap_remove (neighbours, &n->peer, n);
+	free_neighbour (n);
+}
+
+
+/**
+ * Frees the neighbour if it is still idle.  Runs as its own task, the
+ * entry must not be freed from the CORE callback using it.
+ *
+ * @param cls the `struct GSS_Neighbour`
+ * @param tc scheduler context
+ */
+static void
+free_idle (void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	struct GSS_Neighbour *n = cls;
+
+	n->idle_task = GNUNET_SCHEDULER_NO_TASK;
+	free_if_idle (n);
+}
+
+
+/**
+ * Checks if @a frame carries a multicast message
+ */
+static int
+is_multicast (const struct GNUNET_SCRB_Frame *frame)
+{
+	uint16_t type = ntohs (GNUNET_SCRB_frame_msg (frame)->type);
+
+	return ((GNUNET_MESSAGE_TYPE_SCRB_MULTICAST == type) ||
+			(GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_DOWN == type)) ? GNUNET_YES : GNUNET_NO;
+}
+
+
+/**
+ * Releases the frames taken off the queue of @a n for a transmission
+ *
+ * @param n the neighbour
+ */
+static void
+release_sending (struct GSS_Neighbour *n)
+{
+	while (0 < n->num_sending)
+		GNUNET_SCRB_frame_unref (n->sending[--n->num_sending]);
+	n->sending_bytes = 0;
+}
+
+
+/**
+ * CORE is ready to transmit to @a cls, copy the frames taken off its
+ * queue into the buffer and ask for the next transmission.
+ *
+ * @param cls the `struct GSS_Neighbour`
+ * @param size number of bytes available in @a buf
+ * @param buf where to copy the message, NULL if CORE gave up
+ * @return number of bytes written to @a buf
+ */
+static size_t
+transmit_ready (void *cls, size_t size, void *buf)
+{
+	struct GSS_Neighbour *n = cls;
+	struct GNUNET_MessageHeader *batch;
+	struct GNUNET_SCRB_Frame *frame;
+	char *pos = buf;
+	size_t ret = n->sending_bytes;
+	unsigned int i;
+
+	n->th = NULL;
+	if ((NULL == buf) || (size < ret))
+	{
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# neighbours: transmissions failed"),
+				n->num_sending, GNUNET_NO);
+		release_sending (n);
+		ret = 0;
+	}
+	else
+	{
+		if (GNUNET_YES == n->batched)
+		{
+			batch = (struct GNUNET_MessageHeader *) pos;
+			batch->size = htons ((uint16_t) ret);
+			batch->type = htons (GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_BATCH);
+			pos += sizeof (struct GNUNET_MessageHeader);
+			GNUNET_STATISTICS_update (scrb_stats,
+					gettext_noop ("# neighbours: batches transmitted"),
+					1, GNUNET_NO);
+		}
+		for (i = 0; i < n->num_sending; i++)
+		{
+			frame = n->sending[i];
+			memcpy (pos, GNUNET_SCRB_frame_msg (frame), frame->size);
+			pos += frame->size;
+		}
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# neighbours: frames transmitted"),
+				n->num_sending, GNUNET_NO);
+		/* the link keeps up again, DISCONNECT counts anew */
+		n->drops_in_a_row = 0;
+		release_sending (n);
+	}
+	transmit_next (n);
+	if ((GNUNET_YES == is_idle (n)) && (GNUNET_SCHEDULER_NO_TASK == n->idle_task))
+		n->idle_task = GNUNET_SCHEDULER_add_now (&free_idle, n);
+	return ret;
+}
+
+
+/**
+ * Asks CORE to transmit the frames taken off the queue of @a n
+ *
+ * @param n neighbour to transmit to
+ */
+static void
+request_transmission (struct GSS_Neighbour *n)
+{
+	n->last_sent = GNUNET_TIME_absolute_get ();
+	n->th = GNUNET_CORE_notify_transmit_ready (core_api, GNUNET_NO,
+			GNUNET_CORE_PRIO_BEST_EFFORT, GNUNET_TIME_UNIT_FOREVER_REL,
+			&n->peer, n->sending_bytes, &transmit_ready, n);
+	if (NULL != n->th)
+		return;
+	GNUNET_break (0);
+	release_sending (n);
+}
+
+
+/**
+ * Takes the oldest frame off the queue of @a n for a transmission
+ *
+ * @param n the neighbour
+ */
+static void
+take_frame (struct GSS_Neighbour *n)
+{
+	struct GNUNET_SCRB_Frame *frame = GNUNET_SCRB_frame_queue_pop (&n->queue);
+
+	if (GNUNET_YES == is_multicast (frame))
+		n->multicasts--;
+	if (n->num_sending == n->sending_size)
+		GNUNET_array_grow (n->sending, n->sending_size,
+				GNUNET_MAX (4, 2 * n->sending_size));
+	n->sending[n->num_sending++] = frame;
+	n->sending_bytes += frame->size;
+}
+
+
+/**
+ * Sends the oldest queued frame of @a n on its own.
+ *
+ * @param n neighbour to transmit to
+ */
+static void
+transmit_single (struct GSS_Neighbour *n)
+{
+	n->batched = GNUNET_NO;
+	take_frame (n);
+	request_transmission (n);
+}
+
+
+/**
+ * Packs the multicast frames at the head of the queue of @a n into one
+ * batch, a lone frame is sent as it is.
+ *
+ * @param n neighbour to transmit to
+ */
+static void
+transmit_batch (struct GSS_Neighbour *n)
+{
+	struct GNUNET_SCRB_Frame *frame;
+	size_t size = sizeof (struct GNUNET_MessageHeader);
+	unsigned int count = 0;
+
+	while (count < n->queue.length)
+	{
+		frame = n->queue.ring[(n->queue.head + count) % n->queue.ring_size];
+		if ((GNUNET_NO == is_multicast (frame)) ||
+				(size + frame->size > batch_size))
+			break;
+		size += frame->size;
+		count++;
+	}
+	if (count < 2)
+	{
+		transmit_single (n);
+		return;
+	}
+	n->batched = GNUNET_YES;
+	n->sending_bytes = sizeof (struct GNUNET_MessageHeader);
+	while (0 < count--)
+		take_frame (n);
+	request_transmission (n);
+}
+
+
+/**
+ * Hands the oldest queued frames of @a n to CORE unless a
+ * transmission is already pending.
+ *
+ * @param n neighbour to transmit to
+ */
+static void
+transmit_next (struct GSS_Neighbour *n)
+{
+	struct GNUNET_SCRB_Frame *frame;
+
+	if (NULL != n->th)
+		return;
+	if (GNUNET_SCHEDULER_NO_TASK != n->flush_task)
+	{
+		GNUNET_SCHEDULER_cancel (n->flush_task);
+		n->flush_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	frame = GNUNET_SCRB_frame_queue_peek (&n->queue);
+	if (NULL == frame)
+		return;
+	if (GNUNET_YES == is_multicast (frame))
+		transmit_batch (n);
+	else
+		transmit_single (n);
+}
+
+
+/**
+ * The batch delay of @a n passed, send what is queued.
+ *
+ * @param cls the `struct GSS_Neighbour`
+ * @param tc scheduler context
+ */
+static void
+flush_batch (void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	struct GSS_Neighbour *n = cls;
+
+	n->flush_task = GNUNET_SCHEDULER_NO_TASK;
+	transmit_next (n);
+}
+
+
+/**
+ * Looks up the neighbour entry of @a peer, creating it if needed.
+ *
+ * @param peer identity of the neighbour
+ * @return the neighbour entry
+ */
+static struct GSS_Neighbour *
+get_neighbour (const struct GNUNET_PeerIdentity *peer)
+{
+	struct GSS_Neighbour *n;
+
+	n = GNUNET_CONTAINER_multipeermap_get (neighbours, peer);
+	if (NULL != n)
+		return n;
+	n = GNUNET_new (struct GSS_Neighbour);
+	n->peer = *peer;
+	/* a new link gets the full grace period */
+	n->last_heard = GNUNET_TIME_absolute_get ();
+	n->last_sent = n->last_heard;
+	GNUNET_CONTAINER_multipeermap_put (neighbours, &n->peer, n,
+			GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
+	GNUNET_STATISTICS_set (scrb_stats, gettext_noop ("# neighbours: entries"),
+			GNUNET_CONTAINER_multipeermap_size (neighbours), GNUNET_NO);
+	return n;
+}
+
+
+/**
+ * Drops everything queued for @a n and cancels its CORE transmission,
+ * the link is used again with the next frame.
+ *
+ * @param n the neighbour
+ */
+static void
+reset_link (struct GSS_Neighbour *n)
+{
+	if (GNUNET_SCHEDULER_NO_TASK != n->flush_task)
+	{
+		GNUNET_SCHEDULER_cancel (n->flush_task);
+		n->flush_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	GNUNET_SCRB_frame_queue_clear (&n->queue);
+	n->multicasts = 0;
+	if (NULL != n->th)
+	{
+		GNUNET_CORE_notify_transmit_ready_cancel (n->th);
+		n->th = NULL;
+	}
+	release_sending (n);
+}
+
+
+/**
+ * Frees a neighbour entry together with its queued frames.
+ *
+ * @param n entry to free
+ */
+static void
+free_neighbour (struct GSS_Neighbour *n)
+{
+	if (GNUNET_SCHEDULER_NO_TASK != n->idle_task)
+		GNUNET_SCHEDULER_cancel (n->idle_task);
+	if (GNUNET_SCHEDULER_NO_TASK != n->disconnect_task)
+		GNUNET_SCHEDULER_cancel (n->disconnect_task);
+	reset_link (n);
+	GNUNET_array_grow (n->sending, n->sending_size, 0);
+	GNUNET_array_grow (n->handles, n->handles_size, 0);
+	GNUNET_free (n);
+	if (NULL != neighbours)
+		GNUNET_STATISTICS_set (scrb_stats, gettext_noop ("# neighbours: entries"),
+				GNUNET_CONTAINER_multipeermap_size (neighbours), GNUNET_NO);
+}
+
+
+/**
+ * Free memory occupied by an entry in the neighbour map.
+ *
+ * @param cls unused
+ * @param key unused
+ * @param value a `struct GSS_Neighbour *`
+ * @return #GNUNET_OK (continue to iterate)
+ */
+static int
+cleanup_neighbour (void *cls,
+		const struct GNUNET_PeerIdentity *key,
+		void *value)
+{
+	free_neighbour (value);
+	return GNUNET_OK;
+}
+
+
+/**
+ * Drops the frames of a neighbour which dropped too many of them and
+ * tells the service about it.  Runs as its own task, so the service may
+ * drop the neighbour from its groups while nobody iterates over them.
+ *
+ * @param cls the `struct GSS_Neighbour`
+ * @param tc scheduler context
+ */
+static void
+disconnect_lagging (void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	struct GSS_Neighbour *n = cls;
+	struct GNUNET_PeerIdentity peer = n->peer;
+
+	n->disconnect_task = GNUNET_SCHEDULER_NO_TASK;
+	GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+			"Disconnecting %s after %llu frames dropped in a row\n",
+			GNUNET_i2s (&peer), n->drops_in_a_row);
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# neighbours: disconnected for lagging"),
+			1, GNUNET_NO);
+	reset_link (n);
+	n->drops_in_a_row = 0;
+	/* the service releases its references in the callback */
+	n->rc++;
+	if (NULL != lagging_cb)
+		lagging_cb (cb_cls, &peer);
+	n->rc--;
+	free_if_idle (n);
+}
+
+
+/**
+ * Accounts for a multicast frame dropped for @a n and applies the
+ * DISCONNECT policy.  Only drops in a row count for the policy, a link
+ * which drops now and then under bursts stays.
+ *
+ * @param n neighbour the frame was meant for
+ */
+static void
+frame_dropped (struct GSS_Neighbour *n)
+{
+	char name[128];
+
+	n->drops++;
+	n->drops_in_a_row++;
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# neighbours: multicasts dropped"),
+			1, GNUNET_NO);
+	GNUNET_snprintf (name, sizeof (name),
+			"# neighbours: multicasts dropped for: %s",
+			GNUNET_i2s (&n->peer));
+	GNUNET_STATISTICS_update (scrb_stats, name, 1, GNUNET_NO);
+	GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+			"Queue of %s is full, %llu frames dropped so far\n",
+			GNUNET_i2s (&n->peer), n->drops);
+	if ((DROP_DISCONNECT == drop_policy) &&
+			(n->drops_in_a_row >= max_queue_drops) &&
+			(GNUNET_SCHEDULER_NO_TASK == n->disconnect_task))
+		n->disconnect_task = GNUNET_SCHEDULER_add_now (&disconnect_lagging, n);
+}
+
+
+/**
+ * Queues a heartbeat for a tree edge which was idle for an interval
+ * and collects the neighbours which stayed silent too long.
+ *
+ * @param cls the `struct HeartbeatContext`
+ * @param key identity of the neighbour
+ * @param value the `struct GSS_Neighbour`
+ * @return #GNUNET_YES to continue
+ */
+static int
+check_heartbeat (void *cls,
+		const struct GNUNET_PeerIdentity *key,
+		void *value)
+{
+	struct HeartbeatContext *ctx = cls;
+	struct GSS_Neighbour *n = value;
+	struct GNUNET_MessageHeader hb;
+
+	if (0 == n->edges)
+		return GNUNET_YES;
+	if (GNUNET_TIME_absolute_get_duration (n->last_heard).rel_value_us >
+			HEARTBEAT_MISSES * heartbeat_interval.rel_value_us)
+	{
+		GNUNET_array_append (ctx->dead, ctx->num_dead, n->peer);
+		return GNUNET_YES;
+	}
+	if (GNUNET_TIME_absolute_get_duration (n->last_sent).rel_value_us <
+			heartbeat_interval.rel_value_us)
+		return GNUNET_YES;
+	if (NULL == ctx->frame)
+	{
+		hb.size = htons (sizeof (hb));
+		hb.type = htons (GNUNET_MESSAGE_TYPE_SCRB_HEARTBEAT);
+		ctx->frame = GNUNET_SCRB_frame_create (&hb);
+	}
+	GSS_NEIGHBOURS_send (n, ctx->frame);
+	GNUNET_STATISTICS_update (scrb_stats,
+			gettext_noop ("# neighbours: heartbeats sent"),
+			1, GNUNET_NO);
+	return GNUNET_YES;
+}
+
+
+/**
+ * Sends the heartbeats of a round and reports the silent neighbours.
+ *
+ * @param cls unused
+ * @param tc scheduler context
+ */
+static void
+heartbeat_round (void *cls,
+		const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	struct HeartbeatContext ctx;
+	struct GSS_Neighbour *n;
+	unsigned int i;
+
+	heartbeat_task = GNUNET_SCHEDULER_NO_TASK;
+	ctx.frame = NULL;
+	ctx.dead = NULL;
+	ctx.num_dead = 0;
+	GNUNET_CONTAINER_multipeermap_iterate (neighbours, &check_heartbeat, &ctx);
+	if (NULL != ctx.frame)
+		GNUNET_SCRB_frame_unref (ctx.frame);
+	/* the service drops the links in the callback, not while we iterate */
+	for (i = 0; i < ctx.num_dead; i++)
+	{
+		n = GNUNET_CONTAINER_multipeermap_get (neighbours, &ctx.dead[i]);
+		if (NULL == n)
+			continue;
+		GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+				"No heartbeat from %s, considering it dead\n",
+				GNUNET_i2s (&n->peer));
+		GNUNET_STATISTICS_update (scrb_stats,
+				gettext_noop ("# neighbours: declared dead"),
+				1, GNUNET_NO);
+		reset_link (n);
+		n->last_heard = GNUNET_TIME_absolute_get ();
+		n->rc++;
+		if (NULL != dead_cb)
+			dead_cb (cb_cls, &ctx.dead[i]);
+		n->rc--;
+		free_if_idle (n);
+	}
+	GNUNET_array_grow (ctx.dead, ctx.num_dead, 0);
+	heartbeat_task = GNUNET_SCHEDULER_add_delayed (heartbeat_interval,
+			&heartbeat_round, NULL);
+}
+
+
+void
+GSS_NEIGHBOURS_init (const struct GNUNET_CONFIGURATION_Handle *cfg,
+		struct GNUNET_CORE_Handle *core,
+		struct GNUNET_STATISTICS_Handle *stats,
+		GSS_NEIGHBOURS_LaggingCallback lcb,
+		GSS_NEIGHBOURS_DeadCallback dcb,
+		void *cls)
+{
+	const char *policy;
+	unsigned int i;
+
+	core_api = core;
+	scrb_stats = stats;
+	lagging_cb = lcb;
+	dead_cb = dcb;
+	cb_cls = cls;
+	if (GNUNET_OK != GNUNET_CONFIGURATION_get_value_number (cfg, "scrb",
+			"MAX_QUEUE_LENGTH", &max_queue_length))
+		max_queue_length = DEFAULT_MAX_QUEUE_LENGTH;
+	if (GNUNET_OK != GNUNET_CONFIGURATION_get_value_number (cfg, "scrb",
+			"MAX_QUEUE_DROPS", &max_queue_drops))
+		max_queue_drops = DEFAULT_MAX_QUEUE_DROPS;
+	if (GNUNET_OK != GNUNET_CONFIGURATION_get_value_time (cfg, "scrb",
+			"BATCH_DELAY", &batch_delay))
+		batch_delay = DEFAULT_BATCH_DELAY;
+	if (GNUNET_OK != GNUNET_CONFIGURATION_get_value_size (cfg, "scrb",
+			"BATCH_SIZE", &batch_size))
+		batch_size = DEFAULT_BATCH_SIZE;
+	if (batch_size > GNUNET_SCRB_MULTICAST_BATCH_MAX_SIZE)
+		batch_size = GNUNET_SCRB_MULTICAST_BATCH_MAX_SIZE;
+	drop_policy = DROP_OLDEST;
+	if (GNUNET_OK == GNUNET_CONFIGURATION_get_value_choice (cfg, "scrb",
+			"QUEUE_DROP_POLICY", drop_policies, &policy))
+		for (i = 0; NULL != drop_policies[i]; i++)
+			if (policy == drop_policies[i])
+				drop_policy = (enum DropPolicy) i;
+	if (GNUNET_OK != GNUNET_CONFIGURATION_get_value_time (cfg, "scrb",
+			"HEARTBEAT_INTERVAL", &heartbeat_interval))
+		heartbeat_interval = DEFAULT_HEARTBEAT_INTERVAL;
+	neighbours = GNUNET_CONTAINER_multipeermap_create (256, GNUNET_YES);
+	if (0 != heartbeat_interval.rel_value_us)
+		heartbeat_task = GNUNET_SCHEDULER_add_delayed (heartbeat_interval,
+				&heartbeat_round, NULL);
+}
+
+
+void
+GSS_NEIGHBOURS_done ()
+{
+	if (NULL == neighbours)
+		return;
+	if (GNUNET_SCHEDULER_NO_TASK != heartbeat_task)
+	{
+		GNUNET_SCHEDULER_cancel (heartbeat_task);
+		heartbeat_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	GNUNET_CONTAINER_multipeermap_iterate (neighbours,
+			&cleanup_neighbour,
+			NULL);
+	GNUNET_CONTAINER_multipeermap_destroy (neighbours);
+	neighbours = NULL;
+}
+
+
+struct GSS_Neighbour *
+GSS_NEIGHBOURS_acquire (const struct GNUNET_PeerIdentity *peer)
+{
+	struct GSS_Neighbour *n = get_neighbour (peer);
+
+	n->rc++;
+	if (GNUNET_SCHEDULER_NO_TASK != n->idle_task)
+	{
+		GNUNET_SCHEDULER_cancel (n->idle_task);
+		n->idle_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	return n;
+}
+
+
+void
+GSS_NEIGHBOURS_release (struct GSS_Neighbour *n)
+{
+	GNUNET_assert (0 < n->rc);
+	n->rc--;
+	if (NULL != neighbours)
+		free_if_idle (n);
+}
+
+
+struct GSS_Neighbour *
+GSS_NEIGHBOURS_acquire_edge (const struct GNUNET_PeerIdentity *peer)
+{
+	struct GSS_Neighbour *n = GSS_NEIGHBOURS_acquire (peer);
+
+	/* silence before the link became an edge does not count */
+	if (0 == n->edges++)
+		n->last_heard = GNUNET_TIME_absolute_get ();
+	return n;
+}
+
+
+void
+GSS_NEIGHBOURS_release_edge (struct GSS_Neighbour *n)
+{
+	GNUNET_assert (0 < n->edges);
+	n->edges--;
+	GSS_NEIGHBOURS_release (n);
+}
+
+
+const struct GNUNET_PeerIdentity *
+GSS_NEIGHBOURS_get_peer (const struct GSS_Neighbour *n)
+{
+	return &n->peer;
+}
+
+
+int
+GSS_NEIGHBOURS_bind_handle (struct GSS_Neighbour *n,
+		uint32_t handle,
+		const struct GNUNET_HashCode *group_id)
+{
+	unsigned int new_size;
+
+	if (handle >= GNUNET_SCRB_MAX_GROUP_HANDLE)
+		return GNUNET_SYSERR;
+	if (handle >= n->handles_size)
+	{
+		new_size = GNUNET_MAX (2 * n->handles_size, handle + 1);
+		if (new_size > GNUNET_SCRB_MAX_GROUP_HANDLE)
+			new_size = GNUNET_SCRB_MAX_GROUP_HANDLE;
+		GNUNET_array_grow (n->handles, n->handles_size, new_size);
+	}
+	n->handles[handle] = group_id;
+	return GNUNET_OK;
+}
+
+
+void
+GSS_NEIGHBOURS_unbind_handle (struct GSS_Neighbour *n,
+		uint32_t handle,
+		const struct GNUNET_HashCode *group_id)
+{
+	if ((handle < n->handles_size) && (group_id == n->handles[handle]))
+		n->handles[handle] = NULL;
+}
+
+
+const struct GNUNET_HashCode *
+GSS_NEIGHBOURS_resolve_handle (const struct GNUNET_PeerIdentity *peer,
+		uint32_t handle)
+{
+	struct GSS_Neighbour *n;
+
+	n = GNUNET_CONTAINER_multipeermap_get (neighbours, peer);
+	if ((NULL == n) || (handle >= n->handles_size))
+		return NULL;
+	return n->handles[handle];
+}
+
+
+void
+GSS_NEIGHBOURS_send_frame (const struct GNUNET_PeerIdentity *peer,
+		struct GNUNET_SCRB_Frame *frame)
+{
+	GSS_NEIGHBOURS_send (get_neighbour (peer), frame);
+}
+
+
+void
+GSS_NEIGHBOURS_send (struct GSS_Neighbour *n,
+		struct GNUNET_SCRB_Frame *frame)
+{
+	struct GNUNET_SCRB_Frame *oldest;
+
+	if (GNUNET_SCHEDULER_NO_TASK != n->idle_task)
+	{
+		GNUNET_SCHEDULER_cancel (n->idle_task);
+		n->idle_task = GNUNET_SCHEDULER_NO_TASK;
+	}
+	if (GNUNET_NO == is_multicast (frame))
+	{
+		GNUNET_SCRB_frame_queue_push (&n->queue, frame);
+		transmit_next (n);
+		return;
+	}
+	if (GNUNET_SCHEDULER_NO_TASK != n->disconnect_task)
+		return;
+	if ((0 != max_queue_length) && (n->multicasts >= max_queue_length))
+	{
+		if (DROP_OLDEST != drop_policy)
+		{
+			frame_dropped (n);
+			return;
+		}
+		oldest = GNUNET_SCRB_frame_queue_remove_oldest (&n->queue,
+				&is_multicast);
+		GNUNET_SCRB_frame_unref (oldest);
+		n->multicasts--;
+		frame_dropped (n);
+	}
+	GNUNET_SCRB_frame_queue_push (&n->queue, frame);
+	n->multicasts++;
+	/* a busy link batches on its own, an idle one waits a moment */
+	if (NULL != n->th)
+		return;
+	if ((0 == batch_delay.rel_value_us) || (n->queue.bytes >= batch_size))
+		transmit_next (n);
+	else if (GNUNET_SCHEDULER_NO_TASK == n->flush_task)
+		n->flush_task = GNUNET_SCHEDULER_add_delayed (batch_delay,
+				&flush_batch, n);
+}
+
+
+void
+GSS_NEIGHBOURS_heard (const struct GNUNET_PeerIdentity *peer)
+{
+	struct GSS_Neighbour *n;
+
+	if (NULL == neighbours)
+		return;
+	n = GNUNET_CONTAINER_multipeermap_get (neighbours, peer);
+	if (NULL != n)
+		n->last_heard = GNUNET_TIME_absolute_get ();
+}
+
+
+void
+GSS_NEIGHBOURS_disconnect (const struct GNUNET_PeerIdentity *peer)
+{
+	struct GSS_Neighbour *n;
+
+	if (NULL == neighbours)
+		return;
+	n = GNUNET_CONTAINER_multipeermap_get (neighbours, peer);
+	if (NULL == n)
+		return;
+	/* entries referenced by the service stay, the link reopens on use */
+	reset_link (n);
+	free_if_idle (n);
+}
+
+/* end of gnunet-service-scrb_neighbours.c */
@@ -0,0 +1,211 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/gnunet-service-scrb_neighbours.h
+ * @brief per neighbour transmission queues of the scrb service
+ * @author azhdanov
+ */
+
+#ifndef GNUNET_SERVICE_SCRB_NEIGHBOURS_H
+#define GNUNET_SERVICE_SCRB_NEIGHBOURS_H
+
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include <gnunet/gnunet_core_service.h>
+#include <gnunet/gnunet_statistics_service.h>
+#include "scrb_frame.h"
+
+/**
+ * Link to a remote peer, shared by everything the service sends there
+ */
+struct GSS_Neighbour;
+
+/**
+ * Called when a neighbour which kept dropping frames was disconnected
+ * by the DISCONNECT drop policy.
+ *
+ * @param cls closure
+ * @param peer the lagging neighbour
+ */
+typedef void
+(*GSS_NEIGHBOURS_LaggingCallback) (void *cls,
+		const struct GNUNET_PeerIdentity *peer);
+
+/**
+ * Called when a referenced neighbour missed too many heartbeats, the
+ * link is considered dead although CORE did not report a disconnect.
+ *
+ * @param cls closure
+ * @param peer the silent neighbour
+ */
+typedef void
+(*GSS_NEIGHBOURS_DeadCallback) (void *cls,
+		const struct GNUNET_PeerIdentity *peer);
+
+/**
+ * Initializes the neighbour table.  The queue limit, the drop policy
+ * and the heartbeat interval are read from the "scrb" section of @a cfg.
+ *
+ * @param cfg configuration to use
+ * @param core handle to CORE used to reach the neighbours
+ * @param stats statistics handle
+ * @param lagging_cb called for neighbours cut off by the drop policy
+ * @param dead_cb called for neighbours which fell silent
+ * @param cb_cls closure for @a lagging_cb and @a dead_cb
+ */
+void
+GSS_NEIGHBOURS_init (const struct GNUNET_CONFIGURATION_Handle *cfg,
+		struct GNUNET_CORE_Handle *core,
+		struct GNUNET_STATISTICS_Handle *stats,
+		GSS_NEIGHBOURS_LaggingCallback lagging_cb,
+		GSS_NEIGHBOURS_DeadCallback dead_cb,
+		void *cb_cls);
+
+/**
+ * Drops all queued frames and destroys the neighbour table.
+ */
+void
+GSS_NEIGHBOURS_done (void);
+
+/**
+ * Takes a reference to the link to @a peer, creating it if needed.
+ * The link stays while it is referenced.
+ *
+ * @param peer the remote peer
+ * @return the link
+ */
+struct GSS_Neighbour *
+GSS_NEIGHBOURS_acquire (const struct GNUNET_PeerIdentity *peer);
+
+/**
+ * Releases a reference taken with GSS_NEIGHBOURS_acquire()
+ *
+ * @param n the link
+ */
+void
+GSS_NEIGHBOURS_release (struct GSS_Neighbour *n);
+
+/**
+ * Takes a reference to the link to @a peer for a tree edge, to a
+ * parent or a child.  Only tree edges carry heartbeats and are
+ * checked for liveness.
+ *
+ * @param peer the remote peer
+ * @return the link
+ */
+struct GSS_Neighbour *
+GSS_NEIGHBOURS_acquire_edge (const struct GNUNET_PeerIdentity *peer);
+
+/**
+ * Releases a reference taken with GSS_NEIGHBOURS_acquire_edge()
+ *
+ * @param n the link
+ */
+void
+GSS_NEIGHBOURS_release_edge (struct GSS_Neighbour *n);
+
+/**
+ * Returns the remote peer of a link
+ */
+const struct GNUNET_PeerIdentity *
+GSS_NEIGHBOURS_get_peer (const struct GSS_Neighbour *n);
+
+/**
+ * Queues @a frame for transmission on the link @a n, see
+ * GSS_NEIGHBOURS_send_frame()
+ *
+ * @param n link to send on
+ * @param frame frame to send
+ */
+void
+GSS_NEIGHBOURS_send (struct GSS_Neighbour *n,
+		struct GNUNET_SCRB_Frame *frame);
+
+/**
+ * Queues @a frame for transmission to @a peer.  The neighbour keeps
+ * its own reference until the frame is handed over to CORE, so the
+ * same frame can be queued for any number of neighbours.  Multicast
+ * frames beyond the queue limit of the neighbour are dropped according
+ * to the drop policy, other frames are always queued.
+ *
+ * @param peer receiver of the frame
+ * @param frame frame to send
+ */
+void
+GSS_NEIGHBOURS_send_frame (const struct GNUNET_PeerIdentity *peer,
+		struct GNUNET_SCRB_Frame *frame);
+
+/**
+ * Binds a group handle announced by the neighbour to a group
+ *
+ * @param n link the handle is used on
+ * @param handle handle of the group on the link
+ * @param group_id id of the group, has to stay valid until unbound
+ * @return #GNUNET_OK, #GNUNET_SYSERR if @a handle is out of range
+ */
+int
+GSS_NEIGHBOURS_bind_handle (struct GSS_Neighbour *n,
+		uint32_t handle,
+		const struct GNUNET_HashCode *group_id);
+
+/**
+ * Removes the binding of @a handle unless it was bound again to
+ * another group meanwhile
+ *
+ * @param n link the handle is used on
+ * @param handle handle of the group on the link
+ * @param group_id the group the handle was bound to
+ */
+void
+GSS_NEIGHBOURS_unbind_handle (struct GSS_Neighbour *n,
+		uint32_t handle,
+		const struct GNUNET_HashCode *group_id);
+
+/**
+ * Resolves a group handle used by @a peer
+ *
+ * @param peer the neighbour which sent the handle
+ * @param handle handle of the group on the link
+ * @return id of the group, NULL if @a handle is not bound
+ */
+const struct GNUNET_HashCode *
+GSS_NEIGHBOURS_resolve_handle (const struct GNUNET_PeerIdentity *peer,
+		uint32_t handle);
+
+/**
+ * Notes that @a peer is alive, to be called for every message received
+ * from it
+ *
+ * @param peer the sender
+ */
+void
+GSS_NEIGHBOURS_heard (const struct GNUNET_PeerIdentity *peer);
+
+/**
+ * Drops all frames queued for @a peer and closes the link.  A link
+ * still referenced is opened again when it is used.
+ *
+ * @param peer the peer which went away
+ */
+void
+GSS_NEIGHBOURS_disconnect (const struct GNUNET_PeerIdentity *peer);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+/**
+ * @file scrb/perf_scrb_children.c
+ * @brief measures the cost of joins and leaves as a group grows
+ * @author azhdanov
+ *
+ * Compares walking the child list of a group, as joins and leaves used
+ * to do, with the child index of scrb_group.c.  A join looks up the
+ * joining peer and appends it, a leave looks it up and removes it.
+ */
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include "scrb_group.h"
+
+/**
+ * How many joins and leaves do we measure per group size?
+ */
+#define ITERATIONS 2000
+
+
+static const unsigned int group_sizes[] = { 10, 100, 1000, 10000 };
+
+
+/**
+ * Looks a child up by walking the list
+ */
+static struct GNUNET_SCRB_GroupSubscriber *
+scan_child (const struct GNUNET_SCRB_Group *group,
+		GNUNET_PEER_Id sid)
+{
+	struct GNUNET_SCRB_GroupSubscriber *gs;
+
+	for (gs = group->group_head; NULL != gs; gs = gs->next)
+		if (gs->sid == sid)
+			return gs;
+	return NULL;
+}
+
+
+/**
+ * Creates a child entry with a random identity
+ */
+static struct GNUNET_SCRB_GroupSubscriber *
+random_child ()
+{
+	struct GNUNET_SCRB_GroupSubscriber *gs;
+	struct GNUNET_PeerIdentity pid;
+
+	gs = GNUNET_new (struct GNUNET_SCRB_GroupSubscriber);
+	GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK, &pid, sizeof (pid));
+	gs->sid = GNUNET_PEER_intern (&pid);
+	return gs;
+}
+
+
+/**
+ * Frees a child entry created by random_child()
+ */
+static void
+free_child (struct GNUNET_SCRB_GroupSubscriber *gs)
+{
+	GNUNET_PEER_change_rc (gs->sid, -1);
+	GNUNET_free (gs);
+}
+
+
+/**
+ * Joins and leaves @a fresh children of a group by walking its list
+ *
+ * @return nanoseconds per join and leave
+ */
+static double
+list_join_leave (struct GNUNET_SCRB_Group *group,
+		struct GNUNET_SCRB_GroupSubscriber **fresh)
+{
+	struct GNUNET_TIME_Absolute start;
+	struct GNUNET_SCRB_GroupSubscriber *gs;
+	unsigned int i;
+
+	start = GNUNET_TIME_absolute_get ();
+	for (i = 0; i < ITERATIONS; i++)
+	{
+		if (NULL == scan_child (group, fresh[i]->sid))
+			GNUNET_CONTAINER_DLL_insert_tail (group->group_head,
+					group->group_tail, fresh[i]);
+		gs = scan_child (group, fresh[i]->sid);
+		GNUNET_CONTAINER_DLL_remove (group->group_head, group->group_tail, gs);
+	}
+	return 1000.0 * GNUNET_TIME_absolute_get_duration (start).rel_value_us / ITERATIONS;
+}
+
+
+/**
+ * Joins and leaves @a fresh children of a group through its index
+ *
+ * @return nanoseconds per join and leave
+ */
+static double
+index_join_leave (struct GNUNET_SCRB_Group *group,
+		struct GNUNET_SCRB_GroupSubscriber **fresh)
+{
+	struct GNUNET_TIME_Absolute start;
+	unsigned int i;
+
+	start = GNUNET_TIME_absolute_get ();
+	for (i = 0; i < ITERATIONS; i++)
+	{
+		if (NULL == GNUNET_SCRB_group_find_child (group, fresh[i]->sid))
+			GNUNET_SCRB_group_add_child (group, fresh[i]);
+		GNUNET_SCRB_group_remove_child (group,
+				GNUNET_SCRB_group_find_child (group, fresh[i]->sid));
+	}
+	return 1000.0 * GNUNET_TIME_absolute_get_duration (start).rel_value_us / ITERATIONS;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	struct GNUNET_SCRB_Group group;
+	struct GNUNET_SCRB_GroupSubscriber *fresh[ITERATIONS];
+	struct GNUNET_SCRB_GroupSubscriber *gs;
+	unsigned int i;
+	unsigned int j;
+
+	GNUNET_log_setup ("perf-scrb-children", "WARNING", NULL);
+	for (i = 0; i < ITERATIONS; i++)
+		fresh[i] = random_child ();
+	for (i = 0; i < sizeof (group_sizes) / sizeof (group_sizes[0]); i++)
+	{
+		memset (&group, 0, sizeof (group));
+		GNUNET_SCRB_group_init (&group);
+		for (j = 0; j < group_sizes[i]; j++)
+			GNUNET_SCRB_group_add_child (&group, random_child ());
+		printf ("%5u children: list %10.1f ns, index %6.1f ns per join and leave\n",
+				group_sizes[i],
+				list_join_leave (&group, fresh),
+				index_join_leave (&group, fresh));
+		while (NULL != (gs = group.group_head))
+		{
+			GNUNET_SCRB_group_remove_child (&group, gs);
+			free_child (gs);
+		}
+		GNUNET_SCRB_group_done (&group);
+	}
+	for (i = 0; i < ITERATIONS; i++)
+		free_child (fresh[i]);
+	return 0;
+}
+
+/* end of perf_scrb_children.c */
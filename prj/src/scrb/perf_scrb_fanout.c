@@ -0,0 +1,154 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+/**
+ * @file scrb/perf_scrb_fanout.c
+ * @brief measures the cost of fanning one multicast out to many children
+ * @author azhdanov
+ *
+ * Compares building one envelope per child, which is copied again into
+ * the CORE buffer, with serializing the message once into a shared frame
+ * which every link copies straight into its CORE buffer when it is ready,
+ * as the neighbour queues of the service do.
+ */
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include <gnunet/gnunet_mq_lib.h>
+#include "gnunet_protocols_scrb.h"
+#include "scrb.h"
+#include "scrb_frame.h"
+
+/**
+ * How many messages do we fan out per measurement?
+ */
+#define ITERATIONS 200
+
+
+static const size_t payload_sizes[] = { 64, 1024, 16384, 60000 };
+
+static const unsigned int fanouts[] = { 1, 16, 256, 1024 };
+
+/**
+ * Stands in for the buffer CORE hands to the transmit callbacks
+ */
+static char core_buf[GNUNET_SERVER_MAX_MESSAGE_SIZE];
+
+
+/**
+ * One envelope per child, as receive_multicast used to do, copied into
+ * the CORE buffer when it is sent.
+ *
+ * @return microseconds per message
+ */
+static double
+per_child_envelopes (const char *data, size_t data_size, unsigned int fanout)
+{
+	struct GNUNET_TIME_Absolute start;
+	struct GNUNET_SCRB_UpdateSubscriber *msg;
+	struct GNUNET_MQ_Envelope *ev;
+	struct GNUNET_HashCode group_id;
+	unsigned int i;
+	unsigned int j;
+
+	memset (&group_id, 0, sizeof (group_id));
+	start = GNUNET_TIME_absolute_get ();
+	for (i = 0; i < ITERATIONS; i++)
+		for (j = 0; j < fanout; j++)
+		{
+			ev = GNUNET_MQ_msg_extra (msg, data_size, GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
+			msg->group_id = group_id;
+			msg->last = 0;
+			msg->data.data_size = htonl ((uint32_t) data_size);
+			memcpy (&msg[1], data, data_size);
+			memcpy (core_buf, msg, ntohs (msg->header.size));
+			GNUNET_MQ_discard (ev);
+		}
+	return (double) GNUNET_TIME_absolute_get_duration (start).rel_value_us / ITERATIONS;
+}
+
+
+/**
+ * One shared frame, a reference queued per child and copied into the
+ * CORE buffer by transmit_ready() of each link.
+ *
+ * @return microseconds per message
+ */
+static double
+shared_frame (struct GNUNET_SCRB_FrameQueue *queues,
+		const char *data, size_t data_size, unsigned int fanout)
+{
+	struct GNUNET_TIME_Absolute start;
+	struct GNUNET_SCRB_UpdateSubscriber *msg;
+	struct GNUNET_SCRB_Frame *frame;
+	size_t msg_size = sizeof (struct GNUNET_SCRB_UpdateSubscriber) + data_size;
+	unsigned int i;
+	unsigned int j;
+
+	start = GNUNET_TIME_absolute_get ();
+	for (i = 0; i < ITERATIONS; i++)
+	{
+		frame = GNUNET_SCRB_frame_alloc (msg_size);
+		msg = (struct GNUNET_SCRB_UpdateSubscriber *) GNUNET_SCRB_frame_msg (frame);
+		msg->header.size = htons ((uint16_t) msg_size);
+		msg->header.type = htons (GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
+		memset (&msg->group_id, 0, sizeof (msg->group_id));
+		msg->last = 0;
+		msg->data.data_size = htonl ((uint32_t) data_size);
+		memcpy (&msg[1], data, data_size);
+		for (j = 0; j < fanout; j++)
+			GNUNET_SCRB_frame_queue_push (&queues[j], frame);
+		GNUNET_SCRB_frame_unref (frame);
+		/* the links drain their queues */
+		for (j = 0; j < fanout; j++)
+		{
+			frame = GNUNET_SCRB_frame_queue_pop (&queues[j]);
+			memcpy (core_buf, GNUNET_SCRB_frame_msg (frame), frame->size);
+			GNUNET_SCRB_frame_unref (frame);
+		}
+	}
+	return (double) GNUNET_TIME_absolute_get_duration (start).rel_value_us / ITERATIONS;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	struct GNUNET_SCRB_FrameQueue *queues;
+	unsigned int max_fanout = fanouts[sizeof (fanouts) / sizeof (fanouts[0]) - 1];
+	char *data;
+	unsigned int i;
+	unsigned int j;
+
+	GNUNET_log_setup ("perf-scrb-fanout", "WARNING", NULL);
+	data = GNUNET_malloc (payload_sizes[sizeof (payload_sizes) / sizeof (payload_sizes[0]) - 1]);
+	queues = GNUNET_malloc (max_fanout * sizeof (struct GNUNET_SCRB_FrameQueue));
+	for (i = 0; i < sizeof (payload_sizes) / sizeof (payload_sizes[0]); i++)
+		for (j = 0; j < sizeof (fanouts) / sizeof (fanouts[0]); j++)
+			printf ("%6u bytes to %4u children: per-child envelopes %10.2f us, shared frame %8.2f us\n",
+					(unsigned int) payload_sizes[i], fanouts[j],
+					per_child_envelopes (data, payload_sizes[i], fanouts[j]),
+					shared_frame (queues, data, payload_sizes[i], fanouts[j]));
+	for (j = 0; j < max_fanout; j++)
+		GNUNET_SCRB_frame_queue_clear (&queues[j]);
+	GNUNET_free (queues);
+	GNUNET_free (data);
+	return 0;
+}
+
+/* end of perf_scrb_fanout.c */
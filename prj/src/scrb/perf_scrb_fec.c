@@ -0,0 +1,104 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+/**
+ * @file scrb/perf_scrb_fec.c
+ * @brief measures the throughput of the erasure code kernels
+ * @author azhdanov
+ */
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include "scrb_fec.h"
+
+/**
+ * How many blocks do we code per measurement?
+ */
+#define ITERATIONS 200
+
+/**
+ * Size of a chunk, a maximal multicast split across 8 data stripes
+ */
+#define CHUNK_SIZE 8192
+
+
+static const unsigned int codes[][2] = { { 4, 2 }, { 8, 4 }, { 12, 4 } };
+
+static const char *kernel_names[] = { "scalar", "ssse3", "avx2" };
+
+
+/**
+ * Encodes and decodes blocks with m lost data chunks
+ *
+ * @param encode set to the encoded data rate in MB/s
+ * @param decode set to the decoded data rate in MB/s
+ */
+static void
+measure (unsigned int k, unsigned int m, double *encode, double *decode)
+{
+	struct GNUNET_SCRB_FecCodec *fec = GNUNET_SCRB_fec_create (k, m);
+	struct GNUNET_TIME_Absolute start;
+	uint8_t *chunks[GNUNET_SCRB_FEC_MAX_CHUNKS];
+	int present[GNUNET_SCRB_FEC_MAX_CHUNKS];
+	double bytes = (double) ITERATIONS * k * CHUNK_SIZE;
+	unsigned int i;
+
+	for (i = 0; i < k + m; i++)
+	{
+		chunks[i] = GNUNET_malloc (CHUNK_SIZE);
+		memset (chunks[i], (int) i, CHUNK_SIZE);
+		present[i] = (i < m) ? GNUNET_NO : GNUNET_YES;
+	}
+	start = GNUNET_TIME_absolute_get ();
+	for (i = 0; i < ITERATIONS; i++)
+		GNUNET_SCRB_fec_encode (fec, (const uint8_t *const *) chunks, &chunks[k], CHUNK_SIZE);
+	*encode = bytes / GNUNET_MAX (GNUNET_TIME_absolute_get_duration (start).rel_value_us, 1);
+	start = GNUNET_TIME_absolute_get ();
+	for (i = 0; i < ITERATIONS; i++)
+		GNUNET_SCRB_fec_decode (fec, chunks, present, CHUNK_SIZE);
+	*decode = bytes / GNUNET_MAX (GNUNET_TIME_absolute_get_duration (start).rel_value_us, 1);
+	for (i = 0; i < k + m; i++)
+		GNUNET_free (chunks[i]);
+	GNUNET_SCRB_fec_destroy (fec);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	enum GNUNET_SCRB_FecKernel kernel;
+	double encode;
+	double decode;
+	unsigned int i;
+
+	GNUNET_log_setup ("perf-scrb-fec", "WARNING", NULL);
+	for (kernel = GNUNET_SCRB_FEC_KERNEL_SCALAR; kernel <= GNUNET_SCRB_FEC_KERNEL_AVX2; kernel++)
+	{
+		if (GNUNET_OK != GNUNET_SCRB_fec_select_kernel (kernel))
+			continue;
+		for (i = 0; i < sizeof (codes) / sizeof (codes[0]); i++)
+		{
+			measure (codes[i][0], codes[i][1], &encode, &decode);
+			printf ("%-6s k=%2u m=%u: encode %8.1f MB/s, decode %8.1f MB/s\n",
+					kernel_names[kernel], codes[i][0], codes[i][1], encode, decode);
+		}
+	}
+	return 0;
+}
+
+/* end of perf_scrb_fec.c */
@@ -0,0 +1,156 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+/**
+ * @file scrb/perf_scrb_pool.c
+ * @brief measures the cost of allocating tree entries
+ * @author azhdanov
+ *
+ * Compares GNUNET_new() and GNUNET_free(), as the service used to
+ * allocate its children, with the pools of scrb_pool.c.  A join storm
+ * allocates a burst of children and frees them again, churn frees and
+ * allocates random children of a large live set.
+ */
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include "scrb_group.h"
+#include "scrb_pool.h"
+
+/**
+ * How many entries are live during churn?
+ */
+#define LIVE 100000
+
+/**
+ * How many entries do we replace during churn?
+ */
+#define CHURN 1000000
+
+
+/**
+ * How many joins do all storms of one size add up to?
+ */
+#define STORM_TOTAL 1000000
+
+
+static const unsigned int storm_sizes[] = { 100, 10000, 100000 };
+
+
+/**
+ * Allocates @a n children and frees them again, until #STORM_TOTAL
+ * children were allocated
+ *
+ * @param pool pool to allocate from, NULL for the heap
+ * @return nanoseconds per allocation and free
+ */
+static double
+storm (struct GNUNET_SCRB_Pool *pool, struct GNUNET_SCRB_GroupSubscriber **gs,
+		unsigned int n)
+{
+	struct GNUNET_TIME_Absolute start;
+	unsigned int round;
+	unsigned int i;
+
+	start = GNUNET_TIME_absolute_get ();
+	for (round = 0; round < STORM_TOTAL / n; round++)
+	{
+		for (i = 0; i < n; i++)
+			gs[i] = (NULL == pool)
+					? GNUNET_new (struct GNUNET_SCRB_GroupSubscriber)
+					: GNUNET_SCRB_pool_new (pool, struct GNUNET_SCRB_GroupSubscriber);
+		for (i = 0; i < n; i++)
+			if (NULL == pool)
+				GNUNET_free (gs[i]);
+			else
+				GNUNET_SCRB_pool_free (pool, gs[i]);
+	}
+	return 1000.0 * GNUNET_TIME_absolute_get_duration (start).rel_value_us / STORM_TOTAL;
+}
+
+
+/**
+ * Replaces random children of a set of #LIVE children
+ *
+ * @param pool pool to allocate from, NULL for the heap
+ * @return nanoseconds per allocation and free
+ */
+static double
+churn (struct GNUNET_SCRB_Pool *pool, struct GNUNET_SCRB_GroupSubscriber **gs,
+		const uint32_t *victims)
+{
+	struct GNUNET_TIME_Absolute start;
+	unsigned int i;
+	double ns;
+
+	for (i = 0; i < LIVE; i++)
+		gs[i] = (NULL == pool)
+				? GNUNET_new (struct GNUNET_SCRB_GroupSubscriber)
+				: GNUNET_SCRB_pool_new (pool, struct GNUNET_SCRB_GroupSubscriber);
+	start = GNUNET_TIME_absolute_get ();
+	for (i = 0; i < CHURN; i++)
+	{
+		if (NULL == pool)
+		{
+			GNUNET_free (gs[victims[i]]);
+			gs[victims[i]] = GNUNET_new (struct GNUNET_SCRB_GroupSubscriber);
+		}
+		else
+		{
+			GNUNET_SCRB_pool_free (pool, gs[victims[i]]);
+			gs[victims[i]] = GNUNET_SCRB_pool_new (pool, struct GNUNET_SCRB_GroupSubscriber);
+		}
+	}
+	ns = 1000.0 * GNUNET_TIME_absolute_get_duration (start).rel_value_us / CHURN;
+	for (i = 0; i < LIVE; i++)
+		if (NULL == pool)
+			GNUNET_free (gs[i]);
+		else
+			GNUNET_SCRB_pool_free (pool, gs[i]);
+	return ns;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	struct GNUNET_SCRB_Pool *pool;
+	struct GNUNET_SCRB_GroupSubscriber **gs;
+	uint32_t *victims;
+	unsigned int i;
+
+	GNUNET_log_setup ("perf-scrb-pool", "WARNING", NULL);
+	gs = GNUNET_malloc (LIVE * sizeof (struct GNUNET_SCRB_GroupSubscriber *));
+	victims = GNUNET_malloc (CHURN * sizeof (uint32_t));
+	for (i = 0; i < CHURN; i++)
+		victims[i] = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, LIVE);
+	pool = GNUNET_SCRB_pool_create (sizeof (struct GNUNET_SCRB_GroupSubscriber), 1024);
+	for (i = 0; i < sizeof (storm_sizes) / sizeof (storm_sizes[0]); i++)
+		printf ("storm of %6u joins: heap %6.1f ns, pool %6.1f ns per entry\n",
+				storm_sizes[i],
+				storm (NULL, gs, storm_sizes[i]),
+				storm (pool, gs, storm_sizes[i]));
+	printf ("churn of %u children: heap %6.1f ns, pool %6.1f ns per entry\n",
+			LIVE, churn (NULL, gs, victims), churn (pool, gs, victims));
+	GNUNET_SCRB_pool_destroy (pool);
+	GNUNET_free (victims);
+	GNUNET_free (gs);
+	return 0;
+}
+
+/* end of perf_scrb_pool.c */
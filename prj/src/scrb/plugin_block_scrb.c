@@ -22,6 +22,49 @@
 #include "gnunet/gnunet_hello_lib.h"
 #include "gnunet/gnunet_block_plugin.h"
 #include "gnunet/gnunet_block_lib.h"
+#include "scrb_block_lib.h"
+
+/**
+ * Number of bits we set per entry in the bloomfilter.
+ * Do not change!
+ */
+#define BLOOMFILTER_K 16
+
+
+/**
+ * Checks the size of a scrb block
+ *
+ * @param type block type
+ * @param block the block
+ * @param block_size number of bytes in @a block
+ * @return #GNUNET_OK if the block is well-formed, #GNUNET_NO if not,
+ *         #GNUNET_SYSERR if @a type is no scrb type
+ */
+static int
+check_block (enum GNUNET_BLOCK_Type type,
+             const void *block, size_t block_size)
+{
+  const struct GNUNET_BLOCK_SCRB_Multicast *mc;
+
+  switch ((int) type)
+  {
+  case GNUNET_BLOCK_SCRB_TYPE_CREATE:
+    return (sizeof (struct GNUNET_BLOCK_SCRB_Create) == block_size) ? GNUNET_OK : GNUNET_NO;
+  case GNUNET_BLOCK_SCRB_TYPE_JOIN:
+    return (sizeof (struct GNUNET_BLOCK_SCRB_Join) == block_size) ? GNUNET_OK : GNUNET_NO;
+  case GNUNET_BLOCK_SCRB_TYPE_LEAVE:
+    return (sizeof (struct GNUNET_BLOCK_SCRB_Leave) == block_size) ? GNUNET_OK : GNUNET_NO;
+  case GNUNET_BLOCK_SCRB_TYPE_MULTICAST:
+    if (block_size < sizeof (struct GNUNET_BLOCK_SCRB_Multicast))
+      return GNUNET_NO;
+    mc = block;
+    return (sizeof (struct GNUNET_BLOCK_SCRB_Multicast) +
+            ntohl (mc->data.data_size) == block_size) ? GNUNET_OK : GNUNET_NO;
+  default:
+    return GNUNET_SYSERR;
+  }
+}
+
 
 /**
  * Function called to validate a reply or a request.  For
@@ -46,7 +89,46 @@ block_plugin_scrb_evaluate (void *cls, enum GNUNET_BLOCK_Type type,
                            size_t xquery_size, const void *reply_block,
                            size_t reply_block_size)
 {
-    return GNUNET_BLOCK_EVALUATION_OK_MORE;
+  struct GNUNET_HashCode chash;
+  struct GNUNET_HashCode mhash;
+  int ret;
+
+  if (NULL == reply_block)
+  {
+    /* scrb blocks are only put and monitored, a query is just a key */
+    if (GNUNET_SYSERR == check_block (type, NULL, 0))
+      return GNUNET_BLOCK_EVALUATION_TYPE_NOT_SUPPORTED;
+    if (0 != xquery_size)
+    {
+      GNUNET_break_op (0);
+      return GNUNET_BLOCK_EVALUATION_REQUEST_INVALID;
+    }
+    return GNUNET_BLOCK_EVALUATION_REQUEST_VALID;
+  }
+  ret = check_block (type, reply_block, reply_block_size);
+  if (GNUNET_SYSERR == ret)
+    return GNUNET_BLOCK_EVALUATION_TYPE_NOT_SUPPORTED;
+  if (GNUNET_OK != ret)
+  {
+    GNUNET_break_op (0);
+    return GNUNET_BLOCK_EVALUATION_RESULT_INVALID;
+  }
+  if (NULL != bf)
+  {
+    GNUNET_CRYPTO_hash (reply_block, reply_block_size, &chash);
+    GNUNET_BLOCK_mingle_hash (&chash, bf_mutator, &mhash);
+    if (NULL != *bf)
+    {
+      if (GNUNET_YES == GNUNET_CONTAINER_bloomfilter_test (*bf, &mhash))
+        return GNUNET_BLOCK_EVALUATION_OK_DUPLICATE;
+    }
+    else
+    {
+      *bf = GNUNET_CONTAINER_bloomfilter_init (NULL, 8, BLOOMFILTER_K);
+    }
+    GNUNET_CONTAINER_bloomfilter_add (*bf, &mhash);
+  }
+  return GNUNET_BLOCK_EVALUATION_OK_MORE;
 }
 
 
@@ -58,15 +140,36 @@ block_plugin_scrb_evaluate (void *cls, enum GNUNET_BLOCK_Type type,
  * @param block block to get the key for
  * @param block_size number of bytes @a block
  * @param key set to the key (query) for the given block
- * @return #GNUNET_OK on success, #GNUNET_SYSERR if type not supported
- *         (or if extracting a key from a block of this type does not work)
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if type not supported,
+ *         #GNUNET_NO if extracting a key from a block of this type does not work
  */
 static int
 block_plugin_scrb_get_key (void *cls, enum GNUNET_BLOCK_Type type,
                           const void *block, size_t block_size,
                           struct GNUNET_HashCode * key)
 {
+  int ret;
+
+  ret = check_block (type, block, block_size);
+  if (GNUNET_SYSERR == ret)
+    return GNUNET_SYSERR;
+  if (GNUNET_OK != ret)
+  {
+    GNUNET_break_op (0);
+    return GNUNET_NO;
+  }
+  switch ((int) type)
+  {
+  case GNUNET_BLOCK_SCRB_TYPE_LEAVE:
+    *key = ((const struct GNUNET_BLOCK_SCRB_Leave *) block)->group_id;
+    return GNUNET_OK;
+  case GNUNET_BLOCK_SCRB_TYPE_MULTICAST:
+    *key = ((const struct GNUNET_BLOCK_SCRB_Multicast *) block)->group_id;
     return GNUNET_OK;
+  default:
+    /* CREATE and JOIN name the peer and client, the group is the key */
+    return GNUNET_NO;
+  }
 }
 
 
@@ -78,7 +181,10 @@ libgnunet_plugin_block_scrb_init (void *cls)
 {
   static enum GNUNET_BLOCK_Type types[] =
   {
-    GNUNET_BLOCK_TYPE_DHT_HELLO,
+    GNUNET_BLOCK_SCRB_TYPE_CREATE,
+    GNUNET_BLOCK_SCRB_TYPE_JOIN,
+    GNUNET_BLOCK_SCRB_TYPE_MULTICAST,
+    GNUNET_BLOCK_SCRB_TYPE_LEAVE,
     GNUNET_BLOCK_TYPE_ANY       /* end of list */
   };
   struct GNUNET_BLOCK_PluginFunctions *api;
@@ -103,4 +209,4 @@ libgnunet_plugin_block_scrb_done (void *cls)
   return NULL;
 }
 
-/* end of plugin_block_dht.c */
+/* end of plugin_block_scrb.c */
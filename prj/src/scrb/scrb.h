@@ -27,6 +27,7 @@
 #define SCRB_H
 
 #include "gnunet_scrb_service.h"
+#include "gnunet/gnunet_constants.h"
 #include <stdint.h>
 #include "scrb_publisher.h"
 #include "scrb_subscriber.h"
@@ -112,6 +113,14 @@ struct GNUNET_SCRB_ClientRequestCreate
 	 * group id, hash of client
 	 */
 	struct GNUNET_HashCode group_id;
+	/**
+	 * number of stripes of the group in NBO, 1 for a single tree
+	 */
+	uint32_t stripes;
+	/**
+	 * number of the stripes carrying parity chunks in NBO
+	 */
+	uint32_t parity;
 };
 
 
@@ -139,6 +148,10 @@ struct GNUNET_SCRB_ServiceReplyCreate
 	 * client id
 	 */
 	struct GNUNET_HashCode cid;
+	/**
+	 * id of the created group or stripe
+	 */
+	struct GNUNET_HashCode group_id;
 	/**
 	 * status
 	 */
@@ -200,6 +213,10 @@ struct GNUNET_SCRB_ClntSbscrbRqst
 	struct GNUNET_HashCode group_id;
 
 	struct GNUNET_HashCode client_id;
+	/**
+	 * number of stripes of the group in NBO, 1 for a single tree
+	 */
+	uint32_t stripes;
 };
 
 struct GNUNET_SCRB_UpdateSubscriber
@@ -208,9 +225,70 @@ struct GNUNET_SCRB_UpdateSubscriber
 
 	struct GNUNET_HashCode group_id;
 
+	int last;
+
+	/**
+	 * Sequence number in NBO, counted per group by the service of the
+	 * publisher
+	 */
+	uint32_t seq;
+
+	/**
+	 * Random number the service of the publisher drew when it started,
+	 * in NBO.  Tells the sequence numbers of a restarted publisher
+	 * apart from those before the restart.
+	 */
+	uint32_t epoch;
+
+	/**
+	 * Service of the publisher, set by it
+	 */
+	struct GNUNET_PeerIdentity origin;
+
+	/**
+	 * Number of stripes of the group in NBO, set by the client of the
+	 * publisher, 1 for a single tree
+	 */
+	uint32_t stripes;
+
 	struct GNUNET_SCRB_MulticastData data;
 
+	/* followed by the payload */
+};
+
+/**
+ * Multicast sent down a tree link.  The group is named by the handle
+ * the parent announced in its #GNUNET_SCRB_SendParent2Child.
+ */
+struct GNUNET_SCRB_MulticastDown
+{
+	struct GNUNET_MessageHeader header;
+
+	/**
+	 * Handle of the group on the link in NBO
+	 */
+	uint32_t handle;
+
 	int last;
+
+	/**
+	 * Sequence number in NBO, see #GNUNET_SCRB_UpdateSubscriber
+	 */
+	uint32_t seq;
+
+	/**
+	 * Epoch of the publisher in NBO, see #GNUNET_SCRB_UpdateSubscriber
+	 */
+	uint32_t epoch;
+
+	/**
+	 * Service of the publisher
+	 */
+	struct GNUNET_PeerIdentity origin;
+
+	struct GNUNET_SCRB_MulticastData data;
+
+	/* followed by the payload */
 };
 
 struct GNUNET_SCRB_ClntRqstLv
@@ -252,6 +330,12 @@ struct GNUNET_SCRB_SendParent2Child
 	struct GNUNET_PeerIdentity parent;
 
 	struct GNUNET_HashCode cid;
+
+	/**
+	 * Handle the parent names the group with on this link in NBO,
+	 * #GNUNET_SCRB_NO_GROUP_HANDLE if it sends full group ids
+	 */
+	uint32_t handle;
 };
 
 struct GNUNET_SCRB_SendLeaveToParent
@@ -261,12 +345,119 @@ struct GNUNET_SCRB_SendLeaveToParent
 	 * group id
 	 */
 	struct GNUNET_HashCode group_id;
+	/**
+	 * Service which leaves
+	 */
+	struct GNUNET_PeerIdentity sid;
+};
+
+
+/**
+ * Sent by a parent without spare capacity to one of its children of
+ * the group, asking it to adopt the joining peer instead
+ */
+struct GNUNET_SCRB_PushDownJoin
+{
+	struct GNUNET_MessageHeader header;
+	/**
+	 * group id
+	 */
+	struct GNUNET_HashCode group_id;
+	/**
+	 * the joining peer
+	 */
+	struct GNUNET_PeerIdentity child;
+	/**
+	 * originator of the join
+	 */
+	struct GNUNET_PeerIdentity oid;
+	/**
+	 * client id
+	 */
+	struct GNUNET_HashCode cid;
+	/**
+	 * number of further push downs allowed, in NBO
+	 */
+	uint32_t ttl;
+	/**
+	 * number of stripes of the group if the tree is a stripe, 0
+	 * otherwise, in NBO
+	 */
+	uint32_t stripes;
+};
+
+/**
+ * Anycast walking the tree of the spare capacity group depth-first
+ * until it reaches a peer which can adopt the joining peer
+ */
+struct GNUNET_SCRB_SpareAnycast
+{
+	struct GNUNET_MessageHeader header;
+	/**
+	 * group the joining peer needs a parent for
+	 */
+	struct GNUNET_HashCode group_id;
+	/**
+	 * the joining peer
+	 */
+	struct GNUNET_PeerIdentity child;
+	/**
+	 * originator of the join
+	 */
+	struct GNUNET_PeerIdentity oid;
 	/**
 	 * client id
 	 */
-	struct GNUNET_HashCode sid;
+	struct GNUNET_HashCode cid;
+	/**
+	 * number of visited peers in NBO
+	 */
+	uint32_t visited;
+	/**
+	 * number of hops the anycast took so far in NBO
+	 */
+	uint32_t hops;
+	/**
+	 * number of stripes of the group if the tree is a stripe, 0
+	 * otherwise, in NBO
+	 */
+	uint32_t stripes;
+	/* followed by the visited peers, each once */
+};
+
+/**
+ * A list of groups.  As LEASE_RENEW it renews the leases of the tree
+ * edges to the sender, as LEAVE_BATCH the sender leaves the groups as a
+ * child of the receiver.
+ */
+struct GNUNET_SCRB_GroupList
+{
+	struct GNUNET_MessageHeader header;
+	/**
+	 * number of group ids in NBO
+	 */
+	uint32_t count;
+	/* followed by the group ids */
 };
 
+/**
+ * Sent by the root of a tree to a publisher which routed a multicast
+ * through the DHT, and by a former root to a publisher which still
+ * sends to it
+ */
+struct GNUNET_SCRB_RootAnnounce
+{
+	struct GNUNET_MessageHeader header;
+	/**
+	 * id of the group or stripe
+	 */
+	struct GNUNET_HashCode group_id;
+	/**
+	 * #GNUNET_YES if the sender is the root of the tree, #GNUNET_NO if
+	 * it is not any more, in NBO
+	 */
+	uint32_t status;
+};
 
 GNUNET_NETWORK_STRUCT_END
 #endif
@@ -29,6 +29,7 @@
 #include <gnunet/gnunet_mq_lib.h>
 #include "handle.h"
 #include "scrb.h"
+#include "scrb_stripe.h"
 #include "gnunet_protocols_scrb.h"
 
 /**
@@ -67,7 +68,15 @@ static void
 receive_publisher_update (void *cls, const struct GNUNET_MessageHeader *msg)
 {
 	struct GNUNET_SCRB_UpdateSubscriber* up = (struct GNUNET_SCRB_UpdateSubscriber*)msg;
-	fprintf(stderr, "%.1024s", up->data.data);
+	uint16_t msize = ntohs(msg->size);
+
+	if ((msize < sizeof(struct GNUNET_SCRB_UpdateSubscriber)) ||
+			(msize != sizeof(struct GNUNET_SCRB_UpdateSubscriber) + ntohl(up->data.data_size)))
+	{
+		GNUNET_break(0);
+		return;
+	}
+	fprintf(stderr, "%.*s", (int) ntohl(up->data.data_size), (const char*) &up[1]);
 }
 
 /**
@@ -79,7 +88,8 @@ receive_service_list_reply (void *cls, const struct GNUNET_MessageHeader *msg)
 	struct GNUNET_SCRB_Handle* eh = cls;
 
 	struct GNUNET_SCRB_SrvcRplySrvcLst* rim = (struct GNUNET_SCRB_SrvcRplySrvcLst*)msg;
-	struct GNUNET_SCRB_ServicePublisher *pub = &rim->pub;
+	struct GNUNET_SCRB_ServicePublisher *pub = GNUNET_new(struct GNUNET_SCRB_ServicePublisher);
+	*pub = rim->pub;
 	GNUNET_CONTAINER_multihashmap_put(services,
 			&pub->group_id,
 			pub,
@@ -88,7 +98,8 @@ receive_service_list_reply (void *cls, const struct GNUNET_MessageHeader *msg)
 	if(GNUNET_CONTAINER_multihashmap_size(services) == rim->size)
 	{
 		group_id = rim->pub.group_id;
-		GNUNET_SCRB_subscribe(eh, &group_id, &my_identity_hash, NULL, NULL);
+		GNUNET_SCRB_subscribe_striped(eh, &group_id, &my_identity_hash,
+				GNUNET_MAX(ntohl(rim->pub.stripes), 1), NULL, NULL);
 	}
 }
 
@@ -237,6 +248,23 @@ void GNUNET_SCRB_request_create(
 		void (*cb)(),
 		void *cb_cls)
 {
+	GNUNET_SCRB_request_create_striped(eh, group_id, 1, 0, cb, cb_cls);
+}
+
+/**
+ * Request create group with @a stripes stripe trees from the service,
+ * @a parity of them carry parity chunks
+ */
+void GNUNET_SCRB_request_create_striped(
+		struct GNUNET_SCRB_Handle *eh,
+		const struct GNUNET_HashCode* group_id,
+		unsigned int stripes,
+		unsigned int parity,
+		void (*cb)(),
+		void *cb_cls)
+{
+	GNUNET_assert ((stripes > 0) && (stripes <= GNUNET_SCRB_MAX_STRIPES));
+	GNUNET_assert ((0 == parity) || (parity < stripes));
 	eh->cb = cb;
 	eh->cb_cls = cb_cls;
 
@@ -249,6 +277,8 @@ void GNUNET_SCRB_request_create(
 	msg->header.size = htons((uint16_t) msg_size);
 	msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_CREATE_REQUEST);
 	msg->group_id = *group_id;
+	msg->stripes = htonl((uint32_t) stripes);
+	msg->parity = htonl((uint32_t) parity);
 
 	GNUNET_MQ_send (eh->mq, ev);
 }
@@ -263,6 +293,21 @@ void GNUNET_SCRB_subscribe(
 		void (*cb)(),
 		void *cb_cls)
 {
+	GNUNET_SCRB_subscribe_striped(eh, group_id, cid, 1, cb, cb_cls);
+}
+
+/**
+ * Request subscription to all @a stripes stripes of a group
+ */
+void GNUNET_SCRB_subscribe_striped(
+		struct GNUNET_SCRB_Handle *eh,
+		const struct GNUNET_HashCode* group_id,
+		const struct GNUNET_HashCode* cid,
+		unsigned int stripes,
+		void (*cb)(),
+		void *cb_cls)
+{
+	GNUNET_assert ((stripes > 0) && (stripes <= GNUNET_SCRB_MAX_STRIPES));
 	eh->cb = cb;
 	eh->cb_cls = cb_cls;
 
@@ -276,29 +321,60 @@ void GNUNET_SCRB_subscribe(
 	msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_SUBSCRIBE_REQUEST);
 	msg->group_id = *group_id;
 	msg->client_id = *cid;
+	msg->stripes = htonl((uint32_t) stripes);
 
 	GNUNET_MQ_send (eh->mq, ev);
 }
 
-void GNUNET_SCRB_request_multicast(
+/**
+ * Request multicast of @a data_size bytes of @a data to the group
+ */
+int GNUNET_SCRB_request_multicast(
 		struct GNUNET_SCRB_Handle *eh,
 		const struct GNUNET_HashCode* group_id,
-		const struct GNUNET_SCRB_MulticastData* data,
+		const void* data,
+		size_t data_size,
 		void (*cb)(),
 		void* cb_cls)
 {
+	return GNUNET_SCRB_request_multicast_striped(eh, group_id, 1, data,
+			data_size, cb, cb_cls);
+}
+
+/**
+ * Request multicast of @a data_size bytes of @a data to a group with
+ * @a stripes stripes
+ */
+int GNUNET_SCRB_request_multicast_striped(
+		struct GNUNET_SCRB_Handle *eh,
+		const struct GNUNET_HashCode* group_id,
+		unsigned int stripes,
+		const void* data,
+		size_t data_size,
+		void (*cb)(),
+		void* cb_cls)
+{
+	GNUNET_assert ((stripes > 0) && (stripes <= GNUNET_SCRB_MAX_STRIPES));
+	if (data_size > GNUNET_SCRB_MULTICAST_MAX_PAYLOAD)
+	{
+		GNUNET_break(0);
+		return GNUNET_SYSERR;
+	}
 	eh->cb = cb;
 	eh->cb_cls = cb_cls;
 	struct GNUNET_SCRB_UpdateSubscriber* msg;
-	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg(msg, GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
+	struct GNUNET_MQ_Envelope* ev = GNUNET_MQ_msg_extra(msg, data_size, GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
 
-	size_t msg_size = sizeof(struct GNUNET_SCRB_UpdateSubscriber);
+	size_t msg_size = sizeof(struct GNUNET_SCRB_UpdateSubscriber) + data_size;
 	msg->header.size = htons((uint16_t) msg_size);
 	msg->header.type = htons(GNUNET_MESSAGE_TYPE_SCRB_MULTICAST);
 	msg->group_id = *group_id;
-	memcpy(&msg->data, data, sizeof(struct GNUNET_SCRB_MulticastData));
+	msg->stripes = htonl((uint32_t) stripes);
+	msg->data.data_size = htonl((uint32_t) data_size);
+	memcpy(&msg[1], data, data_size);
 
 	GNUNET_MQ_send (eh->mq, ev);
+	return GNUNET_OK;
 }
 
 
@@ -380,9 +456,9 @@ static void
 multicast_task (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
 	struct GNUNET_SCRB_Handle* eh = cls;
-	struct GNUNET_SCRB_MulticastData msg;
+	const char* msg = GNUNET_h2s(&my_identity_hash);
 
-	GNUNET_SCRB_request_multicast(eh, &my_identity_hash, &msg, NULL, NULL);
+	GNUNET_SCRB_request_multicast(eh, &my_identity_hash, msg, strlen(msg), NULL, NULL);
 
 	GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_MINUTES, &multicast_task,
 			eh);
@@ -36,6 +36,17 @@ enum GNUNET_BLOCK_SCRB_Type
 
 };
 
+/**
+ * How long do the DHT peers keep CREATE, JOIN and LEAVE blocks?  They
+ * only matter while they are routed to the root.
+ */
+#define GNUNET_BLOCK_SCRB_CONTROL_EXPIRATION GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 5)
+
+/**
+ * How long do the DHT peers keep MULTICAST blocks?
+ */
+#define GNUNET_BLOCK_SCRB_MULTICAST_EXPIRATION GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 30)
+
 GNUNET_NETWORK_STRUCT_BEGIN
 
 struct GNUNET_BLOCK_SCRB_Create{
@@ -58,14 +69,19 @@ struct GNUNET_BLOCK_SCRB_Join{
 	 * Client id
 	 */
 	struct GNUNET_HashCode cid;
+	/**
+	 * Number of stripes of the group if the tree is a stripe, 0
+	 * otherwise, in NBO
+	 */
+	uint32_t stripes GNUNET_PACKED;
 };
 
 struct GNUNET_BLOCK_SCRB_Leave{
 
 	/**
-	 * Client id
+	 * Service which leaves
 	 */
-	struct GNUNET_HashCode sid;
+	struct GNUNET_PeerIdentity sid;
 
 	/**
 	 * Group id
@@ -78,9 +94,26 @@ struct GNUNET_BLOCK_SCRB_Multicast{
 
 	struct GNUNET_HashCode group_id;
 
+	int last;
+
+	/**
+	 * Sequence number of the multicast in NBO
+	 */
+	uint32_t seq;
+
+	/**
+	 * Epoch of the publisher in NBO, see #GNUNET_SCRB_UpdateSubscriber
+	 */
+	uint32_t epoch;
+
+	/**
+	 * Service of the publisher
+	 */
+	struct GNUNET_PeerIdentity origin;
+
 	struct GNUNET_SCRB_MulticastData data;
 
-	int last;
+	/* followed by the payload */
 };
 
 GNUNET_NETWORK_STRUCT_END
@@ -0,0 +1,123 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_dedup.c
+ * @brief sliding window of the multicast sequence numbers seen
+ * @author azhdanov
+ */
+#include "scrb_dedup.h"
+
+#define WORDS (GNUNET_SCRB_DEDUP_WINDOW / 64)
+
+
+/**
+ * Moves the window up by @a shift sequence numbers
+ *
+ * @param win the window
+ * @param shift number of positions, less than the window size
+ */
+static void
+shift_window (struct GNUNET_SCRB_DedupWindow *win, unsigned int shift)
+{
+	unsigned int words = shift / 64;
+	unsigned int bits = shift % 64;
+	int i;
+
+	for (i = WORDS - 1; i >= 0; i--)
+	{
+		uint64_t w = 0;
+
+		if (i >= (int) words)
+		{
+			w = win->seen[i - words] << bits;
+			if ((0 != bits) && (i > (int) words))
+				w |= win->seen[i - words - 1] >> (64 - bits);
+		}
+		win->seen[i] = w;
+	}
+}
+
+
+/**
+ * Starts the window over at @a seq
+ */
+static void
+restart_window (struct GNUNET_SCRB_DedupWindow *win, uint32_t seq)
+{
+	memset (win->seen, 0, sizeof (win->seen));
+	win->seen[0] = 1;
+	win->highest = seq;
+	win->started = GNUNET_YES;
+}
+
+
+void
+GNUNET_SCRB_dedup_key (const struct GNUNET_HashCode *group_id,
+		const struct GNUNET_PeerIdentity *origin,
+		uint32_t epoch,
+		struct GNUNET_HashCode *key)
+{
+	const unsigned char *o = (const unsigned char *) origin;
+	const unsigned char *e = (const unsigned char *) &epoch;
+	unsigned char *k = (unsigned char *) key;
+	unsigned int i;
+
+	/* group ids are hashes, mixing in the public key of the publisher
+	 * and the epoch keeps the keys apart without hashing every multicast */
+	*key = *group_id;
+	for (i = 0; i < sizeof (struct GNUNET_PeerIdentity); i++)
+		k[i] ^= o[i];
+	for (i = 0; i < sizeof (epoch); i++)
+		k[sizeof (struct GNUNET_PeerIdentity) + i] ^= e[i];
+}
+
+
+int
+GNUNET_SCRB_dedup_check (struct GNUNET_SCRB_DedupWindow *win,
+		uint32_t seq)
+{
+	int32_t diff = (int32_t) (seq - win->highest);
+	unsigned int off;
+
+	if ((GNUNET_YES != win->started) ||
+			(diff >= GNUNET_SCRB_DEDUP_WINDOW))
+	{
+		restart_window (win, seq);
+		return GNUNET_NO;
+	}
+	/* a replay from the past must not rewind the window */
+	if (diff <= -GNUNET_SCRB_DEDUP_WINDOW)
+		return GNUNET_YES;
+	if (diff > 0)
+	{
+		shift_window (win, (unsigned int) diff);
+		win->seen[0] |= 1;
+		win->highest = seq;
+		return GNUNET_NO;
+	}
+	off = (unsigned int) -diff;
+	if (0 != (win->seen[off / 64] & ((uint64_t) 1 << (off % 64))))
+		return GNUNET_YES;
+	win->seen[off / 64] |= (uint64_t) 1 << (off % 64);
+	return GNUNET_NO;
+}
+
+/* end of scrb_dedup.c */
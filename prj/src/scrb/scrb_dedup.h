@@ -0,0 +1,91 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_dedup.h
+ * @brief sliding window of the multicast sequence numbers seen
+ * @author azhdanov
+ */
+
+#ifndef SCRB_DEDUP_H_
+#define SCRB_DEDUP_H_
+
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+
+/**
+ * Number of sequence numbers below the highest one a window remembers
+ */
+#define GNUNET_SCRB_DEDUP_WINDOW 256
+
+/**
+ * Sequence numbers of the multicasts of one publisher in one group
+ * which were already seen.  Sequence numbers compare in serial number
+ * arithmetic, so they may wrap around.
+ */
+struct GNUNET_SCRB_DedupWindow
+{
+	/**
+	 * Bit i is set if sequence number @e highest - i was seen
+	 */
+	uint64_t seen[GNUNET_SCRB_DEDUP_WINDOW / 64];
+
+	/**
+	 * Highest sequence number seen
+	 */
+	uint32_t highest;
+
+	/**
+	 * #GNUNET_YES once the first sequence number was seen
+	 */
+	int started;
+};
+
+/**
+ * Computes the key of the window of a publisher in a group.  A
+ * publisher draws a new epoch when it restarts, so its new sequence
+ * numbers get a new window whatever they are.
+ *
+ * @param group_id the group
+ * @param origin the publisher
+ * @param epoch epoch of the publisher
+ * @param key set to the key of the window
+ */
+void
+GNUNET_SCRB_dedup_key (const struct GNUNET_HashCode *group_id,
+		const struct GNUNET_PeerIdentity *origin,
+		uint32_t epoch,
+		struct GNUNET_HashCode *key);
+
+/**
+ * Records @a seq in the window.  A sequence number more than the window
+ * below the highest one is too old to tell and counts as seen, one more
+ * than the window above it restarts the window.
+ *
+ * @param win the window
+ * @param seq sequence number of a received multicast
+ * @return #GNUNET_YES if @a seq was seen before or is too old,
+ *         #GNUNET_NO if not
+ */
+int
+GNUNET_SCRB_dedup_check (struct GNUNET_SCRB_DedupWindow *win,
+		uint32_t seq);
+
+#endif /* SCRB_DEDUP_H_ */
@@ -0,0 +1,443 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_fec.c
+ * @brief systematic Cauchy Reed-Solomon erasure code over GF(2^8)
+ * @author azhdanov
+ *
+ * The parity rows of the generator matrix form a Cauchy matrix, so
+ * every square submatrix of the identity stacked on it is invertible
+ * and any k chunks rebuild the block.  All work is done by one kernel
+ * which adds a constant multiple of a chunk to another one.  The SIMD
+ * kernels split every byte into two nibbles and look up both products
+ * with a byte shuffle.
+ */
+#include "scrb_fec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/**
+ * Reduction polynomial of the field, x^8 + x^4 + x^3 + x^2 + 1
+ */
+#define GF_POLYNOMIAL 0x11d
+
+struct GNUNET_SCRB_FecCodec
+{
+	/**
+	 * Number of data chunks
+	 */
+	unsigned int k;
+
+	/**
+	 * Number of parity chunks
+	 */
+	unsigned int m;
+
+	/**
+	 * Parity rows of the generator matrix, m rows of k coefficients
+	 */
+	uint8_t *matrix;
+};
+
+/**
+ * Adds @a c times @a src to @a dst
+ */
+typedef void
+(*MulAddKernel) (uint8_t *dst, const uint8_t *src, uint8_t c, size_t len);
+
+/**
+ * Antilogarithms, doubled so that sums of two logarithms need no reduction
+ */
+static uint8_t gf_exp[510];
+
+/**
+ * Logarithms, gf_log[0] is unused
+ */
+static uint8_t gf_log[256];
+
+/**
+ * Full multiplication table
+ */
+static uint8_t gf_mul[256][256];
+
+/**
+ * Products of every coefficient with the low nibbles
+ */
+static uint8_t gf_mul_lo[256][16] __attribute__ ((aligned (16)));
+
+/**
+ * Products of every coefficient with the high nibbles
+ */
+static uint8_t gf_mul_hi[256][16] __attribute__ ((aligned (16)));
+
+/**
+ * Were the tables computed?
+ */
+static int initialized;
+
+/**
+ * Kernel in use
+ */
+static enum GNUNET_SCRB_FecKernel kernel;
+
+/**
+ * Function of the kernel in use
+ */
+static MulAddKernel mul_add;
+
+
+static void
+mul_add_scalar (uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+	const uint8_t *t = gf_mul[c];
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] ^= t[src[i]];
+}
+
+
+#ifdef HAVE_X86_KERNELS
+__attribute__ ((target ("ssse3")))
+static void
+mul_add_ssse3 (uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+	const __m128i lo = _mm_load_si128 ((const __m128i *) gf_mul_lo[c]);
+	const __m128i hi = _mm_load_si128 ((const __m128i *) gf_mul_hi[c]);
+	const __m128i mask = _mm_set1_epi8 (0x0f);
+	__m128i s;
+	__m128i p;
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16)
+	{
+		s = _mm_loadu_si128 ((const __m128i *) &src[i]);
+		p = _mm_xor_si128 (_mm_shuffle_epi8 (lo, _mm_and_si128 (s, mask)),
+				_mm_shuffle_epi8 (hi, _mm_and_si128 (_mm_srli_epi64 (s, 4), mask)));
+		_mm_storeu_si128 ((__m128i *) &dst[i],
+				_mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) &dst[i]), p));
+	}
+	mul_add_scalar (&dst[i], &src[i], c, len - i);
+}
+
+
+__attribute__ ((target ("avx2")))
+static void
+mul_add_avx2 (uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+	const __m256i lo = _mm256_broadcastsi128_si256 (
+			_mm_load_si128 ((const __m128i *) gf_mul_lo[c]));
+	const __m256i hi = _mm256_broadcastsi128_si256 (
+			_mm_load_si128 ((const __m128i *) gf_mul_hi[c]));
+	const __m256i mask = _mm256_set1_epi8 (0x0f);
+	__m256i s;
+	__m256i p;
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32)
+	{
+		s = _mm256_loadu_si256 ((const __m256i *) &src[i]);
+		p = _mm256_xor_si256 (_mm256_shuffle_epi8 (lo, _mm256_and_si256 (s, mask)),
+				_mm256_shuffle_epi8 (hi, _mm256_and_si256 (_mm256_srli_epi64 (s, 4), mask)));
+		_mm256_storeu_si256 ((__m256i *) &dst[i],
+				_mm256_xor_si256 (_mm256_loadu_si256 ((const __m256i *) &dst[i]), p));
+	}
+	mul_add_scalar (&dst[i], &src[i], c, len - i);
+}
+#endif
+
+
+/**
+ * Computes the tables and selects the fastest kernel
+ */
+static void
+gf_init ()
+{
+	unsigned int i;
+	unsigned int j;
+	unsigned int x;
+
+	if (initialized)
+		return;
+	x = 1;
+	for (i = 0; i < 255; i++)
+	{
+		gf_exp[i] = (uint8_t) x;
+		gf_exp[i + 255] = (uint8_t) x;
+		gf_log[x] = (uint8_t) i;
+		x <<= 1;
+		if (x & 0x100)
+			x ^= GF_POLYNOMIAL;
+	}
+	for (i = 1; i < 256; i++)
+		for (j = 1; j < 256; j++)
+			gf_mul[i][j] = gf_exp[gf_log[i] + gf_log[j]];
+	for (i = 0; i < 256; i++)
+		for (j = 0; j < 16; j++)
+		{
+			gf_mul_lo[i][j] = gf_mul[i][j];
+			gf_mul_hi[i][j] = gf_mul[i][j << 4];
+		}
+	initialized = 1;
+	kernel = GNUNET_SCRB_FEC_KERNEL_SCALAR;
+	mul_add = &mul_add_scalar;
+	if (GNUNET_OK != GNUNET_SCRB_fec_select_kernel (GNUNET_SCRB_FEC_KERNEL_AVX2))
+		(void) GNUNET_SCRB_fec_select_kernel (GNUNET_SCRB_FEC_KERNEL_SSSE3);
+}
+
+
+/**
+ * Multiplicative inverse of a non-zero element
+ */
+static uint8_t
+gf_inv (uint8_t a)
+{
+	return gf_exp[255 - gf_log[a]];
+}
+
+
+/**
+ * Adds @a c times @a src to @a dst, handles the trivial coefficients
+ */
+static void
+chunk_mul_add (uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+	size_t i;
+
+	if (0 == c)
+		return;
+	if (1 == c)
+	{
+		for (i = 0; i < len; i++)
+			dst[i] ^= src[i];
+		return;
+	}
+	mul_add (dst, src, c, len);
+}
+
+
+int
+GNUNET_SCRB_fec_select_kernel (enum GNUNET_SCRB_FecKernel k)
+{
+	gf_init ();
+	switch (k)
+	{
+	case GNUNET_SCRB_FEC_KERNEL_SCALAR:
+		mul_add = &mul_add_scalar;
+		break;
+#ifdef HAVE_X86_KERNELS
+	case GNUNET_SCRB_FEC_KERNEL_SSSE3:
+		if (! __builtin_cpu_supports ("ssse3"))
+			return GNUNET_NO;
+		mul_add = &mul_add_ssse3;
+		break;
+	case GNUNET_SCRB_FEC_KERNEL_AVX2:
+		if (! __builtin_cpu_supports ("avx2"))
+			return GNUNET_NO;
+		mul_add = &mul_add_avx2;
+		break;
+#endif
+	default:
+		return GNUNET_NO;
+	}
+	kernel = k;
+	return GNUNET_OK;
+}
+
+
+enum GNUNET_SCRB_FecKernel
+GNUNET_SCRB_fec_get_kernel ()
+{
+	gf_init ();
+	return kernel;
+}
+
+
+struct GNUNET_SCRB_FecCodec *
+GNUNET_SCRB_fec_create (unsigned int k,
+		unsigned int m)
+{
+	struct GNUNET_SCRB_FecCodec *fec;
+	unsigned int i;
+	unsigned int j;
+
+	if ((0 == k) || (k + m > GNUNET_SCRB_FEC_MAX_CHUNKS))
+		return NULL;
+	gf_init ();
+	fec = GNUNET_new (struct GNUNET_SCRB_FecCodec);
+	fec->k = k;
+	fec->m = m;
+	fec->matrix = GNUNET_malloc (GNUNET_MAX (m * k, 1));
+	/* x_i = k + i and y_j = j are distinct, so x_i + y_j is never 0 */
+	for (i = 0; i < m; i++)
+		for (j = 0; j < k; j++)
+			fec->matrix[i * k + j] = gf_inv ((uint8_t) ((k + i) ^ j));
+	return fec;
+}
+
+
+void
+GNUNET_SCRB_fec_destroy (struct GNUNET_SCRB_FecCodec *fec)
+{
+	GNUNET_free (fec->matrix);
+	GNUNET_free (fec);
+}
+
+
+unsigned int
+GNUNET_SCRB_fec_data_chunks (const struct GNUNET_SCRB_FecCodec *fec)
+{
+	return fec->k;
+}
+
+
+unsigned int
+GNUNET_SCRB_fec_parity_chunks (const struct GNUNET_SCRB_FecCodec *fec)
+{
+	return fec->m;
+}
+
+
+void
+GNUNET_SCRB_fec_encode (const struct GNUNET_SCRB_FecCodec *fec,
+		const uint8_t *const *data,
+		uint8_t *const *parity,
+		size_t len)
+{
+	unsigned int i;
+	unsigned int j;
+
+	for (i = 0; i < fec->m; i++)
+	{
+		memset (parity[i], 0, len);
+		for (j = 0; j < fec->k; j++)
+			chunk_mul_add (parity[i], data[j], fec->matrix[i * fec->k + j], len);
+	}
+}
+
+
+/**
+ * Inverts the @a n x @a n matrix @a a into @a inv by Gauss-Jordan
+ * elimination, @a a is destroyed
+ *
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if @a a is singular
+ */
+static int
+invert_matrix (uint8_t *a, uint8_t *inv, unsigned int n)
+{
+	unsigned int row;
+	unsigned int col;
+	unsigned int r;
+	unsigned int c;
+	uint8_t f;
+	uint8_t t;
+
+	memset (inv, 0, n * n);
+	for (r = 0; r < n; r++)
+		inv[r * n + r] = 1;
+	for (col = 0; col < n; col++)
+	{
+		for (row = col; row < n; row++)
+			if (0 != a[row * n + col])
+				break;
+		if (row == n)
+			return GNUNET_SYSERR;
+		if (row != col)
+			for (c = 0; c < n; c++)
+			{
+				t = a[row * n + c]; a[row * n + c] = a[col * n + c]; a[col * n + c] = t;
+				t = inv[row * n + c]; inv[row * n + c] = inv[col * n + c]; inv[col * n + c] = t;
+			}
+		f = gf_inv (a[col * n + col]);
+		for (c = 0; c < n; c++)
+		{
+			a[col * n + c] = gf_mul[f][a[col * n + c]];
+			inv[col * n + c] = gf_mul[f][inv[col * n + c]];
+		}
+		for (r = 0; r < n; r++)
+		{
+			if ((r == col) || (0 == (f = a[r * n + col])))
+				continue;
+			for (c = 0; c < n; c++)
+			{
+				a[r * n + c] ^= gf_mul[f][a[col * n + c]];
+				inv[r * n + c] ^= gf_mul[f][inv[col * n + c]];
+			}
+		}
+	}
+	return GNUNET_OK;
+}
+
+
+int
+GNUNET_SCRB_fec_decode (const struct GNUNET_SCRB_FecCodec *fec,
+		uint8_t *const *chunks,
+		const int *present,
+		size_t len)
+{
+	unsigned int k = fec->k;
+	unsigned int rows[GNUNET_SCRB_FEC_MAX_CHUNKS];
+	unsigned int n;
+	unsigned int i;
+	unsigned int j;
+	uint8_t *a;
+	uint8_t *inv;
+	int ret;
+
+	/* prefer data chunks, their rows are trivial */
+	n = 0;
+	for (i = 0; (i < k + fec->m) && (n < k); i++)
+		if (GNUNET_YES == present[i])
+			rows[n++] = i;
+	if (n < k)
+		return GNUNET_SYSERR;
+	if (rows[k - 1] < k)
+		return GNUNET_OK; /* nothing is missing */
+
+	a = GNUNET_malloc (2 * k * k);
+	inv = &a[k * k];
+	for (i = 0; i < k; i++)
+	{
+		if (rows[i] < k)
+			a[i * k + rows[i]] = 1;
+		else
+			memcpy (&a[i * k], &fec->matrix[(rows[i] - k) * k], k);
+	}
+	ret = invert_matrix (a, inv, k);
+	if (GNUNET_OK == ret)
+	{
+		for (j = 0; j < k; j++)
+		{
+			if (GNUNET_YES == present[j])
+				continue;
+			memset (chunks[j], 0, len);
+			for (i = 0; i < k; i++)
+				chunk_mul_add (chunks[j], chunks[rows[i]], inv[j * k + i], len);
+		}
+	}
+	GNUNET_free (a);
+	return ret;
+}
+
+/* end of scrb_fec.c */
@@ -0,0 +1,144 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_fec.h
+ * @brief systematic Cauchy Reed-Solomon erasure code over GF(2^8)
+ * @author azhdanov
+ */
+
+#ifndef SCRB_FEC_H_
+#define SCRB_FEC_H_
+
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+
+/**
+ * Largest number of data plus parity chunks of a block
+ */
+#define GNUNET_SCRB_FEC_MAX_CHUNKS 256
+
+/**
+ * Implementations of the GF(2^8) multiply-add kernel
+ */
+enum GNUNET_SCRB_FecKernel
+{
+	/**
+	 * Table lookups, available everywhere
+	 */
+	GNUNET_SCRB_FEC_KERNEL_SCALAR = 0,
+
+	/**
+	 * 16 bytes at a time with SSSE3 byte shuffles
+	 */
+	GNUNET_SCRB_FEC_KERNEL_SSSE3 = 1,
+
+	/**
+	 * 32 bytes at a time with AVX2 byte shuffles
+	 */
+	GNUNET_SCRB_FEC_KERNEL_AVX2 = 2
+};
+
+/**
+ * Code producing @e m parity chunks for @e k data chunks, any @e k of
+ * the @e k + @e m chunks rebuild the data
+ */
+struct GNUNET_SCRB_FecCodec;
+
+/**
+ * Selects the kernel used by all codecs.  The fastest kernel the CPU
+ * supports is selected by default.
+ *
+ * @param kernel the kernel to use
+ * @return #GNUNET_OK on success, #GNUNET_NO if the CPU lacks support
+ */
+int
+GNUNET_SCRB_fec_select_kernel (enum GNUNET_SCRB_FecKernel kernel);
+
+/**
+ * Returns the kernel in use
+ */
+enum GNUNET_SCRB_FecKernel
+GNUNET_SCRB_fec_get_kernel (void);
+
+/**
+ * Creates a code for @a k data and @a m parity chunks
+ *
+ * @param k number of data chunks, at least 1
+ * @param m number of parity chunks
+ * @return the code, NULL if @a k + @a m exceeds #GNUNET_SCRB_FEC_MAX_CHUNKS
+ */
+struct GNUNET_SCRB_FecCodec *
+GNUNET_SCRB_fec_create (unsigned int k,
+		unsigned int m);
+
+/**
+ * Frees a code
+ *
+ * @param fec the code
+ */
+void
+GNUNET_SCRB_fec_destroy (struct GNUNET_SCRB_FecCodec *fec);
+
+/**
+ * Returns the number of data chunks of a code
+ */
+unsigned int
+GNUNET_SCRB_fec_data_chunks (const struct GNUNET_SCRB_FecCodec *fec);
+
+/**
+ * Returns the number of parity chunks of a code
+ */
+unsigned int
+GNUNET_SCRB_fec_parity_chunks (const struct GNUNET_SCRB_FecCodec *fec);
+
+/**
+ * Computes the parity chunks of a block
+ *
+ * @param fec the code
+ * @param data the k data chunks
+ * @param parity set to the m parity chunks
+ * @param len size of every chunk
+ */
+void
+GNUNET_SCRB_fec_encode (const struct GNUNET_SCRB_FecCodec *fec,
+		const uint8_t *const *data,
+		uint8_t *const *parity,
+		size_t len);
+
+/**
+ * Rebuilds the missing data chunks of a block.  @a chunks holds the k
+ * data chunks followed by the m parity chunks, the buffers of missing
+ * data chunks are filled in.
+ *
+ * @param fec the code
+ * @param chunks the k + m chunks
+ * @param present #GNUNET_YES for every chunk which was received
+ * @param len size of every chunk
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if less than k chunks
+ *         were received
+ */
+int
+GNUNET_SCRB_fec_decode (const struct GNUNET_SCRB_FecCodec *fec,
+		uint8_t *const *chunks,
+		const int *present,
+		size_t len);
+
+#endif /* SCRB_FEC_H_ */
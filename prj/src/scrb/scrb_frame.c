@@ -0,0 +1,164 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_frame.c
+ * @brief reference counted messages shared between several receivers
+ * @author azhdanov
+ */
+#include "scrb_frame.h"
+
+/**
+ * Initial number of slots of a frame queue
+ */
+#define INITIAL_RING_SIZE 16
+
+
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_alloc (uint16_t size)
+{
+	struct GNUNET_SCRB_Frame *frame;
+
+	frame = GNUNET_malloc (sizeof (struct GNUNET_SCRB_Frame) + size);
+	frame->rc = 1;
+	frame->size = size;
+	return frame;
+}
+
+
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_create (const struct GNUNET_MessageHeader *msg)
+{
+	struct GNUNET_SCRB_Frame *frame;
+	uint16_t size = ntohs (msg->size);
+
+	frame = GNUNET_SCRB_frame_alloc (size);
+	memcpy (&frame[1], msg, size);
+	return frame;
+}
+
+
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_ref (struct GNUNET_SCRB_Frame *frame)
+{
+	frame->rc++;
+	return frame;
+}
+
+
+void
+GNUNET_SCRB_frame_unref (struct GNUNET_SCRB_Frame *frame)
+{
+	GNUNET_assert (0 < frame->rc);
+	if (0 == --frame->rc)
+		GNUNET_free (frame);
+}
+
+
+void
+GNUNET_SCRB_frame_queue_push (struct GNUNET_SCRB_FrameQueue *queue,
+		struct GNUNET_SCRB_Frame *frame)
+{
+	if (queue->length == queue->ring_size)
+	{
+		unsigned int new_size;
+		struct GNUNET_SCRB_Frame **ring;
+		unsigned int i;
+
+		new_size = (0 == queue->ring_size) ? INITIAL_RING_SIZE : 2 * queue->ring_size;
+		ring = GNUNET_malloc (new_size * sizeof (struct GNUNET_SCRB_Frame *));
+		for (i = 0; i < queue->length; i++)
+			ring[i] = queue->ring[(queue->head + i) % queue->ring_size];
+		GNUNET_free_non_null (queue->ring);
+		queue->ring = ring;
+		queue->ring_size = new_size;
+		queue->head = 0;
+	}
+	queue->ring[(queue->head + queue->length) % queue->ring_size] =
+			GNUNET_SCRB_frame_ref (frame);
+	queue->length++;
+	queue->bytes += frame->size;
+}
+
+
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_queue_pop (struct GNUNET_SCRB_FrameQueue *queue)
+{
+	struct GNUNET_SCRB_Frame *frame;
+
+	if (0 == queue->length)
+		return NULL;
+	frame = queue->ring[queue->head];
+	queue->head = (queue->head + 1) % queue->ring_size;
+	queue->length--;
+	queue->bytes -= frame->size;
+	return frame;
+}
+
+
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_queue_peek (const struct GNUNET_SCRB_FrameQueue *queue)
+{
+	if (0 == queue->length)
+		return NULL;
+	return queue->ring[queue->head];
+}
+
+
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_queue_remove_oldest (struct GNUNET_SCRB_FrameQueue *queue,
+		GNUNET_SCRB_FrameMatcher match)
+{
+	struct GNUNET_SCRB_Frame *frame;
+	unsigned int i;
+	unsigned int j;
+
+	for (i = 0; i < queue->length; i++)
+	{
+		frame = queue->ring[(queue->head + i) % queue->ring_size];
+		if (GNUNET_YES != match (frame))
+			continue;
+		/* close the gap by moving the older frames one slot up */
+		for (j = i; j > 0; j--)
+			queue->ring[(queue->head + j) % queue->ring_size] =
+					queue->ring[(queue->head + j - 1) % queue->ring_size];
+		queue->head = (queue->head + 1) % queue->ring_size;
+		queue->length--;
+		queue->bytes -= frame->size;
+		return frame;
+	}
+	return NULL;
+}
+
+
+void
+GNUNET_SCRB_frame_queue_clear (struct GNUNET_SCRB_FrameQueue *queue)
+{
+	struct GNUNET_SCRB_Frame *frame;
+
+	while (NULL != (frame = GNUNET_SCRB_frame_queue_pop (queue)))
+		GNUNET_SCRB_frame_unref (frame);
+	GNUNET_free_non_null (queue->ring);
+	queue->ring = NULL;
+	queue->ring_size = 0;
+	queue->head = 0;
+}
+
+/* end of scrb_frame.c */
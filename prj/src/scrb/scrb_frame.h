@@ -0,0 +1,186 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_frame.h
+ * @brief reference counted messages shared between several receivers
+ * @author azhdanov
+ */
+
+#ifndef SCRB_FRAME_H_
+#define SCRB_FRAME_H_
+
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+
+/**
+ * A serialized message which is shared by all the links it is sent to.
+ * The frame is freed once the last reference is released.
+ */
+struct GNUNET_SCRB_Frame
+{
+	/**
+	 * Number of references to the frame
+	 */
+	unsigned int rc;
+
+	/**
+	 * Size of the message in bytes
+	 */
+	uint16_t size;
+
+	/* followed by the message */
+};
+
+/**
+ * FIFO of frame references, kept in a ring so that queueing a
+ * reference does not allocate.
+ */
+struct GNUNET_SCRB_FrameQueue
+{
+	/**
+	 * Ring of queued frames
+	 */
+	struct GNUNET_SCRB_Frame **ring;
+
+	/**
+	 * Number of slots in the ring
+	 */
+	unsigned int ring_size;
+
+	/**
+	 * Index of the oldest frame in the ring
+	 */
+	unsigned int head;
+
+	/**
+	 * Number of queued frames
+	 */
+	unsigned int length;
+
+	/**
+	 * Number of bytes of all queued frames
+	 */
+	size_t bytes;
+};
+
+/**
+ * Allocates a frame for a message of @a size bytes with a reference
+ * count of one, the caller fills in the message.
+ *
+ * @param size size of the message
+ * @return the new frame
+ */
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_alloc (uint16_t size);
+
+/**
+ * Creates a frame holding a copy of @a msg
+ *
+ * @param msg message to copy
+ * @return the new frame with a reference count of one
+ */
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_create (const struct GNUNET_MessageHeader *msg);
+
+/**
+ * Returns the message stored in the frame
+ */
+#define GNUNET_SCRB_frame_msg(frame) \
+	((struct GNUNET_MessageHeader *) &(frame)[1])
+
+/**
+ * Takes an additional reference to the frame
+ *
+ * @param frame frame to reference
+ * @return @a frame
+ */
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_ref (struct GNUNET_SCRB_Frame *frame);
+
+/**
+ * Releases a reference, the frame is freed with the last one
+ *
+ * @param frame frame to release
+ */
+void
+GNUNET_SCRB_frame_unref (struct GNUNET_SCRB_Frame *frame);
+
+/**
+ * Appends a reference to @a frame to the queue
+ *
+ * @param queue queue to append to
+ * @param frame frame to queue, the queue takes its own reference
+ */
+void
+GNUNET_SCRB_frame_queue_push (struct GNUNET_SCRB_FrameQueue *queue,
+		struct GNUNET_SCRB_Frame *frame);
+
+/**
+ * Removes the oldest frame from the queue
+ *
+ * @param queue queue to take the frame from
+ * @return the frame, the caller owns the queue's reference;
+ *         NULL if the queue is empty
+ */
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_queue_pop (struct GNUNET_SCRB_FrameQueue *queue);
+
+/**
+ * Returns the oldest frame without removing it
+ *
+ * @param queue queue to look at
+ * @return the frame, the queue keeps its reference;
+ *         NULL if the queue is empty
+ */
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_queue_peek (const struct GNUNET_SCRB_FrameQueue *queue);
+
+/**
+ * Selects frames of a queue
+ *
+ * @param frame a queued frame
+ * @return #GNUNET_YES if @a frame is selected
+ */
+typedef int
+(*GNUNET_SCRB_FrameMatcher) (const struct GNUNET_SCRB_Frame *frame);
+
+/**
+ * Removes the oldest queued frame selected by @a match, the order of
+ * the other frames is kept
+ *
+ * @param queue queue to take the frame from
+ * @param match selects the frames which may be removed
+ * @return the frame, the caller owns the queue's reference;
+ *         NULL if no queued frame is selected
+ */
+struct GNUNET_SCRB_Frame *
+GNUNET_SCRB_frame_queue_remove_oldest (struct GNUNET_SCRB_FrameQueue *queue,
+		GNUNET_SCRB_FrameMatcher match);
+
+/**
+ * Releases all queued frames and the ring
+ *
+ * @param queue queue to clear
+ */
+void
+GNUNET_SCRB_frame_queue_clear (struct GNUNET_SCRB_FrameQueue *queue);
+
+#endif /* SCRB_FRAME_H_ */
@@ -0,0 +1,86 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_group.c
+ * @brief children of a group, in join order and indexed by peer
+ * @author azhdanov
+ *
+ * The list keeps the order the children are served in during the fan
+ * out, the map finds a child without walking the list on joins and
+ * leaves.  The map is keyed by the interned id of the child.
+ */
+#include "scrb_group.h"
+
+
+void
+GNUNET_SCRB_group_init (struct GNUNET_SCRB_Group *group)
+{
+	group->children = GNUNET_CONTAINER_multihashmap32_create (4);
+}
+
+
+void
+GNUNET_SCRB_group_done (struct GNUNET_SCRB_Group *group)
+{
+	if (NULL == group->children)
+		return;
+	GNUNET_CONTAINER_multihashmap32_destroy (group->children);
+	group->children = NULL;
+}
+
+
+int
+GNUNET_SCRB_group_add_child (struct GNUNET_SCRB_Group *group,
+		struct GNUNET_SCRB_GroupSubscriber *gs)
+{
+	if (GNUNET_OK != GNUNET_CONTAINER_multihashmap32_put (group->children,
+			gs->sid, gs, GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY))
+		return GNUNET_NO;
+	GNUNET_CONTAINER_DLL_insert_tail (group->group_head, group->group_tail, gs);
+	return GNUNET_OK;
+}
+
+
+void
+GNUNET_SCRB_group_remove_child (struct GNUNET_SCRB_Group *group,
+		struct GNUNET_SCRB_GroupSubscriber *gs)
+{
+	GNUNET_assert (GNUNET_YES ==
+			GNUNET_CONTAINER_multihashmap32_remove (group->children, gs->sid, gs));
+	GNUNET_CONTAINER_DLL_remove (group->group_head, group->group_tail, gs);
+}
+
+
+struct GNUNET_SCRB_GroupSubscriber *
+GNUNET_SCRB_group_find_child (const struct GNUNET_SCRB_Group *group,
+		GNUNET_PEER_Id sid)
+{
+	return GNUNET_CONTAINER_multihashmap32_get (group->children, sid);
+}
+
+
+unsigned int
+GNUNET_SCRB_group_num_children (const struct GNUNET_SCRB_Group *group)
+{
+	return GNUNET_CONTAINER_multihashmap32_size (group->children);
+}
+
+/* end of scrb_group.c */
@@ -13,40 +13,52 @@
 #include <gnunet/gnunet_core_service.h>
 #include "gnunet/gnunet_dht_service.h"
 #include "gnunet/gnunet_crypto_lib.h"
+#include <gnunet/gnunet_peer_lib.h>
+
+/**
+ * Link to a neighbour, see gnunet-service-scrb_neighbours.h
+ */
+struct GSS_Neighbour;
+
+struct GNUNET_SCRB_Group;
 
 GNUNET_NETWORK_STRUCT_BEGIN
 
+/**
+ * One edge of a tree.  Peers are kept as interned ids, there may be
+ * millions of edges but only few distinct neighbours.
+ */
 struct GNUNET_SCRB_GroupSubscriber{
 	/**
-	 * id of the group the client subscribes for
+	 * The group the client subscribes for
 	 */
-	struct GNUNET_HashCode group_id;
+	struct GNUNET_SCRB_Group* group;
 	/**
-	 * The last on the path
+	 * The last on the path, interned
 	 */
-	struct GNUNET_PeerIdentity sid;
+	GNUNET_PEER_Id sid;
 
 	/**
-	 * id of the originator
+	 * id of the originator, interned
 	 */
-	struct GNUNET_PeerIdentity oid;
+	GNUNET_PEER_Id oid;
 	/**
-	 * Service id hash
+	 * Link to the originator
 	 */
-	struct GNUNET_HashCode sidh;
-	/**
-	 * Message queue handle
-	 */
-	struct GNUNET_MQ_Handle* mq_o;
+	struct GSS_Neighbour* link_o;
 
 	/**
-	 * Message queue handle
+	 * Link to the last on the path
 	 */
-	struct GNUNET_MQ_Handle* mq_l;
+	struct GSS_Neighbour* link_l;
 	/**
 	 * Id of client which subscribes to the group
 	 */
 	struct GNUNET_HashCode cid;
+	/**
+	 * Lease of the child, expires unless the child renews it
+	 */
+	struct GNUNET_CONTAINER_HeapNode* lease;
 	/**
 	 *	Previous entry
 	 */
@@ -60,9 +72,9 @@ struct GNUNET_SCRB_GroupSubscriber{
 
 struct GNUNET_SCRB_Group{
 	/**
-	 * Service id
+	 * Service id, interned
 	 */
-	struct GNUNET_PeerIdentity sid;
+	GNUNET_PEER_Id sid;
 
 	/**
 	 * group id
@@ -74,9 +86,19 @@ struct GNUNET_SCRB_Group{
 	 */
 	struct GNUNET_HashCode cid;
 	/**
-	 * Message queue handle
+	 * Link to the service which created the group
 	 */
-	struct GNUNET_MQ_Handle* mq;
+	struct GSS_Neighbour* link;
+
+	/**
+	 * Handle naming the group on the links to the children
+	 */
+	uint32_t handle;
+
+	/**
+	 * Number of stripes of the group if the tree is a stripe, 0 otherwise
+	 */
+	unsigned int stripes;
 
 	/**
 	 * Head of group subscribers list
@@ -87,6 +109,11 @@ struct GNUNET_SCRB_Group{
 	 * Tail of group subscribers list
 	 */
 	struct GNUNET_SCRB_GroupSubscriber *group_tail;
+
+	/**
+	 * The subscribers of the list by their interned service id
+	 */
+	struct GNUNET_CONTAINER_MultiHashMap32 *children;
 };
 
 struct GNUNET_SCRB_GroupParent
@@ -97,16 +124,80 @@ struct GNUNET_SCRB_GroupParent
 	struct GNUNET_HashCode group_id;
 
 	/**
-	 * Group id
+	 * The parent, interned
+	 */
+	GNUNET_PEER_Id parent;
+
+	/**
+	 * Link to the parent
+	 */
+	struct GSS_Neighbour* link;
+
+	/**
+	 * Handle the parent names the group with
 	 */
-	struct GNUNET_PeerIdentity parent;
+	uint32_t handle;
 
 	/**
-	 * Message queue handle
+	 * Lease of the parent, expires unless the parent renews it
 	 */
-	struct GNUNET_MQ_Handle* mq;
+	struct GNUNET_CONTAINER_HeapNode* lease;
 };
 
 GNUNET_NETWORK_STRUCT_END
 
+/**
+ * Sets up the child index of a new group
+ *
+ * @param group the group
+ */
+void
+GNUNET_SCRB_group_init (struct GNUNET_SCRB_Group *group);
+
+/**
+ * Destroys the child index of a group, the children are not freed
+ *
+ * @param group the group
+ */
+void
+GNUNET_SCRB_group_done (struct GNUNET_SCRB_Group *group);
+
+/**
+ * Appends a child to the group, @e sid of the child has to be set
+ *
+ * @param group the group
+ * @param gs the child
+ * @return #GNUNET_OK, #GNUNET_NO if the service is a child already
+ */
+int
+GNUNET_SCRB_group_add_child (struct GNUNET_SCRB_Group *group,
+		struct GNUNET_SCRB_GroupSubscriber *gs);
+
+/**
+ * Removes a child from the group
+ *
+ * @param group the group
+ * @param gs the child
+ */
+void
+GNUNET_SCRB_group_remove_child (struct GNUNET_SCRB_Group *group,
+		struct GNUNET_SCRB_GroupSubscriber *gs);
+
+/**
+ * Finds a child by its interned service id
+ *
+ * @param group the group
+ * @param sid interned identity of the child
+ * @return the child, NULL if it is no child of the group
+ */
+struct GNUNET_SCRB_GroupSubscriber *
+GNUNET_SCRB_group_find_child (const struct GNUNET_SCRB_Group *group,
+		GNUNET_PEER_Id sid);
+
+/**
+ * Returns the number of children of the group
+ */
+unsigned int
+GNUNET_SCRB_group_num_children (const struct GNUNET_SCRB_Group *group);
+
 #endif /* EXT_GROUP_H_ */
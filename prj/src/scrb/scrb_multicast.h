@@ -8,12 +8,58 @@
 #ifndef MULTICAST_H_
 #define MULTICAST_H_
 
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include <gnunet/gnunet_constants.h>
+
+/**
+ * Head room kept free in a CORE message for the encryption header and
+ * for the route recorded by the DHT when the payload takes the DHT path.
+ */
+#define GNUNET_SCRB_MULTICAST_HEADROOM 1024
+
+/**
+ * Largest payload a single multicast may carry, it has to fit into one
+ * CORE message together with the multicast header.
+ */
+#define GNUNET_SCRB_MULTICAST_MAX_PAYLOAD \
+	(GNUNET_CONSTANTS_MAX_ENCRYPTED_MESSAGE_SIZE - GNUNET_SCRB_MULTICAST_HEADROOM)
+
+/**
+ * Largest multicast batch, it has to fit into one CORE message just
+ * like a single multicast.
+ */
+#define GNUNET_SCRB_MULTICAST_BATCH_MAX_SIZE \
+	(GNUNET_CONSTANTS_MAX_ENCRYPTED_MESSAGE_SIZE - GNUNET_SCRB_MULTICAST_HEADROOM)
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
 struct GNUNET_SCRB_MulticastData
 {
 	/**
-	 * Data of the multicast message
+	 * Size of the payload in NBO
 	 */
-	char data[1024];
+	uint32_t data_size GNUNET_PACKED;
+
+	/* followed by data_size bytes of payload */
 };
 
+/*
+ * A GNUNET_MESSAGE_TYPE_SCRB_MULTICAST_BATCH message is a plain
+ * GNUNET_MessageHeader followed by complete MULTICAST or MULTICAST_DOWN
+ * messages.
+ */
+
+/**
+ * Group handles on a link are below this value
+ */
+#define GNUNET_SCRB_MAX_GROUP_HANDLE (1 << 20)
+
+/**
+ * Handle of a group which has none, its multicasts carry the group id
+ */
+#define GNUNET_SCRB_NO_GROUP_HANDLE UINT32_MAX
+
+GNUNET_NETWORK_STRUCT_END
+
 #endif /* MULTICAST_H_ */
@@ -0,0 +1,195 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_pool.c
+ * @brief fixed size allocation of tree entries from slabs
+ * @author azhdanov
+ *
+ * Free entries are chained through their first bytes, taking and
+ * giving back an entry is a list operation and never reaches the
+ * general purpose allocator once the slabs are large enough.
+ */
+#include "scrb_pool.h"
+
+/**
+ * Alignment of the entries
+ */
+#define POOL_ALIGNMENT 8
+
+
+/**
+ * Header of a slab, followed by its entries
+ */
+struct Slab
+{
+	/**
+	 * Next slab of the pool
+	 */
+	struct Slab *next;
+
+	/**
+	 * Keeps the entries behind the header aligned
+	 */
+	uint64_t padding;
+};
+
+/**
+ * A free entry
+ */
+struct FreeEntry
+{
+	/**
+	 * Next free entry
+	 */
+	struct FreeEntry *next;
+};
+
+struct GNUNET_SCRB_Pool
+{
+	/**
+	 * Size of an entry, rounded up to #POOL_ALIGNMENT
+	 */
+	size_t entry_size;
+
+	/**
+	 * Entries per slab
+	 */
+	unsigned int slab_entries;
+
+	/**
+	 * All slabs of the pool
+	 */
+	struct Slab *slabs;
+
+	/**
+	 * Entries ready to be taken
+	 */
+	struct FreeEntry *free_list;
+
+	/**
+	 * Entries taken
+	 */
+	unsigned int in_use;
+
+	/**
+	 * Entries of all slabs
+	 */
+	unsigned int capacity;
+};
+
+
+struct GNUNET_SCRB_Pool *
+GNUNET_SCRB_pool_create (size_t entry_size, unsigned int slab_entries)
+{
+	struct GNUNET_SCRB_Pool *pool;
+
+	GNUNET_assert (0 < slab_entries);
+	if (entry_size < sizeof (struct FreeEntry))
+		entry_size = sizeof (struct FreeEntry);
+	pool = GNUNET_new (struct GNUNET_SCRB_Pool);
+	pool->entry_size = (entry_size + POOL_ALIGNMENT - 1) & ~((size_t) POOL_ALIGNMENT - 1);
+	pool->slab_entries = slab_entries;
+	return pool;
+}
+
+
+void
+GNUNET_SCRB_pool_destroy (struct GNUNET_SCRB_Pool *pool)
+{
+	struct Slab *slab;
+
+	while (NULL != (slab = pool->slabs))
+	{
+		pool->slabs = slab->next;
+		GNUNET_free (slab);
+	}
+	GNUNET_free (pool);
+}
+
+
+/**
+ * Adds a slab to the pool and puts its entries on the free list
+ */
+static void
+add_slab (struct GNUNET_SCRB_Pool *pool)
+{
+	struct Slab *slab;
+	char *entries;
+	struct FreeEntry *fe;
+	unsigned int i;
+
+	slab = GNUNET_malloc (sizeof (struct Slab) +
+			pool->slab_entries * pool->entry_size);
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	entries = (char *) &slab[1];
+	/* chain backwards so that entries are handed out in address order */
+	for (i = pool->slab_entries; i > 0; i--)
+	{
+		fe = (struct FreeEntry *) &entries[(i - 1) * pool->entry_size];
+		fe->next = pool->free_list;
+		pool->free_list = fe;
+	}
+	pool->capacity += pool->slab_entries;
+}
+
+
+void *
+GNUNET_SCRB_pool_alloc (struct GNUNET_SCRB_Pool *pool)
+{
+	struct FreeEntry *fe;
+
+	if (NULL == pool->free_list)
+		add_slab (pool);
+	fe = pool->free_list;
+	pool->free_list = fe->next;
+	pool->in_use++;
+	memset (fe, 0, pool->entry_size);
+	return fe;
+}
+
+
+void
+GNUNET_SCRB_pool_free (struct GNUNET_SCRB_Pool *pool, void *entry)
+{
+	struct FreeEntry *fe = entry;
+
+	GNUNET_assert (0 < pool->in_use);
+	fe->next = pool->free_list;
+	pool->free_list = fe;
+	pool->in_use--;
+}
+
+
+unsigned int
+GNUNET_SCRB_pool_in_use (const struct GNUNET_SCRB_Pool *pool)
+{
+	return pool->in_use;
+}
+
+
+unsigned int
+GNUNET_SCRB_pool_capacity (const struct GNUNET_SCRB_Pool *pool)
+{
+	return pool->capacity;
+}
+
+/* end of scrb_pool.c */
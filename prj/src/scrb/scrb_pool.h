@@ -0,0 +1,92 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_pool.h
+ * @brief fixed size allocation of tree entries from slabs
+ * @author azhdanov
+ */
+
+#ifndef SCRB_POOL_H_
+#define SCRB_POOL_H_
+
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+
+/**
+ * Pool of equally sized entries
+ */
+struct GNUNET_SCRB_Pool;
+
+/**
+ * Creates a pool.  Entries are carved from slabs of @a slab_entries
+ * entries, the slabs are only given back when the pool is destroyed.
+ *
+ * @param entry_size size of one entry
+ * @param slab_entries number of entries per slab
+ * @return the pool
+ */
+struct GNUNET_SCRB_Pool *
+GNUNET_SCRB_pool_create (size_t entry_size, unsigned int slab_entries);
+
+/**
+ * Destroys a pool with all its slabs, entries still in use are lost
+ *
+ * @param pool the pool
+ */
+void
+GNUNET_SCRB_pool_destroy (struct GNUNET_SCRB_Pool *pool);
+
+/**
+ * Takes a zeroed entry from the pool
+ *
+ * @param pool the pool
+ * @return the entry
+ */
+void *
+GNUNET_SCRB_pool_alloc (struct GNUNET_SCRB_Pool *pool);
+
+/**
+ * Gives an entry back to its pool
+ *
+ * @param pool the pool the entry was taken from
+ * @param entry the entry
+ */
+void
+GNUNET_SCRB_pool_free (struct GNUNET_SCRB_Pool *pool, void *entry);
+
+/**
+ * Returns the number of entries taken from the pool
+ */
+unsigned int
+GNUNET_SCRB_pool_in_use (const struct GNUNET_SCRB_Pool *pool);
+
+/**
+ * Returns the number of entries the slabs of the pool hold
+ */
+unsigned int
+GNUNET_SCRB_pool_capacity (const struct GNUNET_SCRB_Pool *pool);
+
+/**
+ * Takes a zeroed entry of @a type from @a pool, like GNUNET_new()
+ */
+#define GNUNET_SCRB_pool_new(pool, type) ((type *) GNUNET_SCRB_pool_alloc (pool))
+
+#endif /* SCRB_POOL_H_ */
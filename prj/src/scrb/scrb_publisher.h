@@ -18,6 +18,10 @@ struct GNUNET_SCRB_ServicePublisher
 	 * rendevouz point
 	 */
 	struct GNUNET_PeerIdentity rp;
+	/**
+	 * number of stripes of the group in NBO
+	 */
+	uint32_t stripes;
 };
 
 
@@ -0,0 +1,446 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_stripe.c
+ * @brief SplitStream stripes, splitting of payloads and their reassembly
+ * @author azhdanov
+ */
+#include "scrb_stripe.h"
+
+/**
+ * A block under reassembly
+ */
+struct PendingBlock
+{
+	/**
+	 * Buffer for the data chunks followed by the parity chunks,
+	 * NULL if the slot is unused or the block was delivered
+	 */
+	uint8_t *data;
+
+	/**
+	 * Size of the block
+	 */
+	uint32_t block_size;
+
+	/**
+	 * Sequence number of the block
+	 */
+	uint32_t seq;
+
+	/**
+	 * Number of data chunks of the block
+	 */
+	uint16_t count;
+
+	/**
+	 * Number of parity chunks of the block
+	 */
+	uint16_t parity;
+
+	/**
+	 * Number of chunks received so far
+	 */
+	uint16_t received;
+
+	/**
+	 * Bit i is set once chunk i was received
+	 */
+	uint32_t mask;
+
+	/**
+	 * #GNUNET_YES once the block was delivered, later chunks of it
+	 * are ignored
+	 */
+	int done;
+};
+
+/**
+ * Blocks of one publisher under reassembly
+ */
+struct SourceWindow
+{
+	/**
+	 * Kept in a DLL, the publisher heard of last first
+	 */
+	struct SourceWindow *next;
+
+	struct SourceWindow *prev;
+
+	/**
+	 * The publisher
+	 */
+	struct GNUNET_HashCode source;
+
+	/**
+	 * Blocks under reassembly, indexed by sequence number
+	 */
+	struct PendingBlock window[GNUNET_SCRB_STRIPE_WINDOW];
+};
+
+struct GNUNET_SCRB_StripeAssembly
+{
+	/**
+	 * Windows of the publishers, the one heard of last first
+	 */
+	struct SourceWindow *sw_head;
+
+	struct SourceWindow *sw_tail;
+
+	/**
+	 * Number of windows in the DLL
+	 */
+	unsigned int sources;
+
+	/**
+	 * Erasure code of the last coded block, NULL if none was received
+	 */
+	struct GNUNET_SCRB_FecCodec *fec;
+};
+
+
+void
+GNUNET_SCRB_stripe_id (const struct GNUNET_HashCode *group_id,
+		unsigned int index,
+		struct GNUNET_HashCode *stripe_id)
+{
+	struct
+	{
+		struct GNUNET_HashCode group_id;
+		uint32_t index;
+	} in;
+	unsigned char *first = (unsigned char *) stripe_id;
+
+	GNUNET_assert (index < GNUNET_SCRB_MAX_STRIPES);
+	in.group_id = *group_id;
+	in.index = htonl ((uint32_t) index);
+	GNUNET_CRYPTO_hash (&in, sizeof (in), stripe_id);
+	*first = (unsigned char) ((index << 4) | (*first & 0x0f));
+}
+
+
+unsigned int
+GNUNET_SCRB_stripe_index (const struct GNUNET_HashCode *stripe_id)
+{
+	return ((const unsigned char *) stripe_id)[0] >> 4;
+}
+
+
+/**
+ * Returns the number of bytes of data chunk @a index
+ */
+static size_t
+data_chunk_size (size_t size, size_t chunk_size, unsigned int index)
+{
+	size_t off = index * chunk_size;
+
+	return (off >= size) ? 0 : GNUNET_MIN (chunk_size, size - off);
+}
+
+
+/**
+ * Splits a payload into its data chunks and computes their parity
+ */
+static void
+split_coded (const void *data,
+		size_t size,
+		unsigned int stripes,
+		const struct GNUNET_SCRB_FecCodec *fec,
+		uint32_t seq,
+		GNUNET_SCRB_StripeChunkCallback cb,
+		void *cb_cls)
+{
+	struct GNUNET_SCRB_StripeChunk chunk;
+	const uint8_t *chunks[GNUNET_SCRB_MAX_STRIPES];
+	uint8_t *parity[GNUNET_SCRB_MAX_STRIPES];
+	unsigned int k = GNUNET_SCRB_fec_data_chunks (fec);
+	unsigned int m = GNUNET_SCRB_fec_parity_chunks (fec);
+	size_t chunk_size = (size + k - 1) / k;
+	uint8_t *pad;
+	unsigned int i;
+
+	GNUNET_assert (k + m == stripes);
+	/* the short data chunks are coded with zero padding */
+	pad = GNUNET_malloc (GNUNET_MAX ((k + m) * chunk_size, 1));
+	for (i = 0; i < k; i++)
+	{
+		if (data_chunk_size (size, chunk_size, i) == chunk_size)
+		{
+			chunks[i] = (const uint8_t *) data + i * chunk_size;
+			continue;
+		}
+		memcpy (&pad[i * chunk_size],
+				(const uint8_t *) data + GNUNET_MIN (i * chunk_size, size),
+				data_chunk_size (size, chunk_size, i));
+		chunks[i] = &pad[i * chunk_size];
+	}
+	for (i = 0; i < m; i++)
+		parity[i] = &pad[(k + i) * chunk_size];
+	GNUNET_SCRB_fec_encode (fec, chunks, parity, chunk_size);
+
+	chunk.seq = htonl (seq);
+	chunk.block_size = htonl ((uint32_t) size);
+	chunk.count = htons ((uint16_t) k);
+	chunk.parity = htons ((uint16_t) m);
+	chunk.reserved = htons (0);
+	for (i = 0; i < k + m; i++)
+	{
+		chunk.index = htons ((uint16_t) i);
+		if (i < k)
+			cb (cb_cls, (seq + i) % stripes, &chunk,
+					(const uint8_t *) data + GNUNET_MIN (i * chunk_size, size),
+					data_chunk_size (size, chunk_size, i));
+		else
+			cb (cb_cls, (seq + i) % stripes, &chunk, parity[i - k], chunk_size);
+	}
+	GNUNET_free (pad);
+}
+
+
+void
+GNUNET_SCRB_stripe_split (const void *data,
+		size_t size,
+		unsigned int stripes,
+		const struct GNUNET_SCRB_FecCodec *fec,
+		uint32_t seq,
+		GNUNET_SCRB_StripeChunkCallback cb,
+		void *cb_cls)
+{
+	struct GNUNET_SCRB_StripeChunk chunk;
+	size_t chunk_size;
+	size_t off;
+	unsigned int count;
+	unsigned int i;
+
+	GNUNET_assert ((stripes > 0) && (stripes <= GNUNET_SCRB_MAX_STRIPES));
+	if (NULL != fec)
+	{
+		split_coded (data, size, stripes, fec, seq, cb, cb_cls);
+		return;
+	}
+	count = 1;
+	if (size > 0)
+	{
+		chunk_size = (size + stripes - 1) / stripes;
+		count = (size + chunk_size - 1) / chunk_size;
+	}
+	/* the receiver derives the chunk size from the count */
+	chunk_size = (size + count - 1) / count;
+	chunk.seq = htonl (seq);
+	chunk.block_size = htonl ((uint32_t) size);
+	chunk.count = htons ((uint16_t) count);
+	chunk.parity = htons (0);
+	chunk.reserved = htons (0);
+	for (i = 0; i < count; i++)
+	{
+		off = i * chunk_size;
+		chunk.index = htons ((uint16_t) i);
+		cb (cb_cls, (seq + i) % stripes, &chunk, (const char *) data + off,
+				GNUNET_MIN (chunk_size, size - off));
+	}
+}
+
+
+struct GNUNET_SCRB_StripeAssembly *
+GNUNET_SCRB_stripe_assembly_create ()
+{
+	return GNUNET_new (struct GNUNET_SCRB_StripeAssembly);
+}
+
+
+/**
+ * Frees a window and its incomplete blocks
+ */
+static void
+free_source_window (struct SourceWindow *sw)
+{
+	unsigned int i;
+
+	for (i = 0; i < GNUNET_SCRB_STRIPE_WINDOW; i++)
+		GNUNET_free_non_null (sw->window[i].data);
+	GNUNET_free (sw);
+}
+
+
+/**
+ * Returns the window of @a source and moves it to the head, creates it
+ * if needed.  Beyond #GNUNET_SCRB_STRIPE_SOURCES the window of the
+ * publisher heard of longest ago is dropped.
+ */
+static struct SourceWindow *
+get_source_window (struct GNUNET_SCRB_StripeAssembly *sa,
+		const struct GNUNET_HashCode *source)
+{
+	struct SourceWindow *sw;
+
+	for (sw = sa->sw_head; NULL != sw; sw = sw->next)
+		if (0 == memcmp (&sw->source, source, sizeof (struct GNUNET_HashCode)))
+			break;
+	if (NULL != sw)
+	{
+		GNUNET_CONTAINER_DLL_remove (sa->sw_head, sa->sw_tail, sw);
+		GNUNET_CONTAINER_DLL_insert (sa->sw_head, sa->sw_tail, sw);
+		return sw;
+	}
+	if (GNUNET_SCRB_STRIPE_SOURCES == sa->sources)
+	{
+		sw = sa->sw_tail;
+		GNUNET_CONTAINER_DLL_remove (sa->sw_head, sa->sw_tail, sw);
+		free_source_window (sw);
+		sa->sources--;
+	}
+	sw = GNUNET_new (struct SourceWindow);
+	sw->source = *source;
+	GNUNET_CONTAINER_DLL_insert (sa->sw_head, sa->sw_tail, sw);
+	sa->sources++;
+	return sw;
+}
+
+
+/**
+ * Rebuilds the missing data chunks of a coded block
+ *
+ * @return #GNUNET_OK on success
+ */
+static int
+decode_block (struct GNUNET_SCRB_StripeAssembly *sa,
+		struct PendingBlock *pb,
+		size_t chunk_size)
+{
+	uint8_t *chunks[GNUNET_SCRB_MAX_STRIPES];
+	int present[GNUNET_SCRB_MAX_STRIPES];
+	unsigned int i;
+
+	if ((NULL == sa->fec) ||
+			(GNUNET_SCRB_fec_data_chunks (sa->fec) != pb->count) ||
+			(GNUNET_SCRB_fec_parity_chunks (sa->fec) != pb->parity))
+	{
+		if (NULL != sa->fec)
+			GNUNET_SCRB_fec_destroy (sa->fec);
+		sa->fec = GNUNET_SCRB_fec_create (pb->count, pb->parity);
+	}
+	for (i = 0; i < pb->count + pb->parity; i++)
+	{
+		chunks[i] = &pb->data[i * chunk_size];
+		present[i] = (0 != (pb->mask & (1 << i))) ? GNUNET_YES : GNUNET_NO;
+	}
+	return GNUNET_SCRB_fec_decode (sa->fec, chunks, present, chunk_size);
+}
+
+
+int
+GNUNET_SCRB_stripe_assembly_add (struct GNUNET_SCRB_StripeAssembly *sa,
+		const struct GNUNET_HashCode *source,
+		const struct GNUNET_SCRB_StripeChunk *chunk,
+		size_t size,
+		GNUNET_SCRB_StripeBlockCallback cb,
+		void *cb_cls)
+{
+	struct SourceWindow *sw;
+	struct PendingBlock *pb;
+	uint32_t seq;
+	uint32_t block_size;
+	uint16_t index;
+	uint16_t count;
+	uint16_t parity;
+	size_t chunk_size;
+	size_t expected;
+	int unused;
+	int ret;
+
+	if (size < sizeof (struct GNUNET_SCRB_StripeChunk))
+		return GNUNET_SYSERR;
+	size -= sizeof (struct GNUNET_SCRB_StripeChunk);
+	seq = ntohl (chunk->seq);
+	block_size = ntohl (chunk->block_size);
+	index = ntohs (chunk->index);
+	count = ntohs (chunk->count);
+	parity = ntohs (chunk->parity);
+	if ((0 == count) || (count + parity > GNUNET_SCRB_MAX_STRIPES) ||
+			(index >= count + parity))
+		return GNUNET_SYSERR;
+	chunk_size = (block_size + count - 1) / count;
+	if (index >= count)
+		expected = chunk_size;
+	else if (0 == parity)
+		expected = GNUNET_MIN (chunk_size, block_size - index * chunk_size);
+	else
+		expected = data_chunk_size (block_size, chunk_size, index);
+	if (((0 == parity) && (index * chunk_size > block_size)) || (size != expected))
+		return GNUNET_SYSERR;
+	sw = get_source_window (sa, source);
+	pb = &sw->window[seq % GNUNET_SCRB_STRIPE_WINDOW];
+	unused = ((NULL == pb->data) && (GNUNET_YES != pb->done)) ? GNUNET_YES : GNUNET_NO;
+	/* a late chunk of a block a newer one already replaced */
+	if ((GNUNET_NO == unused) && ((int32_t) (seq - pb->seq) < 0))
+		return GNUNET_OK;
+	if ((GNUNET_YES == unused) || (pb->seq != seq))
+	{
+		/* a newer block takes the slot, the old one will not complete */
+		GNUNET_free_non_null (pb->data);
+		pb->data = GNUNET_malloc (GNUNET_MAX ((count + parity) * chunk_size, 1));
+		pb->block_size = block_size;
+		pb->seq = seq;
+		pb->count = count;
+		pb->parity = parity;
+		pb->received = 0;
+		pb->mask = 0;
+		pb->done = GNUNET_NO;
+	}
+	if (GNUNET_YES == pb->done)
+		return GNUNET_OK;
+	if ((pb->block_size != block_size) || (pb->count != count) ||
+			(pb->parity != parity))
+		return GNUNET_SYSERR;
+	if (0 != (pb->mask & (1 << index)))
+		return GNUNET_OK;
+	memcpy (&pb->data[index * chunk_size], &chunk[1], size);
+	pb->mask |= (1 << index);
+	if (++pb->received < count)
+		return GNUNET_OK;
+	ret = GNUNET_OK;
+	if ((pb->mask & ((1 << count) - 1)) != (uint32_t) ((1 << count) - 1))
+		ret = decode_block (sa, pb, chunk_size);
+	if (GNUNET_OK == ret)
+		cb (cb_cls, pb->data, block_size);
+	GNUNET_free (pb->data);
+	pb->data = NULL;
+	pb->done = GNUNET_YES;
+	return ret;
+}
+
+
+void
+GNUNET_SCRB_stripe_assembly_destroy (struct GNUNET_SCRB_StripeAssembly *sa)
+{
+	struct SourceWindow *sw;
+
+	while (NULL != (sw = sa->sw_head))
+	{
+		GNUNET_CONTAINER_DLL_remove (sa->sw_head, sa->sw_tail, sw);
+		free_source_window (sw);
+	}
+	if (NULL != sa->fec)
+		GNUNET_SCRB_fec_destroy (sa->fec);
+	GNUNET_free (sa);
+}
+
+/* end of scrb_stripe.c */
@@ -0,0 +1,216 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * @file scrb/scrb_stripe.h
+ * @brief SplitStream stripes, splitting of payloads and their reassembly
+ * @author azhdanov
+ */
+
+#ifndef SCRB_STRIPE_H_
+#define SCRB_STRIPE_H_
+
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include "scrb_fec.h"
+
+/**
+ * Largest number of stripes of a group, the index of a stripe is the
+ * first hexadecimal digit of its id.
+ */
+#define GNUNET_SCRB_MAX_STRIPES 16
+
+/**
+ * Number of blocks of a publisher reassembled at the same time by a
+ * subscriber
+ */
+#define GNUNET_SCRB_STRIPE_WINDOW 8
+
+/**
+ * Number of publishers a subscriber reassembles blocks of at the same
+ * time, the blocks of the publisher heard of longest ago are dropped
+ */
+#define GNUNET_SCRB_STRIPE_SOURCES 8
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+/**
+ * Header in front of every chunk of a striped multicast, it is the
+ * start of the payload of the multicast sent on the stripe.
+ */
+struct GNUNET_SCRB_StripeChunk
+{
+	/**
+	 * Sequence number of the block in NBO
+	 */
+	uint32_t seq GNUNET_PACKED;
+
+	/**
+	 * Size of the whole block in NBO
+	 */
+	uint32_t block_size GNUNET_PACKED;
+
+	/**
+	 * Index of this chunk in NBO
+	 */
+	uint16_t index GNUNET_PACKED;
+
+	/**
+	 * Number of data chunks of the block in NBO
+	 */
+	uint16_t count GNUNET_PACKED;
+
+	/**
+	 * Number of parity chunks of the block in NBO, they follow the
+	 * data chunks in the numbering of @e index
+	 */
+	uint16_t parity GNUNET_PACKED;
+
+	/**
+	 * Always zero
+	 */
+	uint16_t reserved GNUNET_PACKED;
+
+	/* followed by the chunk data */
+};
+
+GNUNET_NETWORK_STRUCT_END
+
+/**
+ * Reassembly state of a subscriber of a striped group
+ */
+struct GNUNET_SCRB_StripeAssembly;
+
+/**
+ * Called for every chunk of a split payload
+ *
+ * @param cls closure
+ * @param stripe index of the stripe the chunk goes to
+ * @param chunk header of the chunk
+ * @param data chunk data
+ * @param size number of bytes in @a data
+ */
+typedef void
+(*GNUNET_SCRB_StripeChunkCallback) (void *cls,
+		unsigned int stripe,
+		const struct GNUNET_SCRB_StripeChunk *chunk,
+		const void *data,
+		size_t size);
+
+/**
+ * Called when all chunks of a block arrived
+ *
+ * @param cls closure
+ * @param data the reassembled payload
+ * @param size number of bytes in @a data
+ */
+typedef void
+(*GNUNET_SCRB_StripeBlockCallback) (void *cls,
+		const void *data,
+		size_t size);
+
+/**
+ * Computes the id of a stripe of a group.  The ids of the stripes of a
+ * group differ in their first digit, so the DHT routes them through
+ * different neighbours and their trees are interior-node-disjoint.
+ *
+ * @param group_id id of the group
+ * @param index index of the stripe, smaller than #GNUNET_SCRB_MAX_STRIPES
+ * @param stripe_id set to the id of the stripe
+ */
+void
+GNUNET_SCRB_stripe_id (const struct GNUNET_HashCode *group_id,
+		unsigned int index,
+		struct GNUNET_HashCode *stripe_id);
+
+/**
+ * Returns the index of a stripe from its id
+ *
+ * @param stripe_id id of the stripe
+ * @return index of the stripe
+ */
+unsigned int
+GNUNET_SCRB_stripe_index (const struct GNUNET_HashCode *stripe_id);
+
+/**
+ * Splits a payload into at most @a stripes chunks of equal size.
+ * Small payloads get fewer chunks, the chunks of consecutive blocks
+ * start on consecutive stripes so all stripes carry the same load.
+ * With an erasure code the payload is split into its k data chunks
+ * and its m parity chunks are added, k + m has to be @a stripes.
+ *
+ * @param data payload to split
+ * @param size number of bytes in @a data
+ * @param stripes number of stripes of the group
+ * @param fec erasure code, NULL to send the data chunks only
+ * @param seq sequence number of the block
+ * @param cb called for every chunk
+ * @param cb_cls closure for @a cb
+ */
+void
+GNUNET_SCRB_stripe_split (const void *data,
+		size_t size,
+		unsigned int stripes,
+		const struct GNUNET_SCRB_FecCodec *fec,
+		uint32_t seq,
+		GNUNET_SCRB_StripeChunkCallback cb,
+		void *cb_cls);
+
+/**
+ * Creates the reassembly state of a subscriber
+ *
+ * @return the new state
+ */
+struct GNUNET_SCRB_StripeAssembly *
+GNUNET_SCRB_stripe_assembly_create (void);
+
+/**
+ * Adds a received chunk, calls @a cb once its block is complete.  A
+ * coded block is complete as soon as any k of its chunks arrived, the
+ * missing data chunks are rebuilt from the parity chunks.  The blocks
+ * of every source are numbered on their own.  A block which is still
+ * incomplete when a block #GNUNET_SCRB_STRIPE_WINDOW sequence numbers
+ * later starts is dropped, late chunks of a dropped block are ignored.
+ *
+ * @param sa reassembly state
+ * @param source publisher of the block
+ * @param chunk the chunk, followed by its data
+ * @param size number of bytes of @a chunk including the data
+ * @param cb called with the complete block
+ * @param cb_cls closure for @a cb
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the chunk is malformed
+ */
+int
+GNUNET_SCRB_stripe_assembly_add (struct GNUNET_SCRB_StripeAssembly *sa,
+		const struct GNUNET_HashCode *source,
+		const struct GNUNET_SCRB_StripeChunk *chunk,
+		size_t size,
+		GNUNET_SCRB_StripeBlockCallback cb,
+		void *cb_cls);
+
+/**
+ * Frees the reassembly state and all incomplete blocks
+ *
+ * @param sa state to free
+ */
+void
+GNUNET_SCRB_stripe_assembly_destroy (struct GNUNET_SCRB_StripeAssembly *sa);
+
+#endif /* SCRB_STRIPE_H_ */
@@ -8,6 +8,11 @@
 #ifndef SCRB_SUBSCRIBER_H_
 #define SCRB_SUBSCRIBER_H_
 
+/**
+ * Local client of the service, see gnunet-service-scrb.c
+ */
+struct ClientEntry;
+
 GNUNET_NETWORK_STRUCT_BEGIN
 
 struct GNUNET_SCRB_ServiceSubscription
@@ -20,6 +25,16 @@ struct GNUNET_SCRB_ServiceSubscription
 	struct GNUNET_SCRB_ServiceSubscriber* sub_head;
 
 	struct GNUNET_SCRB_ServiceSubscriber* sub_tail;
+
+	/**
+	 * When the last JOIN was put, while the subscription waits for its parent
+	 */
+	struct GNUNET_TIME_Absolute join_sent;
+
+	/**
+	 * Number of JOINs put so far
+	 */
+	unsigned int join_attempts;
 };
 
 
@@ -35,11 +50,24 @@ struct GNUNET_SCRB_ServiceSubscriber
 	 */
 	struct GNUNET_HashCode group_id;
 
+	/**
+	 * The client holding the subscription, NULL if it is not connected
+	 */
+	struct ClientEntry* client;
 
 	struct GNUNET_SCRB_ServiceSubscriber *prev;
 
 	struct GNUNET_SCRB_ServiceSubscriber *next;
 
+	/**
+	 * Previous subscription of the same client
+	 */
+	struct GNUNET_SCRB_ServiceSubscriber *prev_client;
+
+	/**
+	 * Next subscription of the same client
+	 */
+	struct GNUNET_SCRB_ServiceSubscriber *next_client;
 };
 
 GNUNET_NETWORK_STRUCT_END
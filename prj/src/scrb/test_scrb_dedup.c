@@ -0,0 +1,176 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+/**
+ * @file scrb/test_scrb_dedup.c
+ * @brief testcase for scrb_dedup.c
+ * @author azhdanov
+ */
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include "scrb_dedup.h"
+
+/**
+ * Number of sequence numbers fed to the window in the random test
+ */
+#define ROUNDS 100000
+
+
+/**
+ * Feeds a window in-order and reordered sequence numbers around a
+ * wrap-around, with every one of them repeated
+ *
+ * @return 0 on success
+ */
+static int
+check_reordered ()
+{
+	struct GNUNET_SCRB_DedupWindow win;
+	uint32_t start = UINT32_MAX - 1000;
+	uint32_t seq;
+	unsigned int i;
+	unsigned int back;
+
+	memset (&win, 0, sizeof (win));
+	for (i = 0; i < ROUNDS; i++)
+	{
+		/* mostly in order, every now and then one from the past */
+		back = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 4);
+		seq = start + i - ((0 == back) ? 0 :
+				GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
+						GNUNET_SCRB_DEDUP_WINDOW));
+		if ((seq == start + i) &&
+				(GNUNET_NO != GNUNET_SCRB_dedup_check (&win, seq)))
+		{
+			fprintf (stderr, "new sequence number %u reported as duplicate\n", seq);
+			return 1;
+		}
+		GNUNET_SCRB_dedup_check (&win, seq);
+		if (GNUNET_YES != GNUNET_SCRB_dedup_check (&win, seq))
+		{
+			fprintf (stderr, "duplicate %u not detected\n", seq);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * Checks gaps within the window and jumps beyond it
+ *
+ * @return 0 on success
+ */
+static int
+check_gaps ()
+{
+	struct GNUNET_SCRB_DedupWindow win;
+	uint32_t seq;
+
+	memset (&win, 0, sizeof (win));
+	for (seq = 0; seq < 1000; seq += 2)
+		if (GNUNET_NO != GNUNET_SCRB_dedup_check (&win, seq))
+			return 1;
+	/* the odd ones in the window are still new, the even ones not */
+	for (seq = 999; seq > 1000 - GNUNET_SCRB_DEDUP_WINDOW; seq--)
+		if ((seq % 2 == 0) != (GNUNET_YES == GNUNET_SCRB_dedup_check (&win, seq)))
+			return 1;
+	/* sequence numbers older than the window are dropped */
+	if (GNUNET_YES != GNUNET_SCRB_dedup_check (&win, 5))
+		return 1;
+	if (GNUNET_YES != GNUNET_SCRB_dedup_check (&win, 6))
+		return 1;
+	/* and did not move the window */
+	if (GNUNET_NO != GNUNET_SCRB_dedup_check (&win, 1000))
+		return 1;
+	/* a jump ahead restarts it */
+	if (GNUNET_NO != GNUNET_SCRB_dedup_check (&win, 6 + 10 * GNUNET_SCRB_DEDUP_WINDOW))
+		return 1;
+	if (GNUNET_NO != GNUNET_SCRB_dedup_check (&win, 5 + 10 * GNUNET_SCRB_DEDUP_WINDOW))
+		return 1;
+	if (GNUNET_YES != GNUNET_SCRB_dedup_check (&win, 1001))
+		return 1;
+	return 0;
+}
+
+
+/**
+ * A publisher restarts in the middle of its stream with sequence
+ * numbers far below those before.  The new epoch gets a window of its
+ * own, while replays from before the restart stay duplicates.
+ *
+ * @return 0 on success
+ */
+static int
+check_restart ()
+{
+	struct GNUNET_SCRB_DedupWindow win[2];
+	struct GNUNET_HashCode key[2];
+	struct GNUNET_HashCode group_id;
+	struct GNUNET_PeerIdentity origin;
+	uint32_t start[2] = { 100000, 7 };
+	uint32_t seq;
+	unsigned int i;
+
+	memset (win, 0, sizeof (win));
+	memset (&group_id, 23, sizeof (group_id));
+	memset (&origin, 42, sizeof (origin));
+	for (i = 0; i < 2; i++)
+	{
+		/* the service draws a new epoch when it restarts */
+		GNUNET_SCRB_dedup_key (&group_id, &origin, 1 + i, &key[i]);
+		for (seq = start[i]; seq < start[i] + 500; seq++)
+			if (GNUNET_NO != GNUNET_SCRB_dedup_check (&win[i], seq))
+				return 1;
+	}
+	if (0 == memcmp (&key[0], &key[1], sizeof (struct GNUNET_HashCode)))
+		return 1;
+	/* without the epoch the new numbers were too old for the window */
+	if (GNUNET_YES != GNUNET_SCRB_dedup_check (&win[0], start[1]))
+		return 1;
+	/* replays of either epoch are still caught */
+	if (GNUNET_YES != GNUNET_SCRB_dedup_check (&win[0], start[0] + 400))
+		return 1;
+	if (GNUNET_YES != GNUNET_SCRB_dedup_check (&win[1], start[1] + 400))
+		return 1;
+	return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	int ret = 0;
+
+	GNUNET_log_setup ("test-scrb-dedup", "WARNING", NULL);
+	if (0 != check_gaps ())
+	{
+		fprintf (stderr, "gaps in the window not handled\n");
+		ret = 1;
+	}
+	ret |= check_reordered ();
+	if (0 != check_restart ())
+	{
+		fprintf (stderr, "restarted publisher not told apart\n");
+		ret = 1;
+	}
+	return ret;
+}
+
+/* end of test_scrb_dedup.c */
@@ -0,0 +1,192 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+/**
+ * @file scrb/test_scrb_fec.c
+ * @brief testcase for scrb_fec.c
+ * @author azhdanov
+ */
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include "scrb_fec.h"
+
+/**
+ * Size of the chunks, not a multiple of the vector width so the tails
+ * of the kernels are covered
+ */
+#define CHUNK_SIZE 1021
+
+/**
+ * Number of random erasure patterns per code
+ */
+#define ROUNDS 20
+
+
+static const unsigned int codes[][2] = {
+	{ 1, 1 }, { 2, 1 }, { 4, 2 }, { 8, 4 }, { 10, 6 }, { 13, 3 }, { 16, 0 }
+};
+
+static const char *kernel_names[] = { "scalar", "ssse3", "avx2" };
+
+
+/**
+ * Encodes random blocks, erases random chunks and checks that the
+ * data is rebuilt
+ *
+ * @return 0 on success
+ */
+static int
+check_code (unsigned int k, unsigned int m)
+{
+	struct GNUNET_SCRB_FecCodec *fec;
+	uint8_t *orig[GNUNET_SCRB_FEC_MAX_CHUNKS];
+	uint8_t *chunks[GNUNET_SCRB_FEC_MAX_CHUNKS];
+	int present[GNUNET_SCRB_FEC_MAX_CHUNKS];
+	unsigned int round;
+	unsigned int erased;
+	unsigned int i;
+	unsigned int j;
+	int ret = 0;
+
+	fec = GNUNET_SCRB_fec_create (k, m);
+	GNUNET_assert (NULL != fec);
+	for (i = 0; i < k + m; i++)
+	{
+		orig[i] = GNUNET_malloc (CHUNK_SIZE);
+		chunks[i] = GNUNET_malloc (CHUNK_SIZE);
+	}
+	for (round = 0; (round < ROUNDS) && (0 == ret); round++)
+	{
+		for (i = 0; i < k; i++)
+			for (j = 0; j < CHUNK_SIZE; j++)
+				orig[i][j] = (uint8_t) GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 256);
+		GNUNET_SCRB_fec_encode (fec, (const uint8_t *const *) orig, &orig[k], CHUNK_SIZE);
+		for (i = 0; i < k + m; i++)
+		{
+			memcpy (chunks[i], orig[i], CHUNK_SIZE);
+			present[i] = GNUNET_YES;
+		}
+		/* lose m chunks, data chunks first in the first round */
+		for (erased = 0; erased < m; erased++)
+		{
+			i = (0 == round) ? erased % (k + m)
+					: GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, k + m);
+			present[i] = GNUNET_NO;
+			memset (chunks[i], 0xa5, CHUNK_SIZE);
+		}
+		if (GNUNET_OK != GNUNET_SCRB_fec_decode (fec, chunks, present, CHUNK_SIZE))
+		{
+			fprintf (stderr, "decode of k=%u m=%u failed\n", k, m);
+			ret = 1;
+		}
+		for (i = 0; (i < k) && (0 == ret); i++)
+			if (0 != memcmp (chunks[i], orig[i], CHUNK_SIZE))
+			{
+				fprintf (stderr, "chunk %u of k=%u m=%u differs\n", i, k, m);
+				ret = 1;
+			}
+	}
+	/* one chunk too many lost */
+	if ((0 == ret) && (m > 0))
+	{
+		for (i = 0; i < k + m; i++)
+			present[i] = (i > m) ? GNUNET_YES : GNUNET_NO;
+		if (GNUNET_SYSERR != GNUNET_SCRB_fec_decode (fec, chunks, present, CHUNK_SIZE))
+			ret = 1;
+	}
+	for (i = 0; i < k + m; i++)
+	{
+		GNUNET_free (orig[i]);
+		GNUNET_free (chunks[i]);
+	}
+	GNUNET_SCRB_fec_destroy (fec);
+	return ret;
+}
+
+
+/**
+ * Checks that a kernel computes the same parity as the scalar one
+ *
+ * @return 0 on success
+ */
+static int
+check_kernel (enum GNUNET_SCRB_FecKernel kernel)
+{
+	struct GNUNET_SCRB_FecCodec *fec = GNUNET_SCRB_fec_create (8, 8);
+	uint8_t *data[8];
+	uint8_t *expected[8];
+	uint8_t *parity[8];
+	unsigned int i;
+	unsigned int j;
+	int ret = 0;
+
+	for (i = 0; i < 8; i++)
+	{
+		data[i] = GNUNET_malloc (CHUNK_SIZE);
+		expected[i] = GNUNET_malloc (CHUNK_SIZE);
+		parity[i] = GNUNET_malloc (CHUNK_SIZE);
+		for (j = 0; j < CHUNK_SIZE; j++)
+			data[i][j] = (uint8_t) (i * CHUNK_SIZE + j);
+	}
+	GNUNET_assert (GNUNET_OK == GNUNET_SCRB_fec_select_kernel (GNUNET_SCRB_FEC_KERNEL_SCALAR));
+	GNUNET_SCRB_fec_encode (fec, (const uint8_t *const *) data, expected, CHUNK_SIZE);
+	GNUNET_assert (GNUNET_OK == GNUNET_SCRB_fec_select_kernel (kernel));
+	GNUNET_SCRB_fec_encode (fec, (const uint8_t *const *) data, parity, CHUNK_SIZE);
+	for (i = 0; i < 8; i++)
+	{
+		if (0 != memcmp (expected[i], parity[i], CHUNK_SIZE))
+			ret = 1;
+		GNUNET_free (data[i]);
+		GNUNET_free (expected[i]);
+		GNUNET_free (parity[i]);
+	}
+	GNUNET_SCRB_fec_destroy (fec);
+	return ret;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	enum GNUNET_SCRB_FecKernel kernel;
+	unsigned int i;
+	int ret = 0;
+
+	GNUNET_log_setup ("test-scrb-fec", "WARNING", NULL);
+	GNUNET_assert (NULL == GNUNET_SCRB_fec_create (0, 1));
+	GNUNET_assert (NULL == GNUNET_SCRB_fec_create (200, 57));
+	for (kernel = GNUNET_SCRB_FEC_KERNEL_SCALAR; kernel <= GNUNET_SCRB_FEC_KERNEL_AVX2; kernel++)
+	{
+		if (GNUNET_OK != GNUNET_SCRB_fec_select_kernel (kernel))
+		{
+			fprintf (stderr, "kernel %s not supported, skipped\n", kernel_names[kernel]);
+			continue;
+		}
+		if (0 != check_kernel (kernel))
+		{
+			fprintf (stderr, "kernel %s differs from the scalar one\n", kernel_names[kernel]);
+			ret = 1;
+		}
+		for (i = 0; i < sizeof (codes) / sizeof (codes[0]); i++)
+			ret |= check_code (codes[i][0], codes[i][1]);
+	}
+	return ret;
+}
+
+/* end of test_scrb_fec.c */
@@ -0,0 +1,190 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+/**
+ * @file scrb/test_scrb_stripe.c
+ * @brief testcase for the reassembly in scrb_stripe.c
+ * @author azhdanov
+ */
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include "scrb_stripe.h"
+
+/**
+ * Number of stripes of the test group
+ */
+#define STRIPES 4
+
+/**
+ * Size of the test blocks
+ */
+#define BLOCK_SIZE 1000
+
+/**
+ * A chunk as the split hands it out, with its header in front
+ */
+struct Chunk
+{
+	struct GNUNET_SCRB_StripeChunk hdr;
+	char data[BLOCK_SIZE];
+	size_t size;
+};
+
+/**
+ * Chunks of the block split last
+ */
+static struct Chunk chunks[STRIPES];
+
+static unsigned int chunk_count;
+
+/**
+ * First byte of the blocks delivered so far
+ */
+static char delivered[16];
+
+static unsigned int delivered_count;
+
+
+static void
+collect_chunk (void *cls,
+		unsigned int stripe,
+		const struct GNUNET_SCRB_StripeChunk *chunk,
+		const void *data,
+		size_t size)
+{
+	struct Chunk *c = &chunks[chunk_count++];
+
+	c->hdr = *chunk;
+	memcpy (c->data, data, size);
+	c->size = sizeof (struct GNUNET_SCRB_StripeChunk) + size;
+}
+
+
+static void
+collect_block (void *cls, const void *data, size_t size)
+{
+	GNUNET_assert (BLOCK_SIZE == size);
+	delivered[delivered_count++] = *(const char *) data;
+}
+
+
+/**
+ * Splits a block filled with @a fill
+ */
+static void
+split (uint32_t seq, char fill)
+{
+	char block[BLOCK_SIZE];
+
+	memset (block, fill, sizeof (block));
+	chunk_count = 0;
+	GNUNET_SCRB_stripe_split (block, sizeof (block), STRIPES, NULL, seq,
+			&collect_chunk, NULL);
+	GNUNET_assert (STRIPES == chunk_count);
+}
+
+
+static int
+add (struct GNUNET_SCRB_StripeAssembly *sa,
+		const struct GNUNET_HashCode *source,
+		const struct Chunk *c)
+{
+	return GNUNET_SCRB_stripe_assembly_add (sa, source, &c->hdr, c->size,
+			&collect_block, NULL);
+}
+
+
+/**
+ * Two publishers which number their blocks alike must not mix their
+ * chunks
+ *
+ * @return 0 on success
+ */
+static int
+check_sources ()
+{
+	struct GNUNET_SCRB_StripeAssembly *sa;
+	struct GNUNET_HashCode a;
+	struct GNUNET_HashCode b;
+	struct Chunk ca[STRIPES];
+	unsigned int i;
+
+	memset (&a, 1, sizeof (a));
+	memset (&b, 2, sizeof (b));
+	sa = GNUNET_SCRB_stripe_assembly_create ();
+	delivered_count = 0;
+	split (0, 'a');
+	memcpy (ca, chunks, sizeof (ca));
+	split (0, 'b');
+	for (i = 0; i < STRIPES; i++)
+	{
+		GNUNET_assert (GNUNET_OK == add (sa, &a, &ca[i]));
+		GNUNET_assert (GNUNET_OK == add (sa, &b, &chunks[i]));
+	}
+	GNUNET_SCRB_stripe_assembly_destroy (sa);
+	return ((2 == delivered_count) && ('a' == delivered[0]) &&
+			('b' == delivered[1])) ? 0 : 1;
+}
+
+
+/**
+ * A late chunk of a block an incomplete newer block replaced must not
+ * take the slot back, the newer block still completes
+ *
+ * @return 0 on success
+ */
+static int
+check_late_chunk ()
+{
+	struct GNUNET_SCRB_StripeAssembly *sa;
+	struct GNUNET_HashCode a;
+	struct Chunk old[STRIPES];
+	unsigned int i;
+	uint32_t seq = UINT32_MAX - 2;
+
+	memset (&a, 1, sizeof (a));
+	sa = GNUNET_SCRB_stripe_assembly_create ();
+	delivered_count = 0;
+	split (seq, 'o');
+	memcpy (old, chunks, sizeof (old));
+	GNUNET_assert (GNUNET_OK == add (sa, &a, &old[0]));
+	/* the same slot, across the wrap-around of the sequence numbers */
+	split (seq + GNUNET_SCRB_STRIPE_WINDOW, 'n');
+	GNUNET_assert (GNUNET_OK == add (sa, &a, &chunks[0]));
+	for (i = 1; i < STRIPES; i++)
+		GNUNET_assert (GNUNET_OK == add (sa, &a, &old[i]));
+	for (i = 1; i < STRIPES; i++)
+		GNUNET_assert (GNUNET_OK == add (sa, &a, &chunks[i]));
+	GNUNET_SCRB_stripe_assembly_destroy (sa);
+	return ((1 == delivered_count) && ('n' == delivered[0])) ? 0 : 1;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	int ret = 0;
+
+	GNUNET_log_setup ("test-scrb-stripe", "WARNING", NULL);
+	ret |= check_sources ();
+	ret |= check_late_chunk ();
+	return ret;
+}
+
+/* end of test_scrb_stripe.c */
@@ -120,10 +120,9 @@ static void
 multicast_task (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
 	struct GNUNET_SCRB_Handle *scrb_handle = cls;
-	struct GNUNET_SCRB_MulticastData msg;
+	static const char msg[] = "Hello World!!";
 
-	strncpy (msg.data, "Hello World!!", sizeof (msg.data));
-	GNUNET_SCRB_request_multicast(scrb_handle, &publisher, &msg, NULL, NULL);
+	GNUNET_SCRB_request_multicast(scrb_handle, &publisher, msg, sizeof (msg), NULL, NULL);
 	GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 10),
 			&multicast_task, scrb_handle);
 }
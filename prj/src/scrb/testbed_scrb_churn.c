@@ -0,0 +1,477 @@
+/*
+     This file is part of GNUnet.
+     (C)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+ */
+/**
+ * @file scrb/testbed_scrb_churn.c
+ * @brief measures how fast the trees recover from a failed peer
+ * @author azhdanov
+ *
+ * Peer 0 creates a group, all other peers subscribe to it.  Once the
+ * tree settled the peer with the most children is stopped, and we poll
+ * the statistics of the survivors until every group that lost its
+ * parent got a new one.  Succeeds if that happens within
+ * #RECOVERY_TIMEOUT and prints the mean recovery time.
+ */
+#include <gnunet/platform.h>
+#include <gnunet/gnunet_util_lib.h>
+#include <gnunet/gnunet_testbed_service.h>
+#include "handle.h"
+#include "../include/gnunet_scrb_service.h"
+
+/**
+ * Number of peers we want to start
+ */
+#define NUM_PEERS 10
+
+/**
+ * How long do we give the peers to connect to their services?
+ */
+#define SETUP_DELAY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 5)
+
+/**
+ * How long do we give the tree to form?
+ */
+#define JOIN_DELAY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 20)
+
+/**
+ * How often do we look at the statistics of the survivors?
+ */
+#define POLL_INTERVAL GNUNET_TIME_UNIT_SECONDS
+
+/**
+ * How long may the repair take?
+ */
+#define RECOVERY_TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 60)
+
+/**
+ * A started peer
+ */
+struct SCRBPeer
+{
+	/**
+	 * Handle with testbed.
+	 */
+	struct GNUNET_TESTBED_Peer *guardian;
+
+	/**
+	 * Testbed operation to connect to SCRB service.
+	 */
+	struct GNUNET_TESTBED_Operation *scrb_op;
+
+	/**
+	 * Connection to the SCRB service
+	 */
+	struct GNUNET_SCRB_Handle *scrb;
+
+	/**
+	 * Number of children in the trees, from the statistics
+	 */
+	uint64_t children;
+};
+
+/**
+ * Repair statistics summed over the survivors
+ */
+struct RepairStats
+{
+	uint64_t rejoined;
+
+	uint64_t recovered;
+
+	uint64_t recovery_ms;
+};
+
+static struct SCRBPeer peers[NUM_PEERS];
+
+/**
+ * The group all peers subscribe to
+ */
+static struct GNUNET_HashCode group_id;
+
+/**
+ * Index of the stopped peer
+ */
+static unsigned int victim;
+
+/**
+ * When was the victim stopped?
+ */
+static struct GNUNET_TIME_Absolute stop_time;
+
+/**
+ * Repair statistics of the current poll
+ */
+static struct RepairStats repair;
+
+/**
+ * Pending statistics operation
+ */
+static struct GNUNET_TESTBED_Operation *stats_op;
+
+/**
+ * Operation stopping the victim
+ */
+static struct GNUNET_TESTBED_Operation *stop_op;
+
+static struct GNUNET_SCHEDULER_Task *shutdown_tid;
+
+static struct GNUNET_SCHEDULER_Task *step_tid;
+
+/**
+ * Global result for testcase.
+ */
+static int result;
+
+
+/**
+ * Function run on CTRL-C or shutdown (i.e. success/timeout/etc.).
+ * Cleans up.
+ */
+static void
+shutdown_task (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	unsigned int i;
+
+	shutdown_tid = NULL;
+	if (NULL != step_tid)
+	{
+		GNUNET_SCHEDULER_cancel (step_tid);
+		step_tid = NULL;
+	}
+	if (NULL != stats_op)
+	{
+		GNUNET_TESTBED_operation_done (stats_op);
+		stats_op = NULL;
+	}
+	if (NULL != stop_op)
+	{
+		GNUNET_TESTBED_operation_done (stop_op);
+		stop_op = NULL;
+	}
+	for (i = 0; i < NUM_PEERS; i++)
+		if (NULL != peers[i].scrb_op)
+		{
+			GNUNET_TESTBED_operation_done (peers[i].scrb_op);
+			peers[i].scrb_op = NULL;
+		}
+	GNUNET_SCHEDULER_shutdown (); /* Also kills the testbed */
+}
+
+
+/**
+ * Ends the test with @a res
+ */
+static void
+finish (int res)
+{
+	result = res;
+	if (NULL != shutdown_tid)
+		GNUNET_SCHEDULER_cancel (shutdown_tid);
+	shutdown_tid = GNUNET_SCHEDULER_add_now (&shutdown_task, NULL);
+}
+
+
+/**
+ * Returns the testbed handles of all peers but the victim
+ */
+static unsigned int
+get_survivors (struct GNUNET_TESTBED_Peer **survivors)
+{
+	unsigned int i;
+	unsigned int n = 0;
+
+	for (i = 0; i < NUM_PEERS; i++)
+		if (i != victim)
+			survivors[n++] = peers[i].guardian;
+	return n;
+}
+
+
+static void
+poll_repair (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc);
+
+
+/**
+ * Sums the repair statistics of a survivor
+ */
+static int
+repair_stat (void *cls,
+		const struct GNUNET_TESTBED_Peer *peer,
+		const char *subsystem,
+		const char *name,
+		uint64_t value,
+		int is_persistent)
+{
+	if (0 == strcmp (name, "# repair: groups rejoined"))
+		repair.rejoined += value;
+	else if (0 == strcmp (name, "# repair: groups recovered"))
+		repair.recovered += value;
+	else if (0 == strcmp (name, "# repair: total recovery time in ms"))
+		repair.recovery_ms += value;
+	return GNUNET_OK;
+}
+
+
+/**
+ * The statistics of all survivors were read, check if the trees are whole
+ */
+static void
+repair_polled (void *cls,
+		struct GNUNET_TESTBED_Operation *op,
+		const char *emsg)
+{
+	struct GNUNET_TIME_Relative elapsed;
+
+	GNUNET_TESTBED_operation_done (stats_op);
+	stats_op = NULL;
+	elapsed = GNUNET_TIME_absolute_get_duration (stop_time);
+	if ((NULL == emsg) && (0 < repair.rejoined) &&
+			(repair.recovered >= repair.rejoined))
+	{
+		fprintf (stderr,
+				"%llu groups lost their parent, all recovered after %s, %llu ms on average\n",
+				(unsigned long long) repair.rejoined,
+				GNUNET_STRINGS_relative_time_to_string (elapsed, GNUNET_YES),
+				(unsigned long long) (repair.recovery_ms / repair.recovered));
+		finish (GNUNET_OK);
+		return;
+	}
+	if (elapsed.rel_value_us > RECOVERY_TIMEOUT.rel_value_us)
+	{
+		fprintf (stderr, "%llu of %llu groups recovered in time\n",
+				(unsigned long long) repair.recovered,
+				(unsigned long long) repair.rejoined);
+		finish (GNUNET_SYSERR);
+		return;
+	}
+	step_tid = GNUNET_SCHEDULER_add_delayed (POLL_INTERVAL, &poll_repair, NULL);
+}
+
+
+static void
+poll_repair (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	struct GNUNET_TESTBED_Peer *survivors[NUM_PEERS];
+
+	step_tid = NULL;
+	memset (&repair, 0, sizeof (repair));
+	stats_op = GNUNET_TESTBED_get_statistics (get_survivors (survivors),
+			survivors, "scrb", NULL, &repair_stat, &repair_polled, NULL);
+}
+
+
+/**
+ * The victim is down, watch the survivors repair the trees
+ */
+static void
+victim_stopped (void *cls, const char *emsg)
+{
+	GNUNET_TESTBED_operation_done (stop_op);
+	stop_op = NULL;
+	if (NULL != emsg)
+	{
+		fprintf (stderr, "Stopping peer %u failed: %s\n", victim, emsg);
+		finish (GNUNET_SYSERR);
+		return;
+	}
+	stop_time = GNUNET_TIME_absolute_get ();
+	step_tid = GNUNET_SCHEDULER_add_delayed (POLL_INTERVAL, &poll_repair, NULL);
+}
+
+
+/**
+ * Notes the number of children of a peer
+ */
+static int
+children_stat (void *cls,
+		const struct GNUNET_TESTBED_Peer *peer,
+		const char *subsystem,
+		const char *name,
+		uint64_t value,
+		int is_persistent)
+{
+	unsigned int i;
+
+	for (i = 0; i < NUM_PEERS; i++)
+		if (peer == peers[i].guardian)
+			peers[i].children = value;
+	return GNUNET_OK;
+}
+
+
+/**
+ * Stops the inner node with the most children, its subtree has to
+ * find new parents
+ */
+static void
+children_counted (void *cls,
+		struct GNUNET_TESTBED_Operation *op,
+		const char *emsg)
+{
+	unsigned int i;
+
+	GNUNET_TESTBED_operation_done (stats_op);
+	stats_op = NULL;
+	victim = NUM_PEERS - 1;
+	/* never the creator, it holds the root of the tree */
+	for (i = 1; i < NUM_PEERS; i++)
+		if (peers[i].children > peers[victim].children)
+			victim = i;
+	if (0 == peers[victim].children)
+	{
+		fprintf (stderr, "No peer but the root has children\n");
+		finish (GNUNET_SYSERR);
+		return;
+	}
+	fprintf (stderr, "Stopping peer %u with %llu children\n", victim,
+			(unsigned long long) peers[victim].children);
+	GNUNET_TESTBED_operation_done (peers[victim].scrb_op);
+	peers[victim].scrb_op = NULL;
+	stop_op = GNUNET_TESTBED_peer_stop (NULL, peers[victim].guardian,
+			&victim_stopped, NULL);
+}
+
+
+static void
+pick_victim (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	struct GNUNET_TESTBED_Peer *guardians[NUM_PEERS];
+	unsigned int i;
+
+	step_tid = NULL;
+	for (i = 0; i < NUM_PEERS; i++)
+		guardians[i] = peers[i].guardian;
+	stats_op = GNUNET_TESTBED_get_statistics (NUM_PEERS, guardians,
+			"scrb", "# children", &children_stat, &children_counted, NULL);
+}
+
+
+static void
+subscribe_all (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+	unsigned int i;
+
+	step_tid = NULL;
+	for (i = 1; i < NUM_PEERS; i++)
+		if ((NULL != peers[i].scrb) && (NULL != peers[i].scrb->cid))
+			GNUNET_SCRB_subscribe (peers[i].scrb, &group_id,
+					peers[i].scrb->cid, NULL, NULL);
+	step_tid = GNUNET_SCHEDULER_add_delayed (JOIN_DELAY, &pick_victim, NULL);
+}
+
+
+static void
+group_created (struct GNUNET_SCRB_Handle *scrb_handle)
+{
+	step_tid = GNUNET_SCHEDULER_add_delayed (SETUP_DELAY, &subscribe_all, NULL);
+}
+
+
+static void
+id_received (void *cls, struct GNUNET_SCRB_Handle *scrb_handle)
+{
+	struct SCRBPeer *peer = cls;
+
+	if (peer != &peers[0])
+		return;
+	group_id = *scrb_handle->cid;
+	GNUNET_SCRB_request_create (scrb_handle, &group_id, &group_created, NULL);
+}
+
+
+static void
+service_connect (void *cls,
+		struct GNUNET_TESTBED_Operation *op,
+		void *ca_result,
+		const char *emsg)
+{
+	struct SCRBPeer *peer = cls;
+
+	if (NULL == ca_result)
+	{
+		fprintf (stderr, "Connecting to SCRB failed: %s\n", emsg);
+		finish (GNUNET_SYSERR);
+		return;
+	}
+	peer->scrb = ca_result;
+	GNUNET_SCRB_request_id (peer->scrb, &id_received, peer);
+}
+
+
+static void *
+scrb_connect (void *cls, const struct GNUNET_CONFIGURATION_Handle *cfg)
+{
+	return GNUNET_SCRB_connect (cfg);
+}
+
+
+static void
+scrb_disconnect (void *cls, void *op_result)
+{
+	struct SCRBPeer *peer = cls;
+
+	GNUNET_SCRB_disconnect ((struct GNUNET_SCRB_Handle *) op_result);
+	peer->scrb = NULL;
+}
+
+
+static void
+test_master (void *cls,
+		struct GNUNET_TESTBED_RunHandle *h,
+		unsigned int num_peers,
+		struct GNUNET_TESTBED_Peer **guardians,
+		unsigned int links_succeeded,
+		unsigned int links_failed)
+{
+	unsigned int i;
+
+	if (NULL == guardians)
+	{
+		GNUNET_SCHEDULER_add_now (&shutdown_task, NULL);
+		return;
+	}
+	for (i = 0; i < num_peers; i++)
+	{
+		peers[i].guardian = guardians[i];
+		peers[i].scrb_op = GNUNET_TESTBED_service_connect (NULL, guardians[i],
+				"scrb", &service_connect, &peers[i],
+				&scrb_connect, &scrb_disconnect, &peers[i]);
+	}
+	shutdown_tid = GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_HOURS,
+			&shutdown_task, NULL);
+}
+
+
+int
+main (int argc, char **argv)
+{
+	int ret;
+
+	result = GNUNET_SYSERR;
+	ret = GNUNET_TESTBED_test_run ("scrb-churn",
+			"test_scrb_peer1.conf",
+			NUM_PEERS,
+			0LL, NULL, NULL,
+			&test_master, NULL);
+	if ( (GNUNET_OK != ret) || (GNUNET_OK != result) )
+		return 1;
+	return 0;
+}
+
+/* end of testbed_scrb_churn.c */